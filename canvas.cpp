@@ -28,6 +28,18 @@ namespace image
 	core::rgba canvas::get_pixel(int x, int y) 
 		{ return m_owner->get_pixel(m_mip_level, x, y); }
 
+	void canvas::read_row(int x, int y, int width, core::rgba* dst) const
+		{ m_owner->read_row(m_mip_level, x, y, width, dst); }
+
+	void canvas::write_row(const core::rgba* src, int x, int y, int width)
+		{ m_owner->write_row(src, m_mip_level, x, y, width); }
+
+	void canvas::read_row(int x, int y, int width, float* dst) const
+		{ m_owner->read_row(m_mip_level, x, y, width, dst); }
+
+	void canvas::write_row(const float* src, int x, int y, int width)
+		{ m_owner->write_row(src, m_mip_level, x, y, width); }
+
 	/// \returns row pitch in bytes
 	int canvas::get_pitch() const
 		{ return m_pitch; }
@@ -81,6 +81,44 @@ namespace image
 		/// lookup a pixel
 		core::rgba get_pixel(int x, int y);
 		
+		/// read a horizontal run of pixels, see \ref image_base::read_row
+		void read_row(int x, int y, int width, core::rgba* dst) const;
+
+		/// write a horizontal run of pixels, see \ref image_base::write_row
+		void write_row(const core::rgba* src, int x, int y, int width);
+
+		/// read a horizontal run of pixels into planar float channels, see \ref image_base::read_row
+		void read_row(int x, int y, int width, float* dst) const;
+
+		/// write a horizontal run of planar float channels, see \ref image_base::write_row
+		void write_row(const float* src, int x, int y, int width);
+		
+		/// \returns raw pixels at the start of row y
+		core::uint8* get_row(int y)
+			{ return m_pixels + y * m_pitch; }
+
+		/// \returns raw pixels at the start of row y, const version
+		const core::uint8* get_row(int y) const
+			{ return m_pixels + y * m_pitch; }
+
+		/// \returns the start of row y as the pixel type T, caller must be sure T matches the format
+		template<class T> 
+		T* get_row_as(int y)
+			{ return reinterpret_cast<T*>(get_row(y)); }
+
+		/// \returns the start of row y as the pixel type T, const version
+		template<class T> 
+		const T* get_row_as(int y) const
+			{ return reinterpret_cast<const T*>(get_row(y)); }
+		
+		/// \returns the image that owns this canvas
+		image_base* get_owner() const
+			{ return m_owner; }
+
+		/// \returns the mip level this canvas represents
+		int get_mip_level() const
+			{ return m_mip_level; }
+		
 		/// \returns the size in bytes of the canvas
 		int get_byte_size() const 
 			{ return m_byte_size; }
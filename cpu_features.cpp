@@ -0,0 +1,64 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:28:35 PM
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "cpu_features.h"
+
+#if TYCHO_IMAGE_SSE
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif 
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	static cpu_features detect_cpu_features()
+	{
+		cpu_features features;
+		features.sse2 = false;
+		features.ssse3 = false;
+		features.sse41 = false;
+#if TYCHO_IMAGE_SSE
+		unsigned int ecx = 0, edx = 0;
+#if defined(_MSC_VER)
+		int regs[4];
+		__cpuid(regs, 1);
+		ecx = (unsigned int)regs[2];
+		edx = (unsigned int)regs[3];
+#else
+		unsigned int eax, ebx;
+		if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+			return features;
+#endif
+		features.sse2  = (edx & (1 << 26)) != 0;
+		features.ssse3 = (ecx & (1 << 9)) != 0;
+		features.sse41 = (ecx & (1 << 19)) != 0;
+#endif // TYCHO_IMAGE_SSE
+		return features;
+	}
+
+} // end namespace
+
+	IMAGE_ABI const cpu_features& get_cpu_features()
+	{
+		static const cpu_features features = detail::detect_cpu_features();
+		return features;
+	}
+
+} // end namespace
+} // end namespace
@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:28:35 PM
+//////////////////////////////////////////////////////////////////////////////
+#if _MSC_VER > 1000
+#pragma once
+#endif  // _MSC_VER
+
+#ifndef __CPU_FEATURES_H_8F1388EA_9F5F_450F_BDC4_1E8E6162829E_
+#define __CPU_FEATURES_H_8F1388EA_9F5F_450F_BDC4_1E8E6162829E_
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/image_abi.h"
+
+/// TYCHO_IMAGE_SSE is 1 when building for x86 where the SSE code paths are compiled in, which
+/// of them actually run is decided at runtime from \ref tycho::image::get_cpu_features.
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define TYCHO_IMAGE_SSE 1
+#else
+#define TYCHO_IMAGE_SSE 0
+#endif 
+
+/// GCC and clang only allow intrinsics in functions compiled for the instruction set, MSVC
+/// allows them anywhere.
+#if defined(__GNUC__)
+#define TYCHO_IMAGE_TARGET(_isa) __attribute__((target(_isa)))
+#else
+#define TYCHO_IMAGE_TARGET(_isa)
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+namespace tycho
+{
+namespace image
+{
+
+	/// instruction set extensions supported by the cpu we are running on
+	struct cpu_features
+	{
+		bool sse2;
+		bool ssse3;
+		bool sse41;
+	};
+
+	/// \returns the features of the cpu we are running on, these are detected once on first use.
+	IMAGE_ABI const cpu_features& get_cpu_features();
+
+} // end namespace
+} // end namespace
+
+#endif // __CPU_FEATURES_H_8F1388EA_9F5F_450F_BDC4_1E8E6162829E_
@@ -0,0 +1,1020 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:47:33 PM
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "dxtn_codec.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <string.h>
+
+#if TYCHO_IMAGE_SSE
+#include <emmintrin.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	static int read16(const core::uint8* p)
+	{
+		return p[0] | (p[1] << 8);
+	}
+
+	static void write16(core::uint8* p, int v)
+	{
+		p[0] = (core::uint8)v;
+		p[1] = (core::uint8)(v >> 8);
+	}
+
+	/// \returns 8 bit colour channels packed to 565
+	static int pack_565(int r, int g, int b)
+	{
+		return (((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255);
+	}
+
+	/// expands a 565 colour to 8 bit channels by replicating the high bits into the low ones
+	static void unpack_565(int c, int* rgba)
+	{
+		const int r = (c >> 11) & 0x1f;
+		const int g = (c >> 5) & 0x3f;
+		const int b = c & 0x1f;
+		rgba[0] = (r << 3) | (r >> 2);
+		rgba[1] = (g << 2) | (g >> 4);
+		rgba[2] = (b << 3) | (b >> 2);
+		rgba[3] = 255;
+	}
+
+	/// builds the four colours a colour block can reference. Colour blocks in dxt3 and dxt5 always
+	/// have four colours, dxt1 blocks with c0 <= c1 have three and transparent black.
+	static void build_colour_palette(int c0, int c1, bool four_colour_only, int (*palette)[4])
+	{
+		unpack_565(c0, palette[0]);
+		unpack_565(c1, palette[1]);
+		if(c0 > c1 || four_colour_only)
+		{
+			for(int c = 0; c < 4; ++c)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+		}
+		else
+		{
+			for(int c = 0; c < 4; ++c)
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+	}
+
+	/// builds the eight alphas an interpolated alpha block can reference
+	static void build_alpha_palette(int a0, int a1, int* palette)
+	{
+		palette[0] = a0;
+		palette[1] = a1;
+		if(a0 > a1)
+		{
+			for(int i = 2; i < 8; ++i)
+				palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+		}
+		else
+		{
+			for(int i = 2; i < 6; ++i)
+				palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	static void decode_colour(const core::uint8* block, bool four_colour_only, core::rgba* pixels)
+	{
+		int palette[4][4];
+		build_colour_palette(read16(block), read16(block + 2), four_colour_only, palette);
+		core::uint32 indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((core::uint32)block[7] << 24);
+		for(int i = 0; i < 16; ++i, indices >>= 2)
+		{
+			const int* c = palette[indices & 3];
+			pixels[i] = core::rgba(c[0], c[1], c[2], c[3]);
+		}
+	}
+
+	/// decodes the 4 bit alphas of a dxt3 block
+	static void decode_explicit_values(const core::uint8* block, core::uint8* values)
+	{
+		for(int i = 0; i < 16; ++i)
+			values[i] = (core::uint8)(((block[i >> 1] >> ((i & 1) * 4)) & 0xf) * 17);
+	}
+
+	/// decodes an interpolated block, the alpha of dxt5 and the channels of bc4 and bc5
+	static void decode_interpolated_values(const core::uint8* block, core::uint8* values)
+	{
+		int palette[8];
+		build_alpha_palette(block[0], block[1], palette);
+		core::uint64 indices = 0;
+		for(int i = 7; i >= 2; --i)
+			indices = (indices << 8) | block[i];
+		for(int i = 0; i < 16; ++i, indices >>= 3)
+			values[i] = (core::uint8)palette[indices & 7];
+	}
+
+	static void set_alpha(const core::uint8* values, core::rgba* pixels)
+	{
+		for(int i = 0; i < 16; ++i)
+			pixels[i] = core::rgba(pixels[i].r(), pixels[i].g(), pixels[i].b(), values[i]);
+	}
+
+	//////////////////////////////////////////////////////////////////////////////
+	// colour encoding
+	//////////////////////////////////////////////////////////////////////////////
+
+	/// greatest number of times the iterative fit reorders the pixels along its last endpoints
+	static const int MaxClusterIterations = 4;
+
+	/// greatest number of passes of the endpoint search in the high quality tier
+	static const int MaxRefinePasses = 16;
+
+	/// steps per unit of each channel of a 565 colour
+	static const float GridScale[3] = { 31.0f / 255.0f, 63.0f / 255.0f, 31.0f / 255.0f };
+	static const float InvGridScale[3] = { 255.0f / 31.0f, 255.0f / 63.0f, 255.0f / 31.0f };
+
+	/// the pixels of a block gathered for fitting endpoints
+	struct colour_input
+	{
+		bool punch_through;			///< dxt1, pixels with alpha below half are transparent
+		bool any_transparent;
+		bool transparent[16];
+		int count;					///< number of opaque pixels
+		float points[16][3];		///< colours of the opaque pixels
+		core::uint8 rgb[16 * 4];	///< every pixel as r, g, b, 0 in row order for matching
+	};
+
+	static void gather_colours(const core::rgba* pixels, bool punch_through, colour_input& in)
+	{
+		in.punch_through = punch_through;
+		in.any_transparent = false;
+		in.count = 0;
+		for(int i = 0; i < 16; ++i)
+		{
+			const core::rgba& p = pixels[i];
+			in.rgb[i * 4 + 0] = (core::uint8)p.r();
+			in.rgb[i * 4 + 1] = (core::uint8)p.g();
+			in.rgb[i * 4 + 2] = (core::uint8)p.b();
+			in.rgb[i * 4 + 3] = 0;
+			in.transparent[i] = punch_through && p.a() < 128;
+			if(in.transparent[i])
+			{
+				in.any_transparent = true;
+				continue;
+			}
+			float* point = in.points[in.count++];
+			point[0] = (float)p.r();
+			point[1] = (float)p.g();
+			point[2] = (float)p.b();
+		}
+	}
+
+	/// \returns a colour in 0 to 255 per channel packed to 565
+	static int pack_565(const float* c)
+	{
+		int v[3];
+		for(int i = 0; i < 3; ++i)
+			v[i] = c[i] <= 0.0f ? 0 : (c[i] >= 255.0f ? 255 : (int)(c[i] + 0.5f));
+		return pack_565(v[0], v[1], v[2]);
+	}
+
+	/// \returns v clamped to 0 to 255 and snapped to the nearest value the channel of a 565 colour can hold
+	static float snap_to_grid(float v, int channel)
+	{
+		v = v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v);
+		return (float)(int)(v * GridScale[channel] + 0.5f) * InvGridScale[channel];
+	}
+
+	/// picks the nearest palette entry for each pixel, transparent pixels take index 3.
+	/// \returns summed squared error of the opaque pixels
+	static int match_colours(const colour_input& in, const int (*palette)[4], int num_colours, core::uint32* out_indices)
+	{
+		core::uint32 indices = 0;
+		int error = 0;
+		for(int i = 15; i >= 0; --i)
+		{
+			int best = 3;
+			if(!in.transparent[i])
+			{
+				const core::uint8* p = in.rgb + i * 4;
+				int best_dist = INT_MAX;
+				for(int j = 0; j < num_colours; ++j)
+				{
+					const int dr = p[0] - palette[j][0];
+					const int dg = p[1] - palette[j][1];
+					const int db = p[2] - palette[j][2];
+					const int dist = dr * dr + dg * dg + db * db;
+					if(dist < best_dist)
+					{
+						best_dist = dist;
+						best = j;
+					}
+				}
+				error += best_dist;
+			}
+			indices = (indices << 2) | best;
+		}
+		*out_indices = indices;
+		return error;
+	}
+
+#if TYCHO_IMAGE_SSE
+
+	/// four pixels at a time, pmaddwd sums the squared red and green differences and the blue in
+	/// neighbouring lanes. Picks the same indices as match_colours.
+	TYCHO_IMAGE_TARGET("sse2") static int match_colours_sse2(const colour_input& in, const int (*palette)[4], int num_colours, core::uint32* out_indices)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i entries[4];
+		for(int j = 0; j < num_colours; ++j)
+			entries[j] = _mm_setr_epi16(palette[j][0], palette[j][1], palette[j][2], 0, palette[j][0], palette[j][1], palette[j][2], 0);
+
+		core::int32 best_index[16];
+		core::int32 best_dist[16];
+		for(int i = 0; i < 16; i += 4)
+		{
+			const __m128i p = _mm_loadu_si128((const __m128i*)(in.rgb + i * 4));
+			const __m128i lo = _mm_unpacklo_epi8(p, zero);
+			const __m128i hi = _mm_unpackhi_epi8(p, zero);
+			__m128i best = _mm_set1_epi32(INT_MAX);
+			__m128i index = zero;
+			for(int j = 0; j < num_colours; ++j)
+			{
+				const __m128i dlo = _mm_sub_epi16(lo, entries[j]);
+				const __m128i dhi = _mm_sub_epi16(hi, entries[j]);
+				__m128i slo = _mm_madd_epi16(dlo, dlo);
+				__m128i shi = _mm_madd_epi16(dhi, dhi);
+				slo = _mm_add_epi32(slo, _mm_shuffle_epi32(slo, _MM_SHUFFLE(2, 3, 0, 1)));
+				shi = _mm_add_epi32(shi, _mm_shuffle_epi32(shi, _MM_SHUFFLE(2, 3, 0, 1)));
+				const __m128i dist = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(slo), _mm_castsi128_ps(shi), _MM_SHUFFLE(2, 0, 2, 0)));
+				const __m128i closer = _mm_cmplt_epi32(dist, best);
+				best = _mm_or_si128(_mm_and_si128(closer, dist), _mm_andnot_si128(closer, best));
+				index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(j)), _mm_andnot_si128(closer, index));
+			}
+			_mm_storeu_si128((__m128i*)(best_index + i), index);
+			_mm_storeu_si128((__m128i*)(best_dist + i), best);
+		}
+
+		core::uint32 indices = 0;
+		int error = 0;
+		for(int i = 15; i >= 0; --i)
+		{
+			if(in.transparent[i])
+			{
+				indices = (indices << 2) | 3;
+				continue;
+			}
+			indices = (indices << 2) | best_index[i];
+			error += best_dist[i];
+		}
+		*out_indices = indices;
+		return error;
+	}
+
+#endif
+
+	typedef int (*match_colours_fn)(const colour_input&, const int (*)[4], int, core::uint32*);
+
+	static match_colours_fn select_match_colours()
+	{
+#if TYCHO_IMAGE_SSE
+		if(get_cpu_features().sse2)
+			return &match_colours_sse2;
+#endif
+		return &match_colours;
+	}
+
+	/// writes a colour block from the two endpoints ordered for the mode, dxt1 blocks with
+	/// transparent pixels are always three colour.
+	/// \returns summed squared error of the opaque pixels
+	static int write_colour_block(const colour_input& in, int c0, int c1, bool three_colour, core::uint8* block)
+	{
+		static const match_colours_fn match_fn = select_match_colours();
+
+		// endpoint order selects the mode, c0 > c1 is four colours
+		three_colour = in.punch_through && (three_colour || in.any_transparent);
+		if(in.punch_through && (c0 > c1) == three_colour)
+			std::swap(c0, c1);
+		int palette[4][4];
+		build_colour_palette(c0, c1, !in.punch_through, palette);
+		const int num_colours = (c0 > c1 || !in.punch_through) ? 4 : 3;
+
+		core::uint32 indices;
+		const int error = match_fn(in, palette, num_colours, &indices);
+		write16(block, c0);
+		write16(block + 2, c1);
+		block[4] = (core::uint8)indices;
+		block[5] = (core::uint8)(indices >> 8);
+		block[6] = (core::uint8)(indices >> 16);
+		block[7] = (core::uint8)(indices >> 24);
+		return error;
+	}
+
+	/// endpoints at opposite corners of the bounding box of the pixels, channels that fall as the
+	/// widest channel rises take the other diagonal
+	static void range_fit(const colour_input& in, float* start, float* end)
+	{
+		float lo[3] = { 255.0f, 255.0f, 255.0f };
+		float hi[3] = { 0.0f, 0.0f, 0.0f };
+		for(int i = 0; i < in.count; ++i)
+		{
+			for(int c = 0; c < 3; ++c)
+			{
+				lo[c] = std::min(lo[c], in.points[i][c]);
+				hi[c] = std::max(hi[c], in.points[i][c]);
+			}
+		}
+		if(in.count == 0)
+			lo[0] = lo[1] = lo[2] = 0.0f;
+
+		int axis = 0;
+		for(int c = 1; c < 3; ++c)
+		{
+			if(hi[c] - lo[c] > hi[axis] - lo[axis])
+				axis = c;
+		}
+		for(int c = 0; c < 3; ++c)
+		{
+			if(c == axis)
+				continue;
+			float covariance = 0.0f;
+			for(int i = 0; i < in.count; ++i)
+				covariance += (in.points[i][axis] * 2.0f - lo[axis] - hi[axis]) * (in.points[i][c] * 2.0f - lo[c] - hi[c]);
+			if(covariance < 0.0f)
+				std::swap(lo[c], hi[c]);
+		}
+		for(int c = 0; c < 3; ++c)
+		{
+			start[c] = hi[c];
+			end[c] = lo[c];
+		}
+	}
+
+	/// direction of greatest variance of the pixels, found by power iteration on their covariance
+	static void principal_axis(const colour_input& in, float* axis)
+	{
+		float mean[3] = { 0.0f, 0.0f, 0.0f };
+		for(int i = 0; i < in.count; ++i)
+			for(int c = 0; c < 3; ++c)
+				mean[c] += in.points[i][c];
+		for(int c = 0; c < 3; ++c)
+			mean[c] /= (float)in.count;
+
+		// xx, xy, xz, yy, yz, zz
+		float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+		for(int i = 0; i < in.count; ++i)
+		{
+			const float x = in.points[i][0] - mean[0];
+			const float y = in.points[i][1] - mean[1];
+			const float z = in.points[i][2] - mean[2];
+			cov[0] += x * x;
+			cov[1] += x * y;
+			cov[2] += x * z;
+			cov[3] += y * y;
+			cov[4] += y * z;
+			cov[5] += z * z;
+		}
+
+		axis[0] = axis[1] = axis[2] = 1.0f;
+		for(int it = 0; it < 8; ++it)
+		{
+			const float x = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+			const float y = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+			const float z = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+			const float m = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+			if(m <= 0.0f)
+				break;
+			axis[0] = x / m;
+			axis[1] = y / m;
+			axis[2] = z / m;
+		}
+	}
+
+	/// orders the pixels along the axis and accumulates them, sums[k] is the sum of the first k
+	static void sort_along_axis(const colour_input& in, const float* axis, float (*sums)[3])
+	{
+		int order[16];
+		float dots[16];
+		for(int i = 0; i < in.count; ++i)
+		{
+			const float dot = in.points[i][0] * axis[0] + in.points[i][1] * axis[1] + in.points[i][2] * axis[2];
+			int j = i;
+			for(; j > 0 && dots[j - 1] > dot; --j)
+			{
+				dots[j] = dots[j - 1];
+				order[j] = order[j - 1];
+			}
+			dots[j] = dot;
+			order[j] = i;
+		}
+		sums[0][0] = sums[0][1] = sums[0][2] = 0.0f;
+		for(int k = 0; k < in.count; ++k)
+			for(int c = 0; c < 3; ++c)
+				sums[k + 1][c] = sums[k][c] + in.points[order[k]][c];
+	}
+
+	/// weights of the first endpoint for the two middle clusters of the sorted pixels, three
+	/// colour blocks have a single middle cluster so the second is always empty
+	static void get_cluster_weights(bool three_colour, float* w1, float* w2)
+	{
+		*w1 = three_colour ? 0.5f : 2.0f / 3.0f;
+		*w2 = three_colour ? 0.5f : 1.0f / 3.0f;
+	}
+
+	/// Cluster fit, tries every split of the pixels sorted along an axis into clusters that take
+	/// each palette entry and solves for the least squares endpoints of each split snapped to 565.
+	/// \returns error of the best split less the constant sum of squares of the pixels, FLT_MAX if
+	/// no split separates the pixels
+	static float cluster_fit(const float (*sums)[3], int count, bool three_colour, float* start, float* end)
+	{
+		float w1, w2;
+		get_cluster_weights(three_colour, &w1, &w2);
+		const float* total = sums[count];
+		float best = FLT_MAX;
+		for(int i = 0; i <= count; ++i)
+		{
+			for(int j = i; j <= count; ++j)
+			{
+				for(int k = j; k <= (three_colour ? j : count); ++k)
+				{
+					const float n1 = (float)(j - i);
+					const float n2 = (float)(k - j);
+					const float alpha2 = (float)i + n1 * w1 * w1 + n2 * w2 * w2;
+					const float beta2 = (float)(count - k) + n1 * (1.0f - w1) * (1.0f - w1) + n2 * (1.0f - w2) * (1.0f - w2);
+					const float alphabeta = n1 * w1 * (1.0f - w1) + n2 * w2 * (1.0f - w2);
+					const float det = alpha2 * beta2 - alphabeta * alphabeta;
+					if(det < 1e-3f)
+						continue;
+					const float factor = 1.0f / det;
+
+					float a[3], b[3], e[3];
+					for(int c = 0; c < 3; ++c)
+					{
+						const float x1 = sums[j][c] - sums[i][c];
+						const float x2 = sums[k][c] - sums[j][c];
+						const float x3 = total[c] - sums[k][c];
+						const float alphax = sums[i][c] + x1 * w1 + x2 * w2;
+						const float betax = x3 + x1 * (1.0f - w1) + x2 * (1.0f - w2);
+						a[c] = snap_to_grid((alphax * beta2 - betax * alphabeta) * factor, c);
+						b[c] = snap_to_grid((betax * alpha2 - alphax * alphabeta) * factor, c);
+						e[c] = a[c] * (a[c] * alpha2 - 2.0f * alphax) + b[c] * (b[c] * beta2 - 2.0f * betax) + 2.0f * alphabeta * a[c] * b[c];
+					}
+					const float error = (e[0] + e[2]) + e[1];
+					if(error < best)
+					{
+						best = error;
+						for(int c = 0; c < 3; ++c)
+						{
+							start[c] = a[c];
+							end[c] = b[c];
+						}
+					}
+				}
+			}
+		}
+		return best;
+	}
+
+#if TYCHO_IMAGE_SSE
+
+	/// the three channels of each split at once, same arithmetic as cluster_fit
+	TYCHO_IMAGE_TARGET("sse2") static float cluster_fit_sse2(const float (*sums)[3], int count, bool three_colour, float* start, float* end)
+	{
+		float w1, w2;
+		get_cluster_weights(three_colour, &w1, &w2);
+		__m128 s[17];
+		for(int k = 0; k <= count; ++k)
+			s[k] = _mm_setr_ps(sums[k][0], sums[k][1], sums[k][2], 0.0f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 max_value = _mm_set1_ps(255.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 grid = _mm_setr_ps(GridScale[0], GridScale[1], GridScale[2], 0.0f);
+		const __m128 inv_grid = _mm_setr_ps(InvGridScale[0], InvGridScale[1], InvGridScale[2], 0.0f);
+		const __m128 vw1 = _mm_set1_ps(w1);
+		const __m128 vw2 = _mm_set1_ps(w2);
+		const __m128 vw1_inv = _mm_set1_ps(1.0f - w1);
+		const __m128 vw2_inv = _mm_set1_ps(1.0f - w2);
+		__m128 best_start = zero;
+		__m128 best_end = zero;
+		float best = FLT_MAX;
+		for(int i = 0; i <= count; ++i)
+		{
+			for(int j = i; j <= count; ++j)
+			{
+				for(int k = j; k <= (three_colour ? j : count); ++k)
+				{
+					const float n1 = (float)(j - i);
+					const float n2 = (float)(k - j);
+					const float alpha2 = (float)i + n1 * w1 * w1 + n2 * w2 * w2;
+					const float beta2 = (float)(count - k) + n1 * (1.0f - w1) * (1.0f - w1) + n2 * (1.0f - w2) * (1.0f - w2);
+					const float alphabeta = n1 * w1 * (1.0f - w1) + n2 * w2 * (1.0f - w2);
+					const float det = alpha2 * beta2 - alphabeta * alphabeta;
+					if(det < 1e-3f)
+						continue;
+					const __m128 factor = _mm_set1_ps(1.0f / det);
+					const __m128 valpha2 = _mm_set1_ps(alpha2);
+					const __m128 vbeta2 = _mm_set1_ps(beta2);
+					const __m128 valphabeta = _mm_set1_ps(alphabeta);
+
+					const __m128 x1 = _mm_sub_ps(s[j], s[i]);
+					const __m128 x2 = _mm_sub_ps(s[k], s[j]);
+					const __m128 x3 = _mm_sub_ps(s[count], s[k]);
+					const __m128 alphax = _mm_add_ps(_mm_add_ps(s[i], _mm_mul_ps(x1, vw1)), _mm_mul_ps(x2, vw2));
+					const __m128 betax = _mm_add_ps(_mm_add_ps(x3, _mm_mul_ps(x1, vw1_inv)), _mm_mul_ps(x2, vw2_inv));
+					__m128 a = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(alphax, vbeta2), _mm_mul_ps(betax, valphabeta)), factor);
+					__m128 b = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(betax, valpha2), _mm_mul_ps(alphax, valphabeta)), factor);
+					a = _mm_min_ps(_mm_max_ps(a, zero), max_value);
+					b = _mm_min_ps(_mm_max_ps(b, zero), max_value);
+					a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, grid), half))), inv_grid);
+					b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, grid), half))), inv_grid);
+					
+					const __m128 ea = _mm_mul_ps(a, _mm_sub_ps(_mm_mul_ps(a, valpha2), _mm_mul_ps(two, alphax)));
+					const __m128 eb = _mm_mul_ps(b, _mm_sub_ps(_mm_mul_ps(b, vbeta2), _mm_mul_ps(two, betax)));
+					const __m128 eab = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(two, valphabeta), a), b);
+					__m128 e = _mm_add_ps(_mm_add_ps(ea, eb), eab);
+					e = _mm_add_ps(e, _mm_movehl_ps(e, e));
+					e = _mm_add_ss(e, _mm_shuffle_ps(e, e, _MM_SHUFFLE(1, 1, 1, 1)));
+					const float error = _mm_cvtss_f32(e);
+					if(error < best)
+					{
+						best = error;
+						best_start = a;
+						best_end = b;
+					}
+				}
+			}
+		}
+		float tmp[4];
+		_mm_storeu_ps(tmp, best_start);
+		start[0] = tmp[0]; start[1] = tmp[1]; start[2] = tmp[2];
+		_mm_storeu_ps(tmp, best_end);
+		end[0] = tmp[0]; end[1] = tmp[1]; end[2] = tmp[2];
+		return best;
+	}
+
+#endif
+
+	typedef float (*cluster_fit_fn)(const float (*)[3], int, bool, float*, float*);
+
+	static cluster_fit_fn select_cluster_fit()
+	{
+#if TYCHO_IMAGE_SSE
+		if(get_cpu_features().sse2)
+			return &cluster_fit_sse2;
+#endif
+		return &cluster_fit;
+	}
+
+	/// least squares endpoints for the indices an encoded block picked.
+	/// \returns false if the indices don't separate the pixels
+	static bool fit_to_indices(const colour_input& in, const core::uint8* block, float* start, float* end)
+	{
+		const bool three_colour = in.punch_through && read16(block) <= read16(block + 2);
+		const float weights[4] = { 1.0f, 0.0f, three_colour ? 0.5f : 2.0f / 3.0f, 1.0f / 3.0f };
+		float alpha2 = 0.0f, beta2 = 0.0f, alphabeta = 0.0f;
+		float alphax[3] = { 0.0f, 0.0f, 0.0f };
+		float betax[3] = { 0.0f, 0.0f, 0.0f };
+		core::uint32 indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((core::uint32)block[7] << 24);
+		for(int i = 0, point = 0; i < 16; ++i, indices >>= 2)
+		{
+			if(in.transparent[i])
+				continue;
+			const float alpha = weights[indices & 3];
+			const float beta = 1.0f - alpha;
+			alpha2 += alpha * alpha;
+			beta2 += beta * beta;
+			alphabeta += alpha * beta;
+			for(int c = 0; c < 3; ++c)
+			{
+				alphax[c] += alpha * in.points[point][c];
+				betax[c] += beta * in.points[point][c];
+			}
+			++point;
+		}
+		const float det = alpha2 * beta2 - alphabeta * alphabeta;
+		if(det < 1e-3f)
+			return false;
+		const float factor = 1.0f / det;
+		for(int c = 0; c < 3; ++c)
+		{
+			start[c] = (alphax[c] * beta2 - betax[c] * alphabeta) * factor;
+			end[c] = (betax[c] * alpha2 - alphax[c] * alphabeta) * factor;
+		}
+		return true;
+	}
+
+	/// greedy search moving each channel of each endpoint a step at a time while the error falls
+	/// \returns error of the block
+	static int refine_colour_endpoints(const colour_input& in, core::uint8* block, int error)
+	{
+		static const int Shifts[3] = { 11, 5, 0 };
+		static const int Masks[3] = { 0x1f, 0x3f, 0x1f };
+		const bool three_colour = in.punch_through && read16(block) <= read16(block + 2);
+		core::uint8 candidate[8];
+		for(int pass = 0; pass < MaxRefinePasses; ++pass)
+		{
+			bool improved = false;
+			for(int e = 0; e < 2; ++e)
+			{
+				for(int c = 0; c < 3; ++c)
+				{
+					for(int step = -1; step <= 1; step += 2)
+					{
+						int ends[2] = { read16(block), read16(block + 2) };
+						const int v = ((ends[e] >> Shifts[c]) & Masks[c]) + step;
+						if(v < 0 || v > Masks[c])
+							continue;
+						ends[e] = (ends[e] & ~(Masks[c] << Shifts[c])) | (v << Shifts[c]);
+						const int candidate_error = write_colour_block(in, ends[0], ends[1], three_colour, candidate);
+						if(candidate_error < error)
+						{
+							error = candidate_error;
+							memcpy(block, candidate, sizeof(candidate));
+							improved = true;
+						}
+					}
+				}
+			}
+			if(!improved)
+				break;
+		}
+		return error;
+	}
+
+	static void encode_colour(const core::rgba* pixels, bool punch_through, image_dxtn::dxtn_quality quality, core::uint8* block)
+	{
+		static const cluster_fit_fn cluster_fit_best = select_cluster_fit();
+
+		colour_input in;
+		gather_colours(pixels, punch_through, in);
+
+		// range fit is the fast tier and the block the slower ones have to improve on
+		float start[3], end[3];
+		range_fit(in, start, end);
+		int best_error = write_colour_block(in, pack_565(start), pack_565(end), false, block);
+		if(quality == image_dxtn::dxtn_quality_fast || in.count == 0 || best_error == 0)
+			return;
+
+		// cluster fit each mode the block can use, opaque dxt1 blocks may do better with three 
+		// colours. The iterative tier reorders the pixels along the endpoints it found and fits again.
+		float axis[3];
+		principal_axis(in, axis);
+		const int iterations = quality == image_dxtn::dxtn_quality_high ? MaxClusterIterations : 1;
+		core::uint8 candidate[8];
+		float sums[17][3];
+		for(int mode = 0; mode < 2; ++mode)
+		{
+			const bool three_colour = mode == 1;
+			if(three_colour ? !punch_through : in.any_transparent)
+				continue;
+			float mode_axis[3] = { axis[0], axis[1], axis[2] };
+			int mode_error = INT_MAX;
+			for(int it = 0; it < iterations; ++it)
+			{
+				sort_along_axis(in, mode_axis, sums);
+				if(cluster_fit_best(sums, in.count, three_colour, start, end) == FLT_MAX)
+					break;
+				const int error = write_colour_block(in, pack_565(start), pack_565(end), three_colour, candidate);
+				if(error < best_error)
+				{
+					best_error = error;
+					memcpy(block, candidate, sizeof(candidate));
+				}
+				if(error >= mode_error)
+					break;
+				mode_error = error;
+				for(int c = 0; c < 3; ++c)
+					mode_axis[c] = end[c] - start[c];
+				if(mode_axis[0] == 0.0f && mode_axis[1] == 0.0f && mode_axis[2] == 0.0f)
+					break;
+			}
+		}
+		if(quality != image_dxtn::dxtn_quality_high || best_error == 0)
+			return;
+
+		// refit the endpoints to the indices the best block picked then search around them
+		const bool three_colour = punch_through && read16(block) <= read16(block + 2);
+		if(fit_to_indices(in, block, start, end))
+		{
+			const int error = write_colour_block(in, pack_565(start), pack_565(end), three_colour, candidate);
+			if(error < best_error)
+			{
+				best_error = error;
+				memcpy(block, candidate, sizeof(candidate));
+			}
+		}
+		refine_colour_endpoints(in, block, best_error);
+	}
+
+	//////////////////////////////////////////////////////////////////////////////
+	// alpha and single channel encoding
+	//////////////////////////////////////////////////////////////////////////////
+
+	static void encode_explicit_alpha(const core::rgba* pixels, core::uint8* block)
+	{
+		for(int i = 0; i < 8; ++i)
+		{
+			const int a0 = (pixels[i * 2].a() * 15 + 127) / 255;
+			const int a1 = (pixels[i * 2 + 1].a() * 15 + 127) / 255;
+			block[i] = (core::uint8)(a0 | (a1 << 4));
+		}
+	}
+
+	/// picks the nearest of the values the endpoints give for each pixel.
+	/// \returns summed squared error
+	static int match_alphas(const core::uint8* values, int a0, int a1, core::uint64* out_indices)
+	{
+		int palette[8];
+		build_alpha_palette(a0, a1, palette);
+		core::uint64 indices = 0;
+		int error = 0;
+		for(int i = 15; i >= 0; --i)
+		{
+			const int a = values[i];
+			int best = 0;
+			int best_dist = INT_MAX;
+			for(int j = 0; j < 8; ++j)
+			{
+				const int dist = (a - palette[j]) * (a - palette[j]);
+				if(dist < best_dist)
+				{
+					best_dist = dist;
+					best = j;
+				}
+			}
+			indices = (indices << 3) | best;
+			error += best_dist;
+		}
+		*out_indices = indices;
+		return error;
+	}
+
+	static void encode_interpolated_values(const core::uint8* values, image_dxtn::dxtn_quality quality, core::uint8* block)
+	{
+		int lo = 255, hi = 0;
+		int inner_lo = 255, inner_hi = 0;
+		for(int i = 0; i < 16; ++i)
+		{
+			const int a = values[i];
+			lo = std::min(lo, a);
+			hi = std::max(hi, a);
+			if(a != 0 && a != 255)
+			{
+				inner_lo = std::min(inner_lo, a);
+				inner_hi = std::max(inner_hi, a);
+			}
+		}
+
+		// a0 > a1 selects eight interpolated alphas, a single alpha is index 0 of either mode
+		int a0 = hi;
+		int a1 = lo;
+		core::uint64 indices;
+		int error = match_alphas(values, a0, a1, &indices);
+
+		// six interpolated alphas and explicit 0 and 255 suit blocks with a few clear or opaque pixels
+		if(quality != image_dxtn::dxtn_quality_fast && error > 0 && inner_lo <= inner_hi)
+		{
+			core::uint64 candidate_indices;
+			const int candidate_error = match_alphas(values, inner_lo, inner_hi, &candidate_indices);
+			if(candidate_error < error)
+			{
+				a0 = inner_lo;
+				a1 = inner_hi;
+				indices = candidate_indices;
+				error = candidate_error;
+			}
+		}
+
+		// step each endpoint while the error falls, either mode may result
+		if(quality == image_dxtn::dxtn_quality_high)
+		{
+			for(int pass = 0; pass < MaxRefinePasses && error > 0; ++pass)
+			{
+				bool improved = false;
+				for(int e = 0; e < 2; ++e)
+				{
+					for(int step = -1; step <= 1; step += 2)
+					{
+						int ends[2] = { a0, a1 };
+						ends[e] += step;
+						if(ends[e] < 0 || ends[e] > 255)
+							continue;
+						core::uint64 candidate_indices;
+						const int candidate_error = match_alphas(values, ends[0], ends[1], &candidate_indices);
+						if(candidate_error < error)
+						{
+							a0 = ends[0];
+							a1 = ends[1];
+							indices = candidate_indices;
+							error = candidate_error;
+							improved = true;
+						}
+					}
+				}
+				if(!improved)
+					break;
+			}
+		}
+
+		block[0] = (core::uint8)a0;
+		block[1] = (core::uint8)a1;
+		for(int i = 2; i < 8; ++i, indices >>= 8)
+			block[i] = (core::uint8)indices;
+	}
+
+	void decode_block(image_dxtn::dxtn_type type, const core::uint8* block, core::rgba* pixels)
+	{
+		core::uint8 values[16];
+		core::uint8 greens[16];
+		switch(type)
+		{
+			case image_dxtn::dxtn_type_dxt1 :
+				decode_colour(block, false, pixels);
+				break;
+
+			case image_dxtn::dxtn_type_dxt3 :
+				decode_colour(block + 8, true, pixels);
+				decode_explicit_values(block, values);
+				set_alpha(values, pixels);
+				break;
+
+			case image_dxtn::dxtn_type_dxt5 :
+				decode_colour(block + 8, true, pixels);
+				decode_interpolated_values(block, values);
+				set_alpha(values, pixels);
+				break;
+
+			case image_dxtn::dxtn_type_bc4 :
+				decode_interpolated_values(block, values);
+				for(int i = 0; i < 16; ++i)
+					pixels[i] = core::rgba(values[i], 0, 0, 255);
+				break;
+
+			case image_dxtn::dxtn_type_bc5 :
+				decode_interpolated_values(block, values);
+				decode_interpolated_values(block + 8, greens);
+				for(int i = 0; i < 16; ++i)
+					pixels[i] = core::rgba(values[i], greens[i], 0, 255);
+				break;
+		}
+	}
+
+	static void decode_block_row_scalar(image_dxtn::dxtn_type type, const core::uint8* blocks, int num_blocks, core::uint8* dst, int pitch)
+	{
+		const int block_bytes = get_block_bytes(type);
+		core::rgba pixels[16];
+		for(int b = 0; b < num_blocks; ++b, blocks += block_bytes, dst += 16)
+		{
+			decode_block(type, blocks, pixels);
+			for(int row = 0; row < 4; ++row)
+				memcpy(dst + row * pitch, pixels + row * 4, 16);
+		}
+	}
+
+#if TYCHO_IMAGE_SSE
+
+	/// Colour blocks select each pixel from the palette with a compare per entry against the
+	/// indices of a row of the block spread across the lanes, alpha is merged into the top byte.
+	/// bc4 and bc5 blocks go through the scalar decoder.
+	TYCHO_IMAGE_TARGET("sse2") static void decode_block_row_sse2(image_dxtn::dxtn_type type, const core::uint8* blocks, int num_blocks, core::uint8* dst, int pitch)
+	{
+		if(type == image_dxtn::dxtn_type_bc4 || type == image_dxtn::dxtn_type_bc5)
+		{
+			decode_block_row_scalar(type, blocks, num_blocks, dst, pitch);
+			return;
+		}
+
+		const int block_bytes = get_block_bytes(type);
+		const bool has_alpha = type != image_dxtn::dxtn_type_dxt1;
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i lane_mask = _mm_setr_epi32(3, 3 << 2, 3 << 4, 3 << 6);
+		const __m128i lane_step = _mm_setr_epi32(1, 1 << 2, 1 << 4, 1 << 6);
+		const __m128i colour_mask = _mm_set1_epi32(0x00ffffff);
+		core::uint8 alphas[16];
+		for(int b = 0; b < num_blocks; ++b, blocks += block_bytes, dst += 16)
+		{
+			const core::uint8* colour = has_alpha ? blocks + 8 : blocks;
+			int palette[4][4];
+			build_colour_palette(read16(colour), read16(colour + 2), has_alpha, palette);
+			__m128i entries[4];
+			for(int k = 0; k < 4; ++k)
+			{
+				const core::uint32 packed = palette[k][0] | (palette[k][1] << 8) | (palette[k][2] << 16) | ((core::uint32)palette[k][3] << 24);
+				entries[k] = _mm_set1_epi32((int)packed);
+			}
+			if(type == image_dxtn::dxtn_type_dxt3)
+				decode_explicit_values(blocks, alphas);
+			else if(type == image_dxtn::dxtn_type_dxt5)
+				decode_interpolated_values(blocks, alphas);
+
+			for(int row = 0; row < 4; ++row)
+			{
+				const __m128i indices = _mm_and_si128(_mm_set1_epi32(colour[4 + row]), lane_mask);
+				__m128i key = zero;
+				__m128i out = zero;
+				for(int k = 0; k < 4; ++k, key = _mm_add_epi32(key, lane_step))
+					out = _mm_or_si128(out, _mm_and_si128(_mm_cmpeq_epi32(indices, key), entries[k]));
+				if(has_alpha)
+				{
+					int row_alphas;
+					memcpy(&row_alphas, alphas + row * 4, 4);
+					__m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128(row_alphas), zero);
+					a = _mm_slli_epi32(_mm_unpacklo_epi16(a, zero), 24);
+					out = _mm_or_si128(_mm_and_si128(out, colour_mask), a);
+				}
+				_mm_storeu_si128((__m128i*)(dst + row * pitch), out);
+			}
+		}
+	}
+
+#endif
+
+	typedef void (*decode_block_row_fn)(image_dxtn::dxtn_type, const core::uint8*, int, core::uint8*, int);
+
+	static decode_block_row_fn select_decode_block_row()
+	{
+#if TYCHO_IMAGE_SSE
+		if(get_cpu_features().sse2)
+			return &decode_block_row_sse2;
+#endif
+		return &decode_block_row_scalar;
+	}
+
+	void decode_block_row(image_dxtn::dxtn_type type, const core::uint8* blocks, int num_blocks, core::uint8* dst, int pitch)
+	{
+		static const decode_block_row_fn decode_fn = select_decode_block_row();
+		decode_fn(type, blocks, num_blocks, dst, pitch);
+	}
+
+	/// gathers one channel of the pixels for the interpolated block encoder
+	static void gather_channel(const core::rgba* pixels, colour_channel channel, core::uint8* values)
+	{
+		for(int i = 0; i < 16; ++i)
+		{
+			switch(channel)
+			{
+				case colour_channel_red : values[i] = (core::uint8)pixels[i].r(); break;
+				case colour_channel_green : values[i] = (core::uint8)pixels[i].g(); break;
+				case colour_channel_blue : values[i] = (core::uint8)pixels[i].b(); break;
+				case colour_channel_alpha : values[i] = (core::uint8)pixels[i].a(); break;
+			}
+		}
+	}
+
+	void encode_block(image_dxtn::dxtn_type type, image_dxtn::dxtn_quality quality, const core::rgba* pixels, core::uint8* block)
+	{
+		core::uint8 values[16];
+		switch(type)
+		{
+			case image_dxtn::dxtn_type_dxt1 :
+				encode_colour(pixels, true, quality, block);
+				break;
+
+			case image_dxtn::dxtn_type_dxt3 :
+				encode_explicit_alpha(pixels, block);
+				encode_colour(pixels, false, quality, block + 8);
+				break;
+
+			case image_dxtn::dxtn_type_dxt5 :
+				gather_channel(pixels, colour_channel_alpha, values);
+				encode_interpolated_values(values, quality, block);
+				encode_colour(pixels, false, quality, block + 8);
+				break;
+
+			case image_dxtn::dxtn_type_bc4 :
+				gather_channel(pixels, colour_channel_red, values);
+				encode_interpolated_values(values, quality, block);
+				break;
+
+			case image_dxtn::dxtn_type_bc5 :
+				gather_channel(pixels, colour_channel_red, values);
+				encode_interpolated_values(values, quality, block);
+				gather_channel(pixels, colour_channel_green, values);
+				encode_interpolated_values(values, quality, block + 8);
+				break;
+		}
+	}
+
+} // end namespace
+} // end namespace
+} // end namespace
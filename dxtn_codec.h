@@ -0,0 +1,55 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:47:33 PM
+//////////////////////////////////////////////////////////////////////////////
+#if _MSC_VER > 1000
+#pragma once
+#endif  // _MSC_VER
+
+#ifndef __DXTN_CODEC_H_97C2D4E1_0B6A_4E38_A5F2_3D8B1C6E7F04_
+#define __DXTN_CODEC_H_97C2D4E1_0B6A_4E38_A5F2_3D8B1C6E7F04_
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/image_abi.h"
+#include "image/image_dxtn.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+// internal to the image library, encoding and decoding of single 4x4 blocks. Blocks are in the
+// layout the gpu expects, multi byte values are little endian.
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	/// decodes a block to 16 pixels in row order
+	void decode_block(image_dxtn::dxtn_type, const core::uint8* block, core::rgba* pixels);
+
+	/// encodes 16 pixels in row order to a block. Colour endpoints are fit with the tier the quality
+	/// selects, see \ref image_dxtn::dxtn_quality. The 4 colour matching and cluster fit searches
+	/// use SSE2 where the cpu has it and produce the same blocks as the scalar code.
+	void encode_block(image_dxtn::dxtn_type, image_dxtn::dxtn_quality, const core::rgba* pixels, core::uint8* block);
+
+	/// decodes a row of blocks to four rows of rgba8888 pixels, row r starts at dst + r * pitch 
+	/// and each block writes 16 bytes to each row. Colour blocks are decoded with SSE2 where the 
+	/// cpu has it.
+	void decode_block_row(image_dxtn::dxtn_type, const core::uint8* blocks, int num_blocks, core::uint8* dst, int pitch);
+
+	/// \returns bytes per block of the type
+	inline int get_block_bytes(image_dxtn::dxtn_type type)
+	{
+		return (type == image_dxtn::dxtn_type_dxt1 || type == image_dxtn::dxtn_type_bc4) ? 8 : 16;
+	}
+
+} // end namespace
+} // end namespace
+} // end namespace
+
+#endif // __DXTN_CODEC_H_97C2D4E1_0B6A_4E38_A5F2_3D8B1C6E7F04_
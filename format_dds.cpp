@@ -9,11 +9,23 @@
 //////////////////////////////////////////////////////////////////////////////
 #include "image/format_dds.h"
 #include "image/image.h"
+#include "image/image_a8.h"
+#include "image/image_rgba16.h"
+#include "image/image_rgb24.h"
 #include "image/image_rgba32.h"
+#include "image/image_dxtn.h"
+#include "image/image_array.h"
+#include "image/image_functions.h"
+#include "image/pixel_allocator.h"
+#include "image/dxtn_codec.h"
 #include "image/canvas.h"
 #include "core/colour/rgba.h"
 #include "core/debug/assert.h"
 #include "core/memory.h"
+#include "io/memory_stream.h"
+#include <algorithm>
+#include <climits>
+#include <string.h>
 #include <vector>
 
 //////////////////////////////////////////////////////////////////////////////
@@ -43,12 +55,20 @@ namespace dds
 	static const int DDSCAPS_MIPMAP = 0x00400000l;
 
 
-	static const int DDPF_ALPHAPIXELS  = 0x00000001;
+	/// surface is a cube map, the faces present are in the DDSCAPS2_CUBEMAP_* flags
+	static const int DDSCAPS2_CUBEMAP = 0x00000200;
+
+	/// each face of a cube map, a cube map must have all six
+	static const int DDSCAPS2_CUBEMAP_ALLFACES = 0x0000fc00;
 
-    // Unused currently
-    //static const int DDPF_FOURCC = 0x00000004;
+	/// surface is a volume texture
+	static const int DDSCAPS2_VOLUME = 0x00200000;
 
+	static const int DDPF_ALPHAPIXELS  = 0x00000001;
+	static const int DDPF_ALPHA = 0x00000002;
+	static const int DDPF_FOURCC = 0x00000004;
 	static const int DDPF_RGB = 0x00000040;
+	static const int DDPF_LUMINANCE = 0x00020000;
 	
 	static const int DDSD_CAPS = 0x00000001;
 	static const int DDSD_HEIGHT = 0x00000002; 
@@ -56,10 +76,12 @@ namespace dds
 	static const int DDSD_PITCH = 0x00000008;
 	static const int DDSD_PIXELFORMAT = 0x00001000;
 	static const int DDSD_MIPMAPCOUNT = 0x00020000;
+	static const int DDSD_LINEARSIZE = 0x00080000;
+	static const int DDSD_DEPTH = 0x00800000;
 
-    // Unused currently
-    //static const int DDSD_LINEARSIZE = 0x00080000;
-    //static const int DDSD_DEPTH = 0x00800000;
+	static const int D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+	static const int D3D10_RESOURCE_DIMENSION_TEXTURE3D = 4;
+	static const int D3D10_RESOURCE_MISC_TEXTURECUBE = 0x4;
 	
 
 	struct dds_caps2
@@ -107,134 +129,882 @@ namespace dds
 	};
 		
 	
+	/// follows the surface description when the pixel format FourCC is DX10
+	struct dds_header_dx10
+	{
+		core::uint32 dxgi_format;			///< DXGI_FORMAT of the pixels
+		core::uint32 resource_dimension;	///< D3D10_RESOURCE_DIMENSION_*
+		core::uint32 misc_flag;				///< D3D10_RESOURCE_MISC_*
+		core::uint32 array_size;			///< number of elements, of cubes for a cube map
+		core::uint32 misc_flags2;
+	};
+	
 	static const core::int8 magic[4] = { 'D', 'D', 'S', ' ' };
 
-} // end namespace
+	/// size of the magic and surface description at the start of the file
+	static const int HeaderSize = 4 + sizeof(dd_surface_desc2);
 
-	using namespace dds;
-	
-	/// initialise DDS format handler
-	void format_dds::initialise()
+	/// largest number of array elements, cubes or volume slices in a file we load, the d3d limit
+	static const int MaxLayers = 2048;
+
+	/// \returns the four character code as it is stored in the pixel format
+	static core::uint32 make_fourcc(char a, char b, char c, char d)
 	{
+		return (core::uint32)(core::uint8)a | ((core::uint32)(core::uint8)b << 8) | 
+			   ((core::uint32)(core::uint8)c << 16) | ((core::uint32)(core::uint8)d << 24);
+	}
+
+	/// a dxgi format and the legacy pixel format it matches, either a FourCC or masks
+	struct dxgi_format_info
+	{
+		core::uint32 dxgi_format;
+		core::uint32 fourcc;
+		core::uint32 bit_count;
+		core::uint32 rmask, gmask, bmask, amask;
+	};
+
+	/// dxgi formats we load, the first entry matching a pixel format is the one saved
+	static const dxgi_format_info dxgi_formats[] = {
+		{ 28,  0, 32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000 },	// R8G8B8A8_UNORM
+		{ 29,  0, 32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000 },	// R8G8B8A8_UNORM_SRGB
+		{ 87,  0, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 },	// B8G8R8A8_UNORM
+		{ 91,  0, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 },	// B8G8R8A8_UNORM_SRGB
+		{ 88,  0, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0 },			// B8G8R8X8_UNORM
+		{ 85,  0, 16, 0xf800, 0x07e0, 0x001f, 0 },						// B5G6R5_UNORM
+		{ 86,  0, 16, 0x7c00, 0x03e0, 0x001f, 0x8000 },					// B5G5R5A1_UNORM
+		{ 115, 0, 16, 0x0f00, 0x00f0, 0x000f, 0xf000 },					// B4G4R4A4_UNORM
+		{ 65,  0, 8,  0, 0, 0, 0xff },									// A8_UNORM
+		{ 71,  make_fourcc('D', 'X', 'T', '1'), 0, 0, 0, 0, 0 },		// BC1_UNORM
+		{ 72,  make_fourcc('D', 'X', 'T', '1'), 0, 0, 0, 0, 0 },		// BC1_UNORM_SRGB
+		{ 74,  make_fourcc('D', 'X', 'T', '3'), 0, 0, 0, 0, 0 },		// BC2_UNORM
+		{ 75,  make_fourcc('D', 'X', 'T', '3'), 0, 0, 0, 0, 0 },		// BC2_UNORM_SRGB
+		{ 77,  make_fourcc('D', 'X', 'T', '5'), 0, 0, 0, 0, 0 },		// BC3_UNORM
+		{ 78,  make_fourcc('D', 'X', 'T', '5'), 0, 0, 0, 0, 0 },		// BC3_UNORM_SRGB
+		{ 80,  make_fourcc('A', 'T', 'I', '1'), 0, 0, 0, 0, 0 },		// BC4_UNORM
+		{ 83,  make_fourcc('A', 'T', 'I', '2'), 0, 0, 0, 0, 0 }			// BC5_UNORM
+	};
 
+	/// fills out the legacy pixel format matching a dxgi format. \returns false if we don't load it
+	static bool get_dxgi_pixel_format(core::uint32 dxgi_format, dd_pixel_format& pf)
+	{
+		for(size_t i = 0; i < sizeof(dxgi_formats) / sizeof(dxgi_formats[0]); ++i)
+		{
+			const dxgi_format_info& f = dxgi_formats[i];
+			if(f.dxgi_format != dxgi_format)
+				continue;
+			core::mem_zero(pf);
+			pf.dwSize = sizeof(dd_pixel_format);
+			if(f.fourcc)
+			{
+				pf.dwFlags = DDPF_FOURCC;
+				pf.dwFourCC = f.fourcc;
+				return true;
+			}
+			if(f.rmask | f.gmask | f.bmask)
+				pf.dwFlags |= DDPF_RGB;
+			if(f.amask)
+				pf.dwFlags |= (pf.dwFlags & DDPF_RGB) ? DDPF_ALPHAPIXELS : DDPF_ALPHA;
+			pf.dwRGBBitCount = f.bit_count;
+			pf.dwRBitMask = f.rmask;
+			pf.dwGBitMask = f.gmask;
+			pf.dwBBitMask = f.bmask;
+			pf.dwRGBAlphaBitMask = f.amask;
+			return true;
+		}
+		return false;
 	}
 
-	/// \returns true if the signature is a DDS file
-	/// \todo implement format_dds::identify
-	bool format_dds::identify(const char* /*signature*/, int /*signature_len*/)
+	/// \returns the dxgi format matching a legacy pixel format, 0 (DXGI_FORMAT_UNKNOWN) if there isn't one
+	static core::uint32 find_dxgi_format(const dd_pixel_format& pf)
+	{
+		for(size_t i = 0; i < sizeof(dxgi_formats) / sizeof(dxgi_formats[0]); ++i)
+		{
+			const dxgi_format_info& f = dxgi_formats[i];
+			if(pf.dwFlags & DDPF_FOURCC)
+			{
+				if(f.fourcc == pf.dwFourCC)
+					return f.dxgi_format;
+			}
+			else if(!f.fourcc && f.bit_count == pf.dwRGBBitCount && f.rmask == pf.dwRBitMask && f.gmask == pf.dwGBitMask && 
+					f.bmask == pf.dwBBitMask && f.amask == pf.dwRGBAlphaBitMask)
+			{
+				return f.dxgi_format;
+			}
+		}
+		return 0;
+	}
+
+	/// how the surfaces in a file map onto an image
+	struct surface_info
+	{
+		int width;
+		int height;
+		int file_mips;					///< mip levels of each layer in the file, all of them are loaded
+		int num_layers;
+		image_array::array_type array_type;
+		int data_offset;				///< offset of the pixels from the start of the file
+		bool compressed;
+		image_dxtn::dxtn_type dxtn_type;
+		int bytes_per_pixel;
+		image_rgba::pixel_layout layout;
+		bool swap_bytes;				///< pixels must be byte reversed to match the layout, the file can't be viewed in place
+	};
+
+	/// \returns the low num_bytes bytes of v in reverse order
+	static core::uint32 reverse_bytes(core::uint32 v, int num_bytes)
+	{
+		core::uint32 r = 0;
+		for(int i = 0; i < num_bytes; ++i, v >>= 8)
+			r = (r << 8) | (v & 0xff);
+		return r;
+	}
+
+	/// Converts a channel mask of a little endian pixel to a shift and mask of the most significant
+	/// byte first pixels image_rgba uses. If the pixels are to be byte reversed on load the mask is
+	/// used as is. \returns false if the channel bits aren't contiguous or it is wider than 8 bits
+	static bool convert_mask(core::uint32 mask, int bytes_per_pixel, bool swap_bytes, int* shift, int* channel_mask)
+	{
+		*shift = 0;
+		*channel_mask = 0;
+		if(!mask)
+			return true;
+		if(!swap_bytes)
+			mask = reverse_bytes(mask, bytes_per_pixel);
+		while(!(mask & 1))
+		{
+			mask >>= 1;
+			++*shift;
+		}
+		if((mask & (mask + 1)) != 0 || mask > 0xff)
+			return false;
+		*channel_mask = (int)mask;
+		return true;
+	}
+
+	/// maps the channel masks of an uncompressed pixel format onto a pixel layout
+	static bool convert_masks(const dd_pixel_format& pf, surface_info& info)
 	{
+		core::uint32 r = 0, g = 0, b = 0, a = 0;
+		if(pf.dwFlags & DDPF_RGB)
+		{
+			r = pf.dwRBitMask;
+			g = pf.dwGBitMask;
+			b = pf.dwBBitMask;
+		}
+		else if(pf.dwFlags & DDPF_LUMINANCE)
+		{
+			r = g = b = pf.dwRBitMask;
+		}
+		if(pf.dwFlags & (DDPF_ALPHAPIXELS | DDPF_ALPHA))
+			a = pf.dwRGBAlphaBitMask;
+		if(!(r | g | b | a))
+			return false;
+
+		// prefer layouts the file bytes can be used with directly, 16 bit formats usually 
+		// have channels spanning bytes so have to be byte reversed
+		image_rgba::pixel_layout& pl = info.layout;
+		for(int swap = 0; swap < 2; ++swap)
+		{
+			info.swap_bytes = swap != 0;
+			if(convert_mask(r, info.bytes_per_pixel, info.swap_bytes, &pl.rshift, &pl.rmask) &&
+			   convert_mask(g, info.bytes_per_pixel, info.swap_bytes, &pl.gshift, &pl.gmask) &&
+			   convert_mask(b, info.bytes_per_pixel, info.swap_bytes, &pl.bshift, &pl.bmask) &&
+			   convert_mask(a, info.bytes_per_pixel, info.swap_bytes, &pl.ashift, &pl.amask))
+			{
+				return true;
+			}
+		}
 		return false;
 	}
 
-	/// Load a DDS file from a memory buffer
-	image_base_ptr format_dds::load(io::stream&)
+	/// fills out the layers of the surface info from the header. \returns false if they aren't 
+	/// a 2d image, array of 2d images, cube map or volume
+	static bool parse_layers(const dd_surface_desc2& desc, const dds_header_dx10* dx10, surface_info& info)
 	{
-		return image_base_ptr();
+		info.array_type = image_array::array_type_2d;
+		info.num_layers = 1;
+		core::uint32 num_layers = 1;
+		if(dx10)
+		{
+			if(dx10->resource_dimension == D3D10_RESOURCE_DIMENSION_TEXTURE2D)
+			{
+				num_layers = dx10->array_size;
+				if(dx10->misc_flag & D3D10_RESOURCE_MISC_TEXTURECUBE)
+				{
+					if(num_layers == 0 || num_layers > MaxLayers)
+						return false;
+					info.array_type = image_array::array_type_cube;
+					num_layers *= image_array::cube_face_count;
+				}
+			}
+			else if(dx10->resource_dimension == D3D10_RESOURCE_DIMENSION_TEXTURE3D)
+			{
+				info.array_type = image_array::array_type_volume;
+				num_layers = (desc.dwFlags & DDSD_DEPTH) ? desc.dwDepth : 1;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if(desc.caps.caps2 & DDSCAPS2_CUBEMAP)
+		{
+			// cube maps missing faces aren't supported
+			if((desc.caps.caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES)
+				return false;
+			info.array_type = image_array::array_type_cube;
+			num_layers = image_array::cube_face_count;
+		}
+		else if(desc.caps.caps2 & DDSCAPS2_VOLUME)
+		{
+			info.array_type = image_array::array_type_volume;
+			num_layers = (desc.dwFlags & DDSD_DEPTH) ? desc.dwDepth : 1;
+		}
+		const core::uint32 max_layers = info.array_type == image_array::array_type_cube ? MaxLayers * image_array::cube_face_count : MaxLayers;
+		if(num_layers == 0 || num_layers > max_layers)
+			return false;
+		info.num_layers = (int)num_layers;
+		return true;
 	}
 
-	// Save an image as a DDS file
-	bool format_dds::save(image_base_ptr img, io::stream& str)
+	/// fills out the surface info from the header and the DX10 header if there is one.
+	/// \returns false if the file isn't in a format we can load
+	static bool parse_header(const dd_surface_desc2& desc, const dds_header_dx10* dx10, surface_info& info)
 	{
-		if(!img || !img->get_width() || !img->get_height() || str.fail())
+		if(desc.dwSize != sizeof(dd_surface_desc2) || desc.pixel_format.dwSize != sizeof(dd_pixel_format) ||
+		   (desc.dwFlags & (DDSD_WIDTH | DDSD_HEIGHT)) != (DDSD_WIDTH | DDSD_HEIGHT) ||
+		   desc.dwWidth == 0 || desc.dwHeight == 0 || desc.dwWidth > 0x8000 || desc.dwHeight > 0x8000)
+		{
 			return false;
+		}
+		if(!parse_layers(desc, dx10, info))
+			return false;
+		dd_pixel_format pf = desc.pixel_format;
+		if(dx10 && !get_dxgi_pixel_format(dx10->dxgi_format, pf))
+			return false;
+
+		info.width = (int)desc.dwWidth;
+		info.height = (int)desc.dwHeight;
+		info.data_offset = HeaderSize + (dx10 ? (int)sizeof(dds_header_dx10) : 0);
 		
-		// write out the image header
-		const int img_width = img->get_width();
-		const int img_height = img->get_height();
-		const int img_num_mips = img->get_num_mips();
-		dd_surface_desc2 desc;
-		core::mem_zero(desc);
-		desc.dwSize = sizeof(dd_surface_desc2);
-		desc.dwFlags = DDSD_CAPS | DDSD_PIXELFORMAT | DDSD_WIDTH | DDSD_HEIGHT | DDSD_MIPMAPCOUNT | DDSD_PITCH;
-		desc.dwHeight = img_height;
-		desc.dwWidth = img_width;
-		desc.lPitch = img_width * 4;
-		desc.dwDepth = 0;
-		desc.dwMipMapCount = img_num_mips;
-		desc.pixel_format.dwSize = sizeof(desc.pixel_format);
-		desc.pixel_format.dwFlags = DDPF_RGB | DDPF_ALPHAPIXELS;
-		desc.pixel_format.dwRGBBitCount = 32;
-		desc.pixel_format.dwRBitMask = 0x00ff0000;
-		desc.pixel_format.dwGBitMask = 0x0000ff00;
-		desc.pixel_format.dwBBitMask = 0x000000ff;
-		desc.pixel_format.dwRGBAlphaBitMask = 0xff000000;
-		desc.caps.caps = DDSCAPS_TEXTURE;;
-		if(img_num_mips > 1)
-			desc.caps.caps |= (DDSCAPS_MIPMAP | DDSCAPS_COMPLEX);
-		
-		str.write((char*)(&dds::magic[0]), 4);
-		str.write((char*)(&desc), sizeof(dd_surface_desc2));
+		// levels past 1x1 can't be in the file
+		const int full_chain = get_mip_chain_length(info.width, info.height);
+		info.file_mips = ((desc.dwFlags & DDSD_MIPMAPCOUNT) && desc.dwMipMapCount > 0) ? std::min((int)std::min<core::uint32>(desc.dwMipMapCount, 32), full_chain) : 1;
+		core::mem_zero(info.layout);
+		info.swap_bytes = false;
+		info.bytes_per_pixel = 0;
+		info.dxtn_type = image_dxtn::dxtn_type_dxt1;
+		info.compressed = (pf.dwFlags & DDPF_FOURCC) != 0;
+		if(info.compressed)
+		{
+			// pre-multiplied dxt2 and dxt4 are loaded as dxt3 and dxt5
+			const core::uint32 fourcc = pf.dwFourCC;
+			if(fourcc == make_fourcc('D', 'X', 'T', '1'))
+				info.dxtn_type = image_dxtn::dxtn_type_dxt1;
+			else if(fourcc == make_fourcc('D', 'X', 'T', '2') || fourcc == make_fourcc('D', 'X', 'T', '3'))
+				info.dxtn_type = image_dxtn::dxtn_type_dxt3;
+			else if(fourcc == make_fourcc('D', 'X', 'T', '4') || fourcc == make_fourcc('D', 'X', 'T', '5'))
+				info.dxtn_type = image_dxtn::dxtn_type_dxt5;
+			else if(fourcc == make_fourcc('A', 'T', 'I', '1') || fourcc == make_fourcc('B', 'C', '4', 'U'))
+				info.dxtn_type = image_dxtn::dxtn_type_bc4;
+			else if(fourcc == make_fourcc('A', 'T', 'I', '2') || fourcc == make_fourcc('B', 'C', '5', 'U'))
+				info.dxtn_type = image_dxtn::dxtn_type_bc5;
+			else
+				return false;
+			return true;
+		}
 
-		// loop over mip levels writing them out in bgra format
-		image_rgba32 line_buf(image_rgba::pixel_layout_bgra8888);
-		line_buf.resize_canvas(img_width, 1, 1, false);
-		canvas dst_c;
-		if(!line_buf.get_mip_level(0, &dst_c))
+		switch(pf.dwRGBBitCount)
+		{
+			case 8: case 16: case 24: case 32: break;
+			default: return false;
+		}
+		info.bytes_per_pixel = (int)pf.dwRGBBitCount / 8;
+		return convert_masks(pf, info);
+	}
+
+	/// \returns size in bytes of a mip level in the file
+	static core::int64 get_level_size(const surface_info& info, int mip_level)
+	{
+		const core::int64 w = std::max(info.width >> mip_level, 1);
+		const core::int64 h = std::max(info.height >> mip_level, 1);
+		if(info.compressed)
+			return ((w + 3) / 4) * ((h + 3) / 4) * detail::get_block_bytes(info.dxtn_type);
+		return w * h * info.bytes_per_pixel;
+	}
+
+	/// \returns size in bytes of all the levels of a layer in the file
+	static core::int64 get_file_layer_size(const surface_info& info)
+	{
+		core::int64 size = 0;
+		for(int m = 0; m < info.file_mips; ++m)
+			size += get_level_size(info, m);
+		return size;
+	}
+
+	/// \returns number of layers holding a mip level, volumes halve their depth each level
+	static int get_num_layers(const surface_info& info, int mip_level)
+	{
+		if(info.array_type == image_array::array_type_volume)
+			return std::max(info.num_layers >> mip_level, 1);
+		return info.num_layers;
+	}
+
+	/// \returns size in bytes of the pixels in the file we load. Volumes store each level for 
+	/// every slice in turn, the other types each layer's mip chain in turn
+	static core::int64 get_data_size(const surface_info& info)
+	{
+		if(info.array_type == image_array::array_type_volume)
+		{
+			core::int64 size = 0;
+			for(int m = 0; m < info.file_mips; ++m)
+				size += get_level_size(info, m) * get_num_layers(info, m);
+			return size;
+		}
+		return info.num_layers * get_file_layer_size(info);
+	}
+
+	/// \returns true if the pixels in the file fit the int sizes images and streams use, every
+	/// layer and level is then small enough too
+	static bool has_valid_size(const surface_info& info)
+	{
+		return get_data_size(info) <= INT_MAX;
+	}
+
+	/// \returns a new empty image for the surface, 0 if there is none
+	static image_base* new_image(const surface_info& info)
+	{
+		if(info.compressed)
+			return new image_dxtn(info.dxtn_type);
+		switch(info.bytes_per_pixel)
+		{
+			case 1: return new image_a8(info.layout);
+			case 2: return new image_rgba16(info.layout);
+			case 3: return new image_rgb24(info.layout);
+			case 4: return new image_rgba32(info.layout);
+		}
+		return 0;
+	}
+
+	/// \returns an empty image for the surface
+	static image_base_ptr create_image(const surface_info& info)
+	{
+		return image_base_ptr(new_image(info));
+	}
+
+	/// \returns an array of layers which are views over pixels, layer i starts at pixels + i * stride. 
+	/// If pixels is null the layers are views over storage allocated by the array, which they 
+	/// share.
+	static image_array_ptr create_array(const surface_info& info, core::uint8* pixels, int stride)
+	{
+		image_array_ptr arr(new image_array(info.array_type));
+		const bool own_storage = !pixels;
+		if(own_storage)
+		{
+			const core::int64 storage_size = (core::int64)stride * info.num_layers;
+			if(storage_size > INT_MAX)
+				return image_array_ptr();
+			pixels = arr->allocate_storage((int)storage_size);
+			if(!pixels)
+				return image_array_ptr();
+		}
+		for(int i = 0; i < info.num_layers; ++i)
+		{
+			image_base_ptr img = own_storage ? arr->share_storage(new_image(info)) : create_image(info);
+			if(!img || !img->create_view(info.width, info.height, info.file_mips, pixels + (core::int64)i * stride) || !arr->add_layer(img))
+				return image_array_ptr();
+		}
+		return arr;
+	}
+
+	/// reverses the bytes of each pixel in the buffer
+	static void swap_pixel_bytes(core::uint8* pixels, int size, int bytes_per_pixel)
+	{
+		for(core::uint8* end = pixels + size; pixels < end; pixels += bytes_per_pixel)
+			std::reverse(pixels, pixels + bytes_per_pixel);
+	}
+
+	/// reads a mip level from the stream straight into the image
+	static bool read_level(const surface_info& info, image_base& img, int mip_level, io::stream& str)
+	{
+		canvas c;
+		if(!img.get_mip_level(mip_level, &c))
 			return false;
-		for(int i = 0; i < img_num_mips; ++i)
+		const int size = (int)get_level_size(info, mip_level);
+		const int row_bytes = c.get_width() * info.bytes_per_pixel;
+		if(info.compressed || c.get_pitch() == row_bytes)
 		{
-			canvas src_c;
-			if(!img->get_mip_level(i, &src_c))
+			if(str.read((char*)c.get_pixels(), size) != size || str.fail())
 				return false;
-			int width = src_c.get_width();
-			int height = src_c.get_height();
-			for(int y = 0; y < height; ++y)
-			{
-				line_buf.copy(0, 0, 0, y, width, 1, src_c, dst_c);				
-				str.write((const char*)dst_c.get_pixels(), width * 4);
-			}			
+			if(info.swap_bytes)
+				swap_pixel_bytes(c.get_pixels(), size, info.bytes_per_pixel);
+			return true;
 		}
 		
+		// padded rows are read one at a time
+		for(int y = 0; y < c.get_height(); ++y)
+		{
+			if(str.read((char*)c.get_row(y), row_bytes) != row_bytes || str.fail())
+				return false;
+			if(info.swap_bytes)
+				swap_pixel_bytes(c.get_row(y), row_bytes, info.bytes_per_pixel);
+		}
 		return true;
 	}
 
-	/// Save a mip level in an image as a DDS file
-	bool format_dds::save(image_base_ptr img, int mip_level, io::stream& str)
+	/// \returns the image read from the stream after the header, each level is read straight into the image
+	static image_base_ptr read_surface(const surface_info& info, io::stream& str)
 	{
-		if(!img || !img->get_width() || !img->get_height())
+		image_base_ptr img = create_image(info);
+		if(!img || !img->resize_canvas(info.width, info.height, info.file_mips, false))
+			return image_base_ptr();
+		for(int m = 0; m < info.file_mips; ++m)
+		{
+			if(!read_level(info, *img, m, str))
+				return image_base_ptr();
+		}
+		return img;
+	}
+
+	/// \returns the layers read from the stream after the header into a single allocation, each 
+	/// level is read straight into its layer
+	static image_array_ptr read_layers(const surface_info& info, io::stream& str)
+	{
+		image_array_ptr arr = create_array(info, 0, (int)get_file_layer_size(info));
+		if(!arr)
+			return image_array_ptr();
+		if(info.array_type == image_array::array_type_volume)
+		{
+			for(int m = 0; m < info.file_mips; ++m)
+			{
+				for(int i = 0; i < get_num_layers(info, m); ++i)
+				{
+					if(!read_level(info, *arr->get_layer(i), m, str))
+						return image_array_ptr();
+				}
+			}
+			return arr;
+		}
+
+		for(int i = 0; i < info.num_layers; ++i)
+		{
+			for(int m = 0; m < info.file_mips; ++m)
+			{
+				if(!read_level(info, *arr->get_layer(i), m, str))
+					return image_array_ptr();
+			}
+		}
+		return arr;
+	}
+
+	/// reads and parses the header at the start of the stream, leaving it at the pixels
+	static bool read_header(io::stream& str, surface_info& info)
+	{
+		char header[HeaderSize];
+		if(str.read(header, HeaderSize) != HeaderSize || str.fail() || memcmp(header, magic, 4) != 0)
+			return false;
+		dd_surface_desc2 desc;
+		core::mem_cpy(&desc, header + 4, sizeof(desc));
+		dds_header_dx10 dx10;
+		const bool has_dx10 = (desc.pixel_format.dwFlags & DDPF_FOURCC) && desc.pixel_format.dwFourCC == make_fourcc('D', 'X', '1', '0');
+		if(has_dx10 && (str.read((char*)&dx10, sizeof(dx10)) != (int)sizeof(dx10) || str.fail()))
 			return false;
+		return parse_header(desc, has_dx10 ? &dx10 : 0, info) && has_valid_size(info);
+	}
 
-		canvas src_c;
-		if(!img->get_mip_level(mip_level, &src_c))
+	/// parses the header of a file in memory, checking the pixels we load are all there
+	static bool read_header(const core::uint8* data, int data_len, surface_info& info)
+	{
+		if(!data || data_len < HeaderSize || memcmp(data, magic, 4) != 0)
 			return false;
-				
-		// write out the image header
-		const int img_width = src_c.get_width();
-		const int img_height = src_c.get_height();
 		dd_surface_desc2 desc;
-		core::mem_zero(desc);
-		desc.dwSize = sizeof(dd_surface_desc2);
-		desc.dwFlags = DDSD_CAPS | DDSD_PIXELFORMAT | DDSD_WIDTH | DDSD_HEIGHT | DDSD_PITCH;
-		desc.dwHeight = img_height;
-		desc.dwWidth = img_width;
-		desc.lPitch = img_width * 4;
-		desc.pixel_format.dwSize = sizeof(desc.pixel_format);
-		desc.pixel_format.dwFlags = DDPF_RGB | DDPF_ALPHAPIXELS;
-		desc.pixel_format.dwRGBBitCount = 32;
-		desc.pixel_format.dwRBitMask = 0x00ff0000;
-		desc.pixel_format.dwGBitMask = 0x0000ff00;
-		desc.pixel_format.dwBBitMask = 0x000000ff;
-		desc.pixel_format.dwRGBAlphaBitMask = 0xff000000;
-		desc.caps.caps = DDSCAPS_TEXTURE;;
+		core::mem_cpy(&desc, data + 4, sizeof(desc));
+		dds_header_dx10 dx10;
+		const bool has_dx10 = (desc.pixel_format.dwFlags & DDPF_FOURCC) && desc.pixel_format.dwFourCC == make_fourcc('D', 'X', '1', '0');
+		if(has_dx10)
+		{
+			if(data_len < HeaderSize + (int)sizeof(dx10))
+				return false;
+			core::mem_cpy(&dx10, data + HeaderSize, sizeof(dx10));
+		}
+		return parse_header(desc, has_dx10 ? &dx10 : 0, info) && has_valid_size(info) && data_len - info.data_offset >= get_data_size(info);
+	}
+
+	/// how the pixels of an image are written to the file
+	enum write_mode
+	{
+		write_blocks,		///< dxtn blocks as they are
+		write_native,		///< pixels as they are
+		write_swapped,		///< pixels byte reversed, a channel spans bytes of the little endian pixel
+		write_bgra			///< pixels converted to 32 bit bgra
+	};
+
+	/// \returns true if the set bits of the mask are contiguous
+	static bool is_contiguous(core::uint32 mask)
+	{
+		if(!mask)
+			return true;
+		while(!(mask & 1))
+			mask >>= 1;
+		return (mask & (mask + 1)) == 0;
+	}
+
+	/// \returns the four character code of a block compression scheme
+	static core::uint32 get_fourcc(image_dxtn::dxtn_type type)
+	{
+		switch(type)
+		{
+			case image_dxtn::dxtn_type_dxt1 : return make_fourcc('D', 'X', 'T', '1');
+			case image_dxtn::dxtn_type_dxt3 : return make_fourcc('D', 'X', 'T', '3');
+			case image_dxtn::dxtn_type_dxt5 : return make_fourcc('D', 'X', 'T', '5');
+			case image_dxtn::dxtn_type_bc4  : return make_fourcc('A', 'T', 'I', '1');
+			case image_dxtn::dxtn_type_bc5  : return make_fourcc('A', 'T', 'I', '2');
+		}
+		return 0;
+	}
+
+	/// fills out the pixel format for 32 bit bgra. \returns write_bgra
+	static write_mode set_bgra_format(dd_pixel_format& pf, int* bytes_per_pixel)
+	{
+		pf.dwFlags = DDPF_RGB | DDPF_ALPHAPIXELS;
+		pf.dwFourCC = 0;
+		pf.dwRGBBitCount = 32;
+		pf.dwRBitMask = 0x00ff0000;
+		pf.dwGBitMask = 0x0000ff00;
+		pf.dwBBitMask = 0x000000ff;
+		pf.dwRGBAlphaBitMask = 0xff000000;
+		*bytes_per_pixel = 4;
+		return write_bgra;
+	}
+
+	/// Fills out the pixel format for the image in its own layout. The masks of an image_rgba 
+	/// are of its most significant byte first pixels, written as they are they become the byte 
+	/// reversed masks of a little endian pixel. Where that leaves a channel split across bytes 
+	/// the pixels are byte reversed on write and the masks kept. Formats dds can't describe are 
+	/// converted to 32 bit bgra. \returns how the pixels must be written
+	static write_mode setup_pixel_format(const image_base& img, dd_pixel_format& pf, int* bytes_per_pixel)
+	{
+		pf.dwSize = sizeof(dd_pixel_format);
+		*bytes_per_pixel = 0;
+		if(img.get_image_format() == image_format_dxtn)
+		{
+			pf.dwFlags = DDPF_FOURCC;
+			pf.dwFourCC = get_fourcc(static_cast<const image_dxtn&>(img).get_dxtn_type());
+			return write_blocks;
+		}
+		if(!image_rgba::is_rgba_format(img.get_image_format()))
+			return set_bgra_format(pf, bytes_per_pixel);
 		
-		str.write((char*)(&dds::magic[0]), 4);
-		str.write((char*)(&desc), sizeof(dd_surface_desc2));
+		const image_rgba& rgba_img = static_cast<const image_rgba&>(img);
+		const image_rgba::pixel_layout& pl = rgba_img.get_pixel_layout();
+		const int bpp = rgba_img.get_bytes_per_pixel();
+		core::uint32 masks[4] = { 
+			(core::uint32)pl.rmask << pl.rshift, 
+			(core::uint32)pl.gmask << pl.gshift, 
+			(core::uint32)pl.bmask << pl.bshift, 
+			(core::uint32)pl.amask << pl.ashift 
+		};
+		write_mode mode = write_native;
+		for(int i = 0; i < 4; ++i)
+		{
+			if(!is_contiguous(reverse_bytes(masks[i], bpp)))
+				mode = write_swapped;
+		}
+		if(mode == write_native)
+		{
+			for(int i = 0; i < 4; ++i)
+				masks[i] = reverse_bytes(masks[i], bpp);
+		}
+		
+		// grey is written as luminance in the red mask
+		pf.dwFlags = 0;
+		if(pl.is_luminance())
+		{
+			pf.dwFlags |= DDPF_LUMINANCE;
+			masks[1] = masks[2] = 0;
+		}
+		else if(masks[0] | masks[1] | masks[2])
+		{
+			pf.dwFlags |= DDPF_RGB;
+		}
+		if(masks[3])
+			pf.dwFlags |= (pf.dwFlags & (DDPF_RGB | DDPF_LUMINANCE)) ? DDPF_ALPHAPIXELS : DDPF_ALPHA;
+		pf.dwRGBBitCount = bpp * 8;
+		pf.dwRBitMask = masks[0];
+		pf.dwGBitMask = masks[1];
+		pf.dwBBitMask = masks[2];
+		pf.dwRGBAlphaBitMask = masks[3];
+		*bytes_per_pixel = bpp;
+		return mode;
+	}
 
-		// loop over mip levels writing them out in bgra format
-		image_rgba32 line_buf(8, 0xff, 16, 0xff, 24, 0xff, 0, 0xff);
-		line_buf.resize_canvas(img_width, 1, 1, false);
-		canvas dst_c;
-		if(!line_buf.get_mip_level(0, &dst_c))
-			return false;
-		int width = src_c.get_width();
-		int height = src_c.get_height();
+	/// writes a mip level as 32 bit bgra a row at a time through a line buffer
+	static void write_bgra_rows(image_base& img, int mip_level, int width, int height, io::stream& str, pixel_arena* arena)
+	{
+		image_rgba32 line_buf(image_rgba::pixel_layout_bgra8888);
+		canvas line_c;
+		if(arena)
+			line_buf.set_allocator(*arena);
+		if(!line_buf.resize_canvas(width, 1, 1, false) || !line_buf.get_mip_level(0, &line_c))
+			return;
+		detail::temp_buffer<core::rgba> row(width, arena);
 		for(int y = 0; y < height; ++y)
 		{
-			line_buf.copy(0, 0, 0, y, width, 1, src_c, dst_c);				
-			str.write((const char*)dst_c.get_pixels(), width * 4);
+			img.read_row(mip_level, 0, y, width, &row[0]);
+			line_buf.write_row(&row[0], 0, 0, 0, width);
+			str.write((const char*)line_c.get_pixels(), width * 4);
 		}			
+	}
+
+	/// writes the pixels of a mip level, levels that need no conversion are written with a single write
+	static bool write_level(image_base& img, int mip_level, write_mode mode, int bytes_per_pixel, io::stream& str, pixel_arena* arena)
+	{
+		canvas c;
+		if(!img.get_mip_level(mip_level, &c))
+			return false;
+		const int row_bytes = c.get_width() * bytes_per_pixel;
+		switch(mode)
+		{
+			case write_blocks:
+				str.write((const char*)c.get_pixels(), c.get_byte_size());
+				break;
+				
+			case write_native:
+				if(c.get_pitch() == row_bytes)
+				{
+					str.write((const char*)c.get_pixels(), row_bytes * c.get_height());
+				}
+				else
+				{
+					for(int y = 0; y < c.get_height(); ++y)
+						str.write((const char*)c.get_row(y), row_bytes);
+				}
+				break;
+				
+			case write_swapped:
+			{
+				detail::temp_buffer<core::uint8> row(row_bytes, arena);
+				for(int y = 0; y < c.get_height(); ++y)
+				{
+					core::mem_cpy(&row[0], c.get_row(y), row_bytes);
+					swap_pixel_bytes(&row[0], row_bytes, bytes_per_pixel);
+					str.write((const char*)&row[0], row_bytes);
+				}
+				break;
+			}
+			
+			case write_bgra:
+				write_bgra_rows(img, mip_level, c.get_width(), c.get_height(), str, arena);
+				break;
+		}
+		return !str.fail();
+	}
+
+	/// Writes num_mips levels starting at first_mip of the image, or of each layer of the array 
+	/// if there is one, as a dds file. Cube maps and volumes have legacy headers, arrays of more
+	/// than one image or cube a DX10 header, pixels with no dxgi format are converted to bgra.
+	/// Line buffers come from the arena if there is one.
+	static bool save_levels(image_base& img, image_array* arr, int first_mip, int num_mips, io::stream& str, pixel_arena* arena)
+	{
+		canvas top;
+		if(!img.get_mip_level(first_mip, &top))
+			return false;
+		dd_surface_desc2 desc;
+		core::mem_zero(desc);
+		int bytes_per_pixel;
+		write_mode mode = setup_pixel_format(img, desc.pixel_format, &bytes_per_pixel);
+		const image_array::array_type array_type = arr ? arr->get_array_type() : image_array::array_type_2d;
+		const int num_layers = arr ? arr->get_num_layers() : 1;
+		const bool need_dx10 = (array_type == image_array::array_type_2d && num_layers > 1) ||
+							   (array_type == image_array::array_type_cube && num_layers > image_array::cube_face_count);
+		dds_header_dx10 dx10;
+		core::mem_zero(dx10);
+		if(need_dx10)
+		{
+			dx10.dxgi_format = find_dxgi_format(desc.pixel_format);
+			if(!dx10.dxgi_format)
+			{
+				mode = set_bgra_format(desc.pixel_format, &bytes_per_pixel);
+				dx10.dxgi_format = find_dxgi_format(desc.pixel_format);
+			}
+			dx10.resource_dimension = D3D10_RESOURCE_DIMENSION_TEXTURE2D;
+			dx10.array_size = num_layers;
+			if(array_type == image_array::array_type_cube)
+			{
+				dx10.misc_flag = D3D10_RESOURCE_MISC_TEXTURECUBE;
+				dx10.array_size = num_layers / image_array::cube_face_count;
+			}
+		}
+		
+		desc.dwSize = sizeof(dd_surface_desc2);
+		desc.dwFlags = DDSD_CAPS | DDSD_PIXELFORMAT | DDSD_WIDTH | DDSD_HEIGHT;
+		desc.dwHeight = top.get_height();
+		desc.dwWidth = top.get_width();
+		if(mode == write_blocks)
+		{
+			desc.dwFlags |= DDSD_LINEARSIZE;
+			desc.dwLinearSize = top.get_byte_size();
+		}
+		else
+		{
+			desc.dwFlags |= DDSD_PITCH;
+			desc.lPitch = top.get_width() * bytes_per_pixel;
+		}
+		desc.caps.caps = DDSCAPS_TEXTURE;
+		if(num_mips > 1)
+		{
+			desc.dwFlags |= DDSD_MIPMAPCOUNT;
+			desc.dwMipMapCount = num_mips;
+			desc.caps.caps |= (DDSCAPS_MIPMAP | DDSCAPS_COMPLEX);
+		}
+		if(array_type == image_array::array_type_cube)
+		{
+			desc.caps.caps |= DDSCAPS_COMPLEX;
+			desc.caps.caps2 = DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES;
+		}
+		else if(array_type == image_array::array_type_volume)
+		{
+			desc.dwFlags |= DDSD_DEPTH;
+			desc.dwDepth = num_layers;
+			desc.caps.caps |= DDSCAPS_COMPLEX;
+			desc.caps.caps2 = DDSCAPS2_VOLUME;
+		}
+		if(need_dx10)
+		{
+			desc.pixel_format.dwFlags = DDPF_FOURCC;
+			desc.pixel_format.dwFourCC = make_fourcc('D', 'X', '1', '0');
+		}
 		
-		return true;		
+		str.write((const char*)(&dds::magic[0]), 4);
+		str.write((const char*)(&desc), sizeof(dd_surface_desc2));
+		if(need_dx10)
+			str.write((const char*)(&dx10), sizeof(dx10));
+		if(!arr)
+		{
+			for(int m = first_mip; m < first_mip + num_mips; ++m)
+			{
+				if(!write_level(img, m, mode, bytes_per_pixel, str, arena))
+					return false;
+			}
+		}
+		else if(array_type == image_array::array_type_volume)
+		{
+			for(int m = first_mip; m < first_mip + num_mips; ++m)
+			{
+				for(int i = 0; i < arr->get_num_layers(m); ++i)
+				{
+					if(!write_level(*arr->get_layer(i), m, mode, bytes_per_pixel, str, arena))
+						return false;
+				}
+			}
+		}
+		else
+		{
+			for(int i = 0; i < num_layers; ++i)
+			{
+				for(int m = first_mip; m < first_mip + num_mips; ++m)
+				{
+					if(!write_level(*arr->get_layer(i), m, mode, bytes_per_pixel, str, arena))
+						return false;
+				}
+			}
+		}
+		return !str.fail();
+	}
+
+} // end namespace
+
+	using namespace dds;
+	
+	/// initialise DDS format handler
+	void format_dds::initialise()
+	{
+
+	}
+
+	/// \returns true if the signature is a DDS file
+	bool format_dds::identify(const char* signature, int signature_len)
+	{
+		return signature && signature_len >= 4 && memcmp(signature, dds::magic, 4) == 0;
+	}
+
+	/// Load a DDS file from a stream
+	image_base_ptr format_dds::load(io::stream& str)
+	{
+		surface_info info;
+		if(!read_header(str, info) || info.num_layers != 1)
+			return image_base_ptr();
+		return read_surface(info, str);
+	}
+
+	/// Load a DDS file held in memory
+	image_base_ptr format_dds::load(core::uint8* data, int data_len)
+	{
+		surface_info info;
+		if(!read_header(data, data_len, info) || info.num_layers != 1)
+			return image_base_ptr();
+
+		// byte reversed pixels are loaded into the image as from a stream
+		if(info.swap_bytes)
+		{
+			io::memory_stream str((char*)data + info.data_offset, data_len - info.data_offset);
+			return read_surface(info, str);
+		}
+		image_base_ptr img = create_image(info);
+		if(!img || !img->create_view(info.width, info.height, info.file_mips, data + info.data_offset))
+			return image_base_ptr();
+		return img;
+	}
+
+	/// Load the layers of a DDS file from a stream
+	image_array_ptr format_dds::load_array(io::stream& str)
+	{
+		surface_info info;
+		if(!read_header(str, info))
+			return image_array_ptr();
+		return read_layers(info, str);
+	}
+
+	/// Load the layers of a DDS file held in memory
+	image_array_ptr format_dds::load_array(core::uint8* data, int data_len)
+	{
+		surface_info info;
+		if(!read_header(data, data_len, info))
+			return image_array_ptr();
+
+		// the slices of a volume are interleaved by level so can't be viewed in place
+		if(info.swap_bytes || info.array_type == image_array::array_type_volume)
+		{
+			io::memory_stream str((char*)data + info.data_offset, data_len - info.data_offset);
+			return read_layers(info, str);
+		}
+		return create_array(info, data + info.data_offset, (int)get_file_layer_size(info));
+	}
+
+	// Save an image as a DDS file
+	bool format_dds::save(image_base_ptr img, io::stream& str, pixel_arena* arena)
+	{
+		if(!img || !img->get_width() || !img->get_height() || str.fail())
+			return false;
+		return save_levels(*img, 0, 0, img->get_num_mips(), str, arena);
+	}
+
+	/// Save a mip level in an image as a DDS file
+	bool format_dds::save(image_base_ptr img, int mip_level, io::stream& str, pixel_arena* arena)
+	{
+		if(!img || !img->get_width() || !img->get_height() || str.fail())
+			return false;
+		return save_levels(*img, 0, mip_level, 1, str, arena);
+	}
+
+	/// Save the layers of an array as a DDS file
+	bool format_dds::save_array(image_array_ptr arr, io::stream& str, pixel_arena* arena)
+	{
+		if(!arr || !arr->get_num_layers() || !arr->get_width() || !arr->get_height() || str.fail())
+			return false;
+		if(arr->get_array_type() == image_array::array_type_cube && !arr->is_complete_cube())
+			return false;
+		return save_levels(*arr->get_layer(0), arr.get(), 0, arr->get_num_mips(), str, arena);
 	}
 
 	bool format_dds::save_rgba(image_base_ptr, io::stream&)
@@ -37,16 +37,38 @@ namespace image
 		/// \returns true if the signature is a DDS file
 		static bool identify(const char* signature, int signature_len);
 
-		/// Load a DDS file from a memory buffer
+		/// Load a DDS file from a stream, each mip level in the file is read straight into the 
+		/// image. Files with more than one layer are loaded with load_array.
 		static image_base_ptr load(io::stream&);
 
-		/// Save an image as a DDS file
-		/// \warning currently always converts to 32bit rgba.
-		static bool save(image_base_ptr, io::stream&);
+		/// Load a DDS file held in memory. Where the pixels in the file are in a layout the image 
+		/// can use directly the image is a view over the file bytes, which must then outlive it 
+		/// and aren't copied. Otherwise they are loaded into the image.
+		static image_base_ptr load(core::uint8* data, int data_len);
 
-		/// Save a mip level in an image as a DDS file
-		/// \warning currently always converts to 32bit rgba.
-		static bool save(image_base_ptr, int, io::stream&);
+		/// Save an image as a DDS file in its own pixel format. Block compressed images are saved
+		/// as their blocks and rgba images with bit masks of their layout, levels that need no 
+		/// conversion are written with a single write. Other formats are converted to 32 bit bgra
+		/// through a line buffer that comes from the arena if there is one.
+		static bool save(image_base_ptr, io::stream&, pixel_arena* arena = 0);
+
+		/// Save a mip level in an image as a DDS file, see save above
+		static bool save(image_base_ptr, int, io::stream&, pixel_arena* arena = 0);
+
+		/// Load a DDS file from a stream as an array of layers, for cube maps, volumes and
+		/// arrays in either legacy or DX10 headers. A 2d image loads as an array of one. The
+		/// layers share a single aligned allocation, which lasts as long as the array or any layer.
+		static image_array_ptr load_array(io::stream&);
+
+		/// Load a DDS file held in memory as an array of layers. Where the pixels can be used
+		/// directly the layers are views over the file bytes, which must outlive the array. 
+		/// Volumes are always loaded as their slices are interleaved by mip level.
+		static image_array_ptr load_array(core::uint8* data, int data_len);
+
+		/// Save the layers of an array as a DDS file. Cube maps and volumes are saved with a 
+		/// legacy header and arrays of more than one image or cube with a DX10 header. Array
+		/// layers in a format with no DXGI equivalent are converted to 32 bit bgra.
+		static bool save_array(image_array_ptr, io::stream&, pixel_arena* arena = 0);
 
 	private:
 		static bool save_rgba(image_base_ptr, io::stream&);
@@ -13,8 +13,18 @@
 #include "core/memory/allocator.h"
 #include "core/console.h"
 #include "image/libpng/png.h"
+#include "image_a8.h"
+#include "image_rgba16.h"
 #include "image_rgb24.h"
 #include "image_rgba32.h"
+#include "image_rgba64.h"
+#include "pixel_allocator.h"
+#include "pixel_convert.h"
+#include "png_filter.h"
+#include "tile_scheduler.h"
+#include <algorithm>
+#include <mutex>
+#include <string.h>
 
 /// \todo Need to decide how to deal with libpng errors
 //////////////////////////////////////////////////////////////////////////////
@@ -26,14 +36,55 @@ namespace image
 {
 namespace detail
 {
+	/// bytes read from the stream at a time when loading
+	static const int ReadBufferSize = 16 * 1024;
+
+	/// rows filtered at a time before they are deflated when writing a single stream
+	static const int FilterBlockRows = 128;
+
+	/// previous rows whose filters weighted filtering favours repeating
+	static const int FilterHistoryRows = 4;
+
+	/// most bytes written in each IDAT chunk when writing a single stream
+	static const int IdatChunkSize = 64 * 1024;
+
+	/// chunk names for the chunks written when rows are filtered by the library
+	static png_byte png_chunk_IDAT[5] = { 73,  68,  65,  84, '\0'};
+	static png_byte png_chunk_IEND[5] = { 73,  69,  78,  68, '\0'};
+
+	/// libpng allocations come from the arena passed as the memory pointer if there is one
 	png_voidp libpng_malloc(png_structp png_ptr, png_size_t size)
 	{
+		pixel_arena* arena = reinterpret_cast<pixel_arena*>(png_get_mem_ptr(png_ptr));
+		if(arena)
+			return arena->allocate(static_cast<int>(size));
 		return core::allocator::malloc(size);
 	}
 	
 	void libpng_free(png_structp png_ptr, png_voidp ptr)
 	{
-		core::allocator::free((void*)ptr);
+		if(!png_get_mem_ptr(png_ptr))
+			core::allocator::free((void*)ptr);
+	}
+
+	/// zlib allocations from the arena in the opaque pointer
+	voidpf zlib_arena_alloc(voidpf opaque, uInt items, uInt size)
+	{
+		return reinterpret_cast<pixel_arena*>(opaque)->allocate(static_cast<int>(items * size));
+	}
+
+	void zlib_arena_free(voidpf, voidpf)
+	{
+	}
+
+	/// routes the allocations of a zlib stream to the arena if there is one
+	static void set_zlib_allocator(z_stream& z, pixel_arena* arena)
+	{
+		if(!arena)
+			return;
+		z.zalloc = zlib_arena_alloc;
+		z.zfree = zlib_arena_free;
+		z.opaque = arena;
 	}
 
 	
@@ -80,6 +131,631 @@ namespace detail
     {
     }
 
+	/// progressive read state, rows are decoded into the canvas of the image
+	struct png_read_state
+	{
+		png_read_state() : read(0), info(0), complete(false), failed(false), opaque_16bit(false) {}
+		~png_read_state()
+		{
+			png_destroy_read_struct(read ? &read : (png_structpp)NULL,
+									info ? &info : (png_infopp)NULL,
+									(png_infopp)NULL);
+		}
+
+		png_structp read;
+		png_infop info;
+		image_base_ptr img;
+		canvas dst;
+		bool complete;
+		bool failed;
+		bool opaque_16bit;	///< 16 bit rows had an alpha channel added that must be set opaque
+	};
+
+	/// \returns true if the cpu is little endian
+	static bool is_little_endian()
+	{
+		const core::uint16 one = 1;
+		return *reinterpret_cast<const core::uint8*>(&one) == 1;
+	}
+
+	/// \returns true if the rows of the image are in a png layout and can be written as they 
+	/// are, sets the colour type and bit depth to write them with
+	static bool get_native_png_format(const image_base& img, int* colour_type, int* bit_depth)
+	{
+		*bit_depth = 8;
+		switch(img.get_image_format())
+		{
+			case image_format_a8 :
+				*colour_type = PNG_COLOR_TYPE_GRAY;
+				return static_cast<const image_rgba&>(img).get_pixel_layout() == image_rgba::pixel_layout_l8;
+
+			case image_format_rgba16 :
+				*colour_type = PNG_COLOR_TYPE_GRAY_ALPHA;
+				return static_cast<const image_rgba&>(img).get_pixel_layout() == image_rgba::pixel_layout_la88;
+
+			case image_format_rgba24 :
+				*colour_type = PNG_COLOR_TYPE_RGB;
+				return static_cast<const image_rgba&>(img).get_pixel_layout() == image_rgba::pixel_layout_rgb888;
+
+			case image_format_rgba32 :
+				*colour_type = PNG_COLOR_TYPE_RGB_ALPHA;
+				return static_cast<const image_rgba&>(img).get_pixel_layout() == image_rgba::pixel_layout_rgba8888;
+
+			case image_format_rgba64 :
+				*colour_type = PNG_COLOR_TYPE_RGB_ALPHA;
+				*bit_depth = 16;
+				return true;
+
+			default : break;
+		}
+		return false;
+	}
+
+	/// \returns the zlib strategy constant, auto is filtered when rows are filtered as libpng does
+	static int get_zlib_strategy(const png_options& options)
+	{
+		switch(options.strategy)
+		{
+			case png_options::strategy_auto : 
+				return (options.filters & png_options::filter_all) == png_options::filter_none ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+			case png_options::strategy_filtered : return Z_FILTERED;
+			case png_options::strategy_huffman_only : return Z_HUFFMAN_ONLY;
+			case png_options::strategy_rle : return Z_RLE;
+			default : break;
+		}
+		return Z_DEFAULT_STRATEGY;
+	}
+
+	/// \returns mask of png filter types from the png_options filter flags, none if there are none
+	static int get_filter_types(const png_options& options)
+	{
+		const int types = (options.filters & png_options::filter_all) / png_options::filter_none;
+		return types ? types : 1;
+	}
+
+	/// Rows of an image in the byte layout they are written to the file in. Rows already in that 
+	/// layout are returned in place, others are converted into a line buffer, with a converter 
+	/// specialised for the two layouts if there is one. 16 bit rows are swapped to big endian.
+	/// Line buffers come from the arena if there is one.
+	class png_row_source
+	{
+	public:
+		png_row_source(image_base_ptr img, pixel_arena* arena) :
+			m_rgba_row(arena),
+			m_line_bytes(arena),
+			m_convert(0),
+			m_colour_type(0),
+			m_bit_depth(8),
+			m_row_bytes(0),
+			m_swap(false)
+		{
+			if(!img->get_mip_level(0, &m_src))
+				return;
+			const int width = m_src.get_width();
+			if(get_native_png_format(*img, &m_colour_type, &m_bit_depth))
+			{
+				m_swap = m_bit_depth == 16 && is_little_endian();
+				if(m_swap)
+					m_line_bytes.resize(width * image_rgba64::BytesPerPixel);
+			}
+			else
+			{
+				if(img->has_channel(colour_channel_alpha))
+				{
+					m_colour_type = PNG_COLOR_TYPE_RGB_ALPHA;
+					m_line = image_base_ptr(new image_rgba32(image_rgba::pixel_layout_rgba8888));
+				}
+				else
+				{
+					m_colour_type = PNG_COLOR_TYPE_RGB;
+					m_line = image_base_ptr(new image_rgb24(image_rgba::pixel_layout_rgb888));
+				}
+				if(arena)
+					static_cast<image_rgba&>(*m_line).set_allocator(*arena);
+				if(!m_line->resize_canvas(width, 1, 1, false) || !m_line->get_mip_level(0, &m_line_c))
+					return;
+				if(image_rgba::is_rgba_format(img->get_image_format()))
+					m_convert = find_row_converter(static_cast<const image_rgba&>(*img), static_cast<const image_rgba&>(*m_line));
+				if(!m_convert)
+					m_rgba_row.resize(width);
+			}
+			m_row_bytes = width * get_channels(m_colour_type) * m_bit_depth / 8;
+		}
+
+		/// \returns false if the image has no rows
+		bool is_valid() const
+			{ return m_row_bytes != 0; }
+
+		/// \returns png colour type of the rows
+		int get_colour_type() const
+			{ return m_colour_type; }
+
+		/// \returns bits per channel of the rows
+		int get_bit_depth() const
+			{ return m_bit_depth; }
+
+		/// \returns bytes in each row
+		int get_row_bytes() const
+			{ return m_row_bytes; }
+
+		/// \returns bytes per pixel, the distance the sub, avg and paeth filters look back
+		int get_pixel_bytes() const
+			{ return get_channels(m_colour_type) * m_bit_depth / 8; }
+
+		/// \returns row y, valid until the next call
+		const core::uint8* get_row(int y)
+		{
+			if(m_swap)
+			{
+				const core::uint8* src = m_src.get_row(y);
+				for(int i = 0; i < m_row_bytes; i += 2)
+				{
+					m_line_bytes[i] = src[i + 1];
+					m_line_bytes[i + 1] = src[i];
+				}
+				return &m_line_bytes[0];
+			}
+			if(!m_line)
+				return m_src.get_row(y);
+			if(m_convert)
+			{
+				m_convert(m_src.get_row(y), m_line_c.get_pixels(), m_src.get_width());
+			}
+			else
+			{
+				m_src.read_row(0, y, m_src.get_width(), &m_rgba_row[0]);
+				m_line_c.write_row(&m_rgba_row[0], 0, 0, m_src.get_width());
+			}
+			return m_line_c.get_pixels();
+		}
+
+	private:
+		/// \returns channels of the colour type
+		static int get_channels(int colour_type)
+		{
+			switch(colour_type)
+			{
+				case PNG_COLOR_TYPE_GRAY_ALPHA : return 2;
+				case PNG_COLOR_TYPE_RGB : return 3;
+				case PNG_COLOR_TYPE_RGB_ALPHA : return 4;
+				default : break;
+			}
+			return 1;
+		}
+
+	private:
+		canvas m_src;
+		image_base_ptr m_line;
+		canvas m_line_c;
+		temp_buffer<core::rgba> m_rgba_row;
+		temp_buffer<core::uint8> m_line_bytes;
+		convert_row_fn m_convert;
+		int m_colour_type;
+		int m_bit_depth;
+		int m_row_bytes;
+		bool m_swap;
+	};
+
+	/// A row source and the row buffers to filter its rows with. Setting one up can allocate a 
+	/// line image so they are handed between bands by png_scratch_pool rather than made per band.
+	struct png_filter_scratch
+	{
+		png_filter_scratch(image_base_ptr img, pixel_arena* arena) :
+			rows(img, arena),
+			prev(rows.get_row_bytes(), arena),
+			cur(rows.get_row_bytes(), arena),
+			scratch(rows.get_row_bytes() + 1, arena)
+		{}
+
+		/// filters rows [first, last) into dst, each row preceded by its filter type. The row 
+		/// above the first is the one before it or zeros for the top of the image
+		void filter(int types, int first, int last, core::uint8* dst)
+		{
+			const int row_bytes = rows.get_row_bytes();
+			const int bpp = std::max(rows.get_pixel_bytes(), 1);
+			if(first > 0)
+				core::mem_cpy(&prev[0], rows.get_row(first - 1), row_bytes);
+			else
+				memset(&prev[0], 0, row_bytes);
+			for(int y = first; y < last; ++y)
+			{
+				core::mem_cpy(&cur[0], rows.get_row(y), row_bytes);
+				filter_png_row_best(types, &cur[0], &prev[0], row_bytes, bpp, dst + (y - first) * (row_bytes + 1), &scratch[0]);
+				prev.swap(cur);
+			}
+		}
+
+		png_row_source rows;
+		temp_buffer<core::uint8> prev;
+		temp_buffer<core::uint8> cur;
+		temp_buffer<core::uint8> scratch;
+	};
+
+	/// Filter scratch for the bands of one save. A band takes a set no other band is using or 
+	/// makes one, so no more are made than there are threads filtering at once.
+	class png_scratch_pool
+	{
+	public:
+		png_scratch_pool(image_base_ptr img, pixel_arena* arena) :
+			m_img(img), m_arena(arena)
+		{}
+
+		~png_scratch_pool()
+		{
+			for(size_t i = 0; i < m_free.size(); ++i)
+				delete m_free[i];
+		}
+
+		/// \returns scratch for the calling band, give it back with release
+		png_filter_scratch* acquire()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if(!m_free.empty())
+				{
+					png_filter_scratch* scratch = m_free.back();
+					m_free.pop_back();
+					return scratch;
+				}
+			}
+			return new png_filter_scratch(m_img, m_arena);
+		}
+
+		/// returns scratch from acquire to the pool
+		void release(png_filter_scratch* scratch)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_free.push_back(scratch);
+		}
+
+	private:
+		/// non-copyable
+		png_scratch_pool(const png_scratch_pool&);
+		void operator=(const png_scratch_pool&);
+
+	private:
+		image_base_ptr m_img;
+		pixel_arena* m_arena;
+		std::mutex m_mutex;
+		std::vector<png_filter_scratch*> m_free;
+	};
+
+	/// filtered and deflated rows of a strip
+	struct png_strip
+	{
+		png_strip() : data(0), size(0), capacity(0), adler(0), filtered_bytes(0), ok(false) {}
+
+		core::uint8* data;		///< from the allocator of the png_strip_list
+		int size;				///< bytes of data written
+		int capacity;			///< bytes of data allocated
+		uLong adler;			///< adler-32 of the filtered rows
+		uLong filtered_bytes;
+		bool ok;
+	};
+
+	/// the strips of an image, their output is drawn from the arena if there is one and freed 
+	/// with the list
+	class png_strip_list
+	{
+	public:
+		explicit png_strip_list(pixel_arena* arena) :
+			m_strips(arena),
+			m_allocator(arena ? static_cast<pixel_allocator*>(arena) : &get_default_pixel_allocator())
+		{}
+
+		~png_strip_list()
+		{
+			free();
+		}
+
+		/// replaces the strips with count empty ones
+		void resize(int count)
+		{
+			free();
+			m_strips.resize(count);
+		}
+
+		/// grows the output of a strip to at least capacity bytes, keeping what has been written
+		/// \returns false if it couldn't be allocated
+		bool reserve(png_strip& strip, int capacity)
+		{
+			if(capacity <= strip.capacity)
+				return true;
+			core::uint8* data = m_allocator->allocate(capacity);
+			if(!data)
+				return false;
+			if(strip.size)
+				core::mem_cpy(data, strip.data, strip.size);
+			if(strip.data)
+				m_allocator->deallocate(strip.data, strip.capacity);
+			strip.data = data;
+			strip.capacity = capacity;
+			return true;
+		}
+
+		/// \returns the i'th strip
+		png_strip& operator[](int i)
+			{ return m_strips[i]; }
+
+		/// \returns number of strips
+		int size() const
+			{ return m_strips.size(); }
+
+		/// \returns true if there are no strips
+		bool empty() const
+			{ return m_strips.size() == 0; }
+
+	private:
+		/// non-copyable
+		png_strip_list(const png_strip_list&);
+		void operator=(const png_strip_list&);
+
+		void free()
+		{
+			for(int i = 0; i < m_strips.size(); ++i)
+				if(m_strips[i].data)
+					m_allocator->deallocate(m_strips[i].data, m_strips[i].capacity);
+			m_strips.resize(0);
+		}
+
+	private:
+		temp_buffer<png_strip> m_strips;
+		pixel_allocator* m_allocator;
+	};
+
+	/// Filters and deflates strips of rows on their own so they can run on separate threads. 
+	/// Every strip but the last ends with a full flush so it starts on a byte boundary with an
+	/// empty dictionary and the raw deflate output of the strips joins into one stream. The first
+	/// strip leaves room at the front for the zlib header and the last room at the end for the
+	/// adler-32 of the stream.
+	class png_deflate_task : public row_task
+	{
+	public:
+		/// bytes in front of the first strip for the zlib header
+		static const int HeaderBytes = 2;
+
+		/// bytes after the last strip for the adler-32
+		static const int TrailerBytes = 4;
+
+		png_deflate_task(image_base_ptr img, const png_options& options, int strip_rows, png_strip_list& strips, png_scratch_pool& pool, pixel_arena* arena) :
+			m_img(img), m_options(options), m_strip_rows(strip_rows), m_strips(strips), m_pool(pool), m_arena(arena)
+		{}
+
+		virtual void run(int begin, int end)
+		{
+			png_filter_scratch* scratch = m_pool.acquire();
+			if(scratch->rows.is_valid())
+			{
+				for(int s = begin; s < end; ++s)
+					deflate_strip(*scratch, s);
+			}
+			m_pool.release(scratch);
+		}
+
+	private:
+		void deflate_strip(png_filter_scratch& scratch, int s)
+		{
+			const int row_bytes = scratch.rows.get_row_bytes();
+			const int first = s * m_strip_rows;
+			const int last = std::min(first + m_strip_rows, m_img->get_height());
+			temp_buffer<core::uint8> filtered((last - first) * (row_bytes + 1), m_arena);
+			scratch.filter(get_filter_types(m_options), first, last, &filtered[0]);
+
+			png_strip& strip = m_strips[s];
+			strip.filtered_bytes = static_cast<uLong>(filtered.size());
+			strip.adler = adler32(adler32(0, Z_NULL, 0), &filtered[0], static_cast<uInt>(filtered.size()));
+
+			z_stream z;
+			memset(&z, 0, sizeof(z));
+			set_zlib_allocator(z, m_arena);
+			if(deflateInit2(&z, m_options.compression_level, Z_DEFLATED, -MAX_WBITS, 8, get_zlib_strategy(m_options)) != Z_OK)
+				return;
+			const bool last_strip = last == m_img->get_height();
+			const int flush = last_strip ? Z_FINISH : Z_FULL_FLUSH;
+			const int head = s == 0 ? HeaderBytes : 0;
+			const int tail = last_strip ? TrailerBytes : 0;
+			int ret = Z_MEM_ERROR;
+			if(m_strips.reserve(strip, head + static_cast<int>(deflateBound(&z, strip.filtered_bytes)) + 16 + tail))
+			{
+				strip.size = head;
+				z.next_in = &filtered[0];
+				z.avail_in = static_cast<uInt>(filtered.size());
+				z.next_out = strip.data + head;
+				z.avail_out = static_cast<uInt>(strip.capacity - head - tail);
+				for(;;)
+				{
+					ret = deflate(&z, flush);
+					strip.size = head + static_cast<int>(z.total_out);
+					if(ret == Z_STREAM_END || (ret == Z_OK && z.avail_out != 0) || (ret != Z_OK && ret != Z_BUF_ERROR))
+						break;
+					if(!m_strips.reserve(strip, strip.capacity * 2))
+					{
+						ret = Z_MEM_ERROR;
+						break;
+					}
+					z.next_out = strip.data + strip.size;
+					z.avail_out = static_cast<uInt>(strip.capacity - strip.size - tail);
+				}
+			}
+			strip.ok = last_strip ? ret == Z_STREAM_END : ret == Z_OK;
+			deflateEnd(&z);
+		}
+
+	private:
+		image_base_ptr m_img;
+		const png_options& m_options;
+		const int m_strip_rows;
+		png_strip_list& m_strips;
+		png_scratch_pool& m_pool;
+		pixel_arena* m_arena;
+	};
+
+	/// filters a block of rows into a buffer, rows are filtered independently from the
+	/// unfiltered row above so they can be split across threads
+	class png_filter_task : public row_task
+	{
+	public:
+		png_filter_task(int types, int first_row, temp_buffer<core::uint8>& filtered, png_scratch_pool& pool) :
+			m_types(types), m_first_row(first_row), m_filtered(filtered), m_pool(pool)
+		{}
+
+		virtual void run(int begin, int end)
+		{
+			png_filter_scratch* scratch = m_pool.acquire();
+			if(scratch->rows.is_valid())
+			{
+				const int row_bytes = scratch->rows.get_row_bytes();
+				scratch->filter(m_types, m_first_row + begin, m_first_row + end, &m_filtered[begin * (row_bytes + 1)]);
+			}
+			m_pool.release(scratch);
+		}
+
+		/// set the image row the first row of the buffer is filtered from
+		void set_first_row(int first_row)
+			{ m_first_row = first_row; }
+
+	private:
+		const int m_types;
+		int m_first_row;
+		temp_buffer<core::uint8>& m_filtered;
+		png_scratch_pool& m_pool;
+	};
+
+	/// deflates filtered rows into a single zlib stream, writing IDAT chunks as they fill
+	class png_idat_writer
+	{
+	public:
+		png_idat_writer(pixel_arena* arena) : m_write(0), m_buffer(arena), m_open(false)
+		{
+			memset(&m_z, 0, sizeof(m_z));
+			set_zlib_allocator(m_z, arena);
+		}
+
+		~png_idat_writer()
+		{
+			if(m_open)
+				deflateEnd(&m_z);
+		}
+
+		/// \returns false if zlib fails to start
+		bool open(png_structp write, const png_options& options)
+		{
+			m_write = write;
+			m_buffer.resize(IdatChunkSize);
+			m_open = deflateInit2(&m_z, options.compression_level, Z_DEFLATED, MAX_WBITS, 8, get_zlib_strategy(options)) == Z_OK;
+			return m_open;
+		}
+
+		/// deflates the bytes, finish ends the stream and writes the last chunk
+		bool write(core::uint8* data, int len, bool finish)
+		{
+			m_z.next_in = data;
+			m_z.avail_in = static_cast<uInt>(len);
+			const int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+			for(;;)
+			{
+				m_z.next_out = &m_buffer[0];
+				m_z.avail_out = static_cast<uInt>(m_buffer.size());
+				const int ret = deflate(&m_z, flush);
+				if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+					return false;
+				const size_t have = m_buffer.size() - m_z.avail_out;
+				if(have)
+					png_write_chunk(m_write, png_chunk_IDAT, &m_buffer[0], have);
+				if(finish ? ret == Z_STREAM_END : (m_z.avail_in == 0 && m_z.avail_out != 0))
+					return true;
+				if(ret == Z_BUF_ERROR && !have)
+					return !finish && m_z.avail_in == 0;
+			}
+		}
+
+	private:
+		png_structp m_write;
+		z_stream m_z;
+		temp_buffer<core::uint8> m_buffer;
+		bool m_open;
+	};
+
+	/// Header decoded, sets up the transforms and creates the image the rows are decoded into.
+	/// libpng expands palettes with a table lookup per row, low bit depth grey to 8 bits and
+	/// transparent colours to alpha so every 8 bit file decodes straight into grey (an l8 
+	/// image_a8), grey with alpha, rgb or rgba. 16 bit files decode to native endian rgba in an 
+	/// image_rgba64.
+	void libpng_progressive_info(png_structp png_ptr, png_infop info_ptr)
+	{
+		png_read_state* state = reinterpret_cast<png_read_state*>(png_get_progressive_ptr(png_ptr));
+		const int colour_type = png_get_color_type(png_ptr, info_ptr);
+		const bool has_trns = png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS) != 0;
+		if(colour_type == PNG_COLOR_TYPE_PALETTE)
+			png_set_palette_to_rgb(png_ptr);
+		if(colour_type == PNG_COLOR_TYPE_GRAY && png_get_bit_depth(png_ptr, info_ptr) < 8)
+			png_set_expand_gray_1_2_4_to_8(png_ptr);
+		if(has_trns)
+			png_set_tRNS_to_alpha(png_ptr);
+		if(png_get_bit_depth(png_ptr, info_ptr) == 16)
+		{
+			if(!(colour_type & PNG_COLOR_MASK_COLOR))
+				png_set_gray_to_rgb(png_ptr);
+			// libpng only keeps 8 bits of the filler, rows are made opaque as they arrive
+			if(!(colour_type & PNG_COLOR_MASK_ALPHA) && !has_trns)
+			{
+				png_set_add_alpha(png_ptr, 0xffff, PNG_FILLER_AFTER);
+				state->opaque_16bit = true;
+			}
+			if(is_little_endian())
+				png_set_swap(png_ptr);
+		}
+		png_set_interlace_handling(png_ptr);
+		png_read_update_info(png_ptr, info_ptr);
+
+		const int width = (int)png_get_image_width(png_ptr, info_ptr);
+		const int height = (int)png_get_image_height(png_ptr, info_ptr);
+		if(png_get_bit_depth(png_ptr, info_ptr) == 8)
+		{
+			switch(png_get_color_type(png_ptr, info_ptr))
+			{
+				case PNG_COLOR_TYPE_GRAY : state->img = image_base_ptr(new image_a8(image_rgba::pixel_layout_l8)); break;
+				case PNG_COLOR_TYPE_GRAY_ALPHA : state->img = image_base_ptr(new image_rgba16(image_rgba::pixel_layout_la88)); break;
+				case PNG_COLOR_TYPE_RGB : state->img = image_base_ptr(new image_rgb24()); break;
+				case PNG_COLOR_TYPE_RGB_ALPHA : state->img = image_base_ptr(new image_rgba32()); break;
+			}
+		}
+		else if(png_get_color_type(png_ptr, info_ptr) == PNG_COLOR_TYPE_RGB_ALPHA)
+		{
+			state->img = image_base_ptr(new image_rgba64());
+		}
+		if(!state->img)
+			png_error(png_ptr, "unsupported format");
+		if(!width || !height || !state->img->resize_canvas(width, height, 1, false) || 
+		   !state->img->get_mip_level(0, &state->dst) ||
+		   png_get_rowbytes(png_ptr, info_ptr) > (png_uint_32)state->dst.get_pitch())
+		{
+			png_error(png_ptr, "unable to create image");
+		}
+	}
+
+	/// a row has been decoded, combines it into the image. Interlaced images deliver each row 
+	/// once per pass, new_row is null when a pass has nothing new for it.
+	void libpng_progressive_row(png_structp png_ptr, png_bytep new_row, png_uint_32 row_num, int)
+	{
+		png_read_state* state = reinterpret_cast<png_read_state*>(png_get_progressive_ptr(png_ptr));
+		if(!new_row || (int)row_num >= state->dst.get_height())
+			return;
+		png_progressive_combine_row(png_ptr, state->dst.get_row(row_num), new_row);
+		if(state->opaque_16bit)
+		{
+			core::uint16* alpha = state->dst.get_row_as<core::uint16>(row_num) + 3;
+			for(int x = 0; x < state->dst.get_width(); ++x, alpha += 4)
+				*alpha = 0xffff;
+		}
+	}
+
+	/// image complete
+	void libpng_progressive_end(png_structp png_ptr, png_infop)
+	{
+		png_read_state* state = reinterpret_cast<png_read_state*>(png_get_progressive_ptr(png_ptr));
+		state->complete = true;
+	}
 	
 } // end namespace
 
@@ -96,123 +772,49 @@ namespace detail
 	}
 
 	/// Load a PNG file from a stream
-	image_base_ptr format_png::load(io::stream& stream)
+	image_base_ptr format_png::load(io::stream& stream, pixel_arena* arena)
 	{
-		struct libpng_read_ptrs
-		{
-			libpng_read_ptrs() : info(0), read(0) {}
-			~libpng_read_ptrs() 
-			{ 
-				png_destroy_read_struct(read ? &read : (png_structpp)NULL,
-				                        info ? &info : (png_infopp)NULL,
-				                        end ? & end : (png_infopp)NULL);				                        
-			}
-			
-			png_infop  info;
-			png_infop  end;
-			png_structp read;			
-		} ptrs;			
-			
-
-		ptrs.read = png_create_read_struct_2(PNG_LIBPNG_VER_STRING, 
-									png_voidp_NULL,
-									detail::libpng_error, 
-									detail::libpng_warning, 
-									png_voidp_NULL,
-									detail::libpng_malloc,
-									detail::libpng_free);		
-		if(!ptrs.read)
-			return image_base_ptr();
-										
-		png_set_read_fn(ptrs.read, (png_voidp)&stream, detail::libpng_read_stream);
-				
-		ptrs.info = png_create_info_struct(ptrs.read);
-		if(!ptrs.info)
-			return image_base_ptr();
-		
-		ptrs.end = png_create_info_struct(ptrs.read);
-		if(!ptrs.end)
-			return image_base_ptr();
-		
-		image_base_ptr result;
-		png_read_png(ptrs.read, ptrs.info, PNG_TRANSFORM_IDENTITY, NULL);
-		if(ptrs.info->width && ptrs.info->height)
+		png_reader reader(arena);
+		detail::temp_buffer<char> buf(detail::ReadBufferSize, arena);
+		while(!reader.is_complete())
 		{
-			switch(ptrs.info->color_type)
-			{
-				case PNG_COLOR_TYPE_GRAY : break;
-				case PNG_COLOR_TYPE_PALETTE : {
-					// expand to rgb
-					png_colorp palette = ptrs.info->palette;
-					if(!palette)
-						return image_base_ptr();						
-					result = image_base_ptr(new image_rgb24());
-					result->resize_canvas(ptrs.info->width, ptrs.info->height, 1, false);
-					for(int y = 0; y < (int)ptrs.info->height; ++y)
-					{
-						core::uint8* row = ptrs.info->row_pointers[y];
-						for(int x = 0; x < (int)ptrs.info->width; ++x, ++row)
-						{
-							const png_color &c = palette[*row];
-							result->put_pixel(core::rgba(c.red, c.green, c.blue), 0, x, y);
-						}
-					}
-				} break;
-				
-				case PNG_COLOR_TYPE_RGB : {
-					if(ptrs.info->bit_depth == 8)
-					{
-						result = image_base_ptr(new image_rgb24());
-						result->resize_canvas(ptrs.info->width, ptrs.info->height, 1, false);
-						// just copy all rows
-						for(int y = 0; y < (int)ptrs.info->height; ++y)
-						{
-							result->raw_copy(0, 0, y, ptrs.info->width, 1, (const core::uint8*)ptrs.info->row_pointers[y], 4 * ptrs.info->width);
-						}
-					}
-				} break;
-				
-				case PNG_COLOR_TYPE_RGB_ALPHA : {
-					if(ptrs.info->bit_depth == 8)
-					{
-						result = image_base_ptr(new image_rgba32());
-						result->resize_canvas(ptrs.info->width, ptrs.info->height, 1, false);
-						// just copy all rows
-						for(int y = 0; y < (int)ptrs.info->height; ++y)
-						{
-							result->raw_copy(0, 0, y, ptrs.info->width, 1, (const core::uint8*)ptrs.info->row_pointers[y], 4 * ptrs.info->width);
-						}
-					}
-				} break;
-				
-				case PNG_COLOR_TYPE_GRAY_ALPHA : break;
-			}
+			const int len = stream.read(&buf[0], detail::ReadBufferSize);
+			if(len <= 0 || !reader.process(reinterpret_cast<const core::uint8*>(&buf[0]), len))
+				return image_base_ptr();
 		}
-		
-		return result;
+		return reader.get_image();
 	}
 	
 	/// Save the image in PNG format
 	bool format_png::save(image_base_ptr img, io::stream& str)
 	{
-		if(!img)
-			return false;
-			
-		switch(img->get_image_format())
-		{
-			case image_format_rgba16 :
-			case image_format_rgba24 :
-			case image_format_rgba32 : return format_png::save_rgba(img, str);
-			default : TYCHO_NOT_IMPLEMENTED;
-		}
-		
-		return false;
+		return save(img, str, png_options());
 	}
 
-	bool format_png::save_rgba(image_base_ptr img, io::stream& str)
+	/// Save the image in PNG format
+	bool format_png::save(image_base_ptr img, io::stream& str, const png_options& options, pixel_arena* arena)
 	{	
 		if(!img || !img->get_width() || !img->get_height())
 			return false;
+		detail::png_row_source rows(img, arena);
+		if(!rows.is_valid())
+			return false;
+		const int width = img->get_width();
+		const int height = img->get_height();
+
+		// strips are filtered and deflated before libpng is set up so its long jumps can't skip
+		// past the worker threads
+		detail::png_scratch_pool scratch(img, arena);
+		detail::png_strip_list strips(arena);
+		if(options.strip_rows > 0 && height > options.strip_rows && !options.weighted_filters)
+		{
+			strips.resize((height + options.strip_rows - 1) / options.strip_rows);
+			detail::png_deflate_task task(img, options, options.strip_rows, strips, scratch, arena);
+			detail::parallel_rows(strips.size(), 1, task);
+			for(int i = 0; i < strips.size(); ++i)
+				if(!strips[i].ok)
+					return false;
+		}
 			
 		struct libpng_write_ptrs
 		{
@@ -232,62 +834,152 @@ namespace detail
 											   png_voidp_NULL,
 											   detail::libpng_error, 
 											   detail::libpng_warning, 
-											   png_voidp_NULL,
+											   (png_voidp)arena,
 											   detail::libpng_malloc,
 											   detail::libpng_free);		
 		if(!ptrs.write)
 			return false;
-
-		png_set_write_fn(ptrs.write, (png_voidp)&str, detail::libpng_write_to_stream, detail::libpng_null_flush);			
-		
 		ptrs.info = png_create_info_struct(ptrs.write);		
 		if(!ptrs.info)
 		   return false;
-		   
-		//TODO : we cheat here and just save everything as rgba 32 bit, should just use the whatever the source image has
-		canvas src_c;
-		if(!img->get_mip_level(0, &src_c))
-			return false;		
-		
-		// convert to canonical form, rgba 8 bits per pixel, slow and waste of memory but simple for now.
-		std::vector<core::rgba> tmp_buf;
-		int width = src_c.get_width();
-		int height = src_c.get_height();
-		tmp_buf.resize(width * height);
-		core::rgba* dst_ptr = &tmp_buf[0];
-		for(int y = 0; y < height; ++y)
-		{
-			for(int x = 0; x < width; ++x)
-			{
-				*dst_ptr = src_c.get_pixel(x, y);
-				if(!img->has_channel(colour_channel_alpha))
-					dst_ptr->a(255);
-				++dst_ptr;
-			}
-		}
 
-		// setup row pointers
-		std::vector<png_bytep> row_pointers;
-		row_pointers.resize(height);
-		for(int i = 0; i < height; ++i)
-			row_pointers[i] = reinterpret_cast<png_bytep>(&tmp_buf[i * width]);		
-				
-		// fill out the PNG header
+		// libpng errors long jump back here, everything above outlives them
+		detail::png_idat_writer idat(arena);
+		detail::temp_buffer<core::uint8> filtered(arena);
+		detail::png_filter_task task(detail::get_filter_types(options), 0, filtered, scratch);
+		if(setjmp(png_jmpbuf(ptrs.write)))
+			return false;
+		png_set_write_fn(ptrs.write, (png_voidp)&str, detail::libpng_write_to_stream, detail::libpng_null_flush);			
         png_set_IHDR(ptrs.write,
                      ptrs.info,
                      width,
                      height,
-                     8, // bit_depth
-                     PNG_COLOR_TYPE_RGB_ALPHA,
-                     false,
+                     rows.get_bit_depth(),
+                     rows.get_colour_type(),
+                     PNG_INTERLACE_NONE,
                      PNG_COMPRESSION_TYPE_BASE,
-                     PNG_FILTER_TYPE_DEFAULT);                         			
-		png_set_rows(ptrs.write, ptrs.info, &row_pointers[0]);
-		png_write_png(ptrs.write, ptrs.info, PNG_TRANSFORM_IDENTITY, NULL);		
-				
-		// all done				
+                     PNG_FILTER_TYPE_DEFAULT);
+		png_set_compression_level(ptrs.write, options.compression_level);
+		png_set_filter(ptrs.write, PNG_FILTER_TYPE_BASE, options.filters & png_options::filter_all);
+		if(options.weighted_filters)
+		{
+			// libpng multiplies the cost of repeating the filter of each of the previous rows by
+			// its weight, the most recent first
+			double weights[detail::FilterHistoryRows] = { 0.6, 0.7, 0.8, 0.9 };
+			png_set_filter_heuristics(ptrs.write, PNG_FILTER_HEURISTIC_WEIGHTED, detail::FilterHistoryRows, weights, (png_doublep)NULL);
+		}
+		if(options.strategy != png_options::strategy_auto)
+			png_set_compression_strategy(ptrs.write, detail::get_zlib_strategy(options));
+		png_write_info(ptrs.write, ptrs.info);
+
+		if(options.weighted_filters)
+		{
+			// libpng copies each row before filtering it so rows in the png layout are passed 
+			// straight in
+			for(int y = 0; y < height; ++y)
+				png_write_row(ptrs.write, const_cast<png_bytep>(rows.get_row(y)));
+			png_write_end(ptrs.write, ptrs.info);
+			return !str.fail();
+		}
+
+		if(strips.empty())
+		{
+			// blocks of rows are filtered across the threads then deflated as one stream
+			if(!idat.open(ptrs.write, options))
+				return false;
+			const int row_bytes = rows.get_row_bytes();
+			filtered.resize(std::min(height, detail::FilterBlockRows) * (row_bytes + 1));
+			for(int y = 0; y < height; y += detail::FilterBlockRows)
+			{
+				const int num_rows = std::min(detail::FilterBlockRows, height - y);
+				task.set_first_row(y);
+				detail::parallel_rows(num_rows, 8, task);
+				if(!idat.write(&filtered[0], num_rows * (row_bytes + 1), y + num_rows == height))
+					return false;
+			}
+			png_write_chunk(ptrs.write, detail::png_chunk_IEND, NULL, 0);
+			return !str.fail();
+		}
+
+		// the strips joined are a raw deflate stream, it is wrapped in a zlib header and the 
+		// adler-32 of all the filtered rows and written as one IDAT chunk per strip
+		const int level = options.compression_level;
+		const int level_flags = level < 2 ? 0 : (level < 6 ? 1 : (level == 6 ? 2 : 3));
+		const int cmf = 0x78;
+		int flg = level_flags << 6;
+		flg += 31 - ((cmf << 8) + flg) % 31;
+		uLong adler = strips[0].adler;
+		for(int i = 1; i < strips.size(); ++i)
+			adler = adler32_combine(adler, strips[i].adler, strips[i].filtered_bytes);
+		detail::png_strip& first = strips[0];
+		first.data[0] = static_cast<core::uint8>(cmf);
+		first.data[1] = static_cast<core::uint8>(flg);
+		detail::png_strip& end = strips[strips.size() - 1];
+		for(int shift = 24; shift >= 0; shift -= 8)
+			end.data[end.size++] = static_cast<core::uint8>(adler >> shift);
+		for(int i = 0; i < strips.size(); ++i)
+			png_write_chunk(ptrs.write, detail::png_chunk_IDAT, strips[i].data, strips[i].size);
+		png_write_chunk(ptrs.write, detail::png_chunk_IEND, NULL, 0);
+		return !str.fail();
+	}
+
+	png_reader::png_reader(pixel_arena* arena) :
+		m_state(new detail::png_read_state())
+	{
+		m_state->read = png_create_read_struct_2(PNG_LIBPNG_VER_STRING, 
+												 png_voidp_NULL,
+												 detail::libpng_error, 
+												 detail::libpng_warning, 
+												 (png_voidp)arena,
+												 detail::libpng_malloc,
+												 detail::libpng_free);		
+		if(m_state->read)
+			m_state->info = png_create_info_struct(m_state->read);
+		if(m_state->info)
+		{
+			png_set_progressive_read_fn(m_state->read, m_state, 
+										detail::libpng_progressive_info, 
+										detail::libpng_progressive_row, 
+										detail::libpng_progressive_end);
+		}
+		else
+		{
+			m_state->failed = true;
+		}
+	}
+
+	png_reader::~png_reader()
+	{
+		delete m_state;
+	}
+
+	bool png_reader::process(const core::uint8* data, int len)
+	{
+		if(m_state->failed)
+			return false;
+		if(m_state->complete || len <= 0)
+			return true;
+
+		// libpng errors long jump back here
+		if(setjmp(png_jmpbuf(m_state->read)))
+		{
+			m_state->failed = true;
+			m_state->img = image_base_ptr();
+			return false;
+		}
+		png_process_data(m_state->read, m_state->info, const_cast<png_bytep>(data), len);
 		return true;
 	}
 
+	bool png_reader::is_complete() const
+	{
+		return m_state->complete;
+	}
+
+	image_base_ptr png_reader::get_image() const
+	{
+		return m_state->img;
+	}
+
 } // end namespace
 } // end namespace
@@ -26,6 +26,66 @@ namespace tycho
 {
 namespace image
 {
+namespace detail
+{
+	struct png_read_state;
+}
+
+	/// PNG encoder settings, the defaults are the settings libpng uses
+	struct IMAGE_ABI png_options
+	{
+		/// row filters the encoder chooses between, any combination of these
+		enum filter_flags
+		{
+			filter_none		= 0x08,
+			filter_sub		= 0x10,
+			filter_up		= 0x20,
+			filter_avg		= 0x40,
+			filter_paeth	= 0x80,
+			filter_all		= 0xf8
+		};
+
+		/// zlib strategy
+		enum zlib_strategy
+		{
+			strategy_auto,			///< libpng's choice, filtered when rows are filtered and default otherwise
+			strategy_default,		///< Z_DEFAULT_STRATEGY
+			strategy_filtered,		///< Z_FILTERED
+			strategy_huffman_only,	///< Z_HUFFMAN_ONLY, no string matching
+			strategy_rle			///< Z_RLE, matches only against the previous byte, fast and good on filtered rows
+		};
+
+		/// constructor, libpng defaults
+		png_options() :
+			compression_level(6),
+			filters(filter_all),
+			weighted_filters(false),
+			strategy(strategy_auto),
+			strip_rows(0)
+		{}
+
+		/// \returns settings for the fastest useful compression, level 1 with sub filtered rows and run length matching
+		static png_options fast()
+		{
+			png_options o;
+			o.compression_level = 1;
+			o.filters = filter_sub;
+			o.strategy = strategy_rle;
+			return o;
+		}
+
+		int compression_level;	///< zlib level, 0 stores, 1 is fastest and 9 smallest
+		int filters;			///< filter_flags the encoder may use, it picks the best for each row
+		bool weighted_filters;	///< weight the choice of filter towards the ones used on the last four rows, rows are then filtered by libpng on the calling thread
+		zlib_strategy strategy;
+
+		/// Rows in each strip of the image filtered and deflated on a separate thread, 0 deflates
+		/// the whole image as one stream on the calling thread after filtering blocks of rows
+		/// across the threads. Strips join into a single zlib stream so any png reader can load
+		/// the file, each one starts with an empty dictionary so the file is slightly larger. 
+		/// Ignored with weighted_filters.
+		int strip_rows;
+	};
 
 	/// PNG format interface
     class IMAGE_ABI format_png
@@ -37,17 +97,58 @@ namespace image
 		/// \returns true if the signature is a PNG file
 		static bool identify(const char* signature, int signature_len);
 
-		/// Load a PNG file from a stream
-		static image_base_ptr load(io::stream&);
+		/// Load a PNG file from a stream, the file is read in pieces through a \ref png_reader.
+		/// This may read past the end of the file if it is followed by other data. Every colour 
+		/// type and bit depth is loaded, grey into an l8 image_a8, grey with alpha into an 
+		/// image_rgba16, palettes into rgb or rgba and 16 bit files into an image_rgba64. 
+		/// libpng's allocations and the read buffer come from the arena if there is one, the
+		/// image never does.
+		static image_base_ptr load(io::stream&, pixel_arena* arena = 0);
 		
-		/// Save an image as a PNG file
-		/// \warning currently always converts to 32bit rgba.
+		/// Save an image as a PNG file with the default settings
 		static bool save(image_base_ptr, io::stream&);
-		
-	private:
-		static bool save_rgba(image_base_ptr, io::stream&);
+
+		/// Save an image as a PNG file. Images whose rows are already in a png layout are written 
+		/// straight from their rows, rgb888 as rgb, rgba8888 as rgba, l8 as grey, la88 as grey 
+		/// with alpha and image_rgba64 as 16 bit rgba. Everything else is converted a row at a
+		/// time to rgb, or to rgba if it has alpha. libpng's allocations, zlib's and the line
+		/// buffers come from the arena if there is one.
+		static bool save(image_base_ptr, io::stream&, const png_options&, pixel_arena* arena = 0);
     };
 
+	/// Incremental PNG decoder, the file is fed in pieces as it arrives, for instance from the
+	/// network. Each row is decoded straight into the image as its data arrives so the image is 
+	/// the only full size allocation.
+	class IMAGE_ABI png_reader
+	{
+	public:
+		/// constructor, libpng's allocations come from the arena if there is one and it must 
+		/// outlive the reader
+		png_reader(pixel_arena* arena = 0);
+
+		/// destructor
+		~png_reader();
+
+		/// decodes the next piece of the file, pieces can be any size.
+		/// \returns false if the file is corrupt or in a format we can't load, further calls also fail.
+		bool process(const core::uint8* data, int len);
+
+		/// \returns true once the whole image has been decoded
+		bool is_complete() const;
+
+		/// \returns the image, empty until the header has been decoded. Rows that haven't arrived
+		/// yet are undefined.
+		image_base_ptr get_image() const;
+
+	private:
+		/// non-copyable
+		png_reader(const png_reader&);
+		void operator=(const png_reader&);
+
+	private:
+		detail::png_read_state* m_state;
+	};
+
 } // end namespace
 
 } // end namespace
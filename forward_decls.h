@@ -26,7 +26,9 @@ namespace image
 {
 
 	TYCHO_DECLARE_SHARED_PTR(IMAGE_ABI, image_base);
+	TYCHO_DECLARE_SHARED_PTR(IMAGE_ABI, image_array);
 	class canvas;
+	class pixel_arena;
 	
 } // end namespace
 
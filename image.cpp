@@ -17,7 +17,75 @@ namespace tycho
 {
 namespace image
 {
+	/// number of pixels converted at a time by the float row functions
+	static const int FloatRowChunk = 64;
 
+	void image_base::read_row(int mip_level, int x, int y, int width, core::rgba* dst) const
+	{
+		for(int i = 0; i < width; ++i)
+			dst[i] = get_pixel(mip_level, x + i, y);
+	}
+
+	void image_base::write_row(const core::rgba* src, int mip_level, int x, int y, int width)
+	{
+		for(int i = 0; i < width; ++i)
+			put_pixel(src[i], mip_level, x + i, y);
+	}
+
+	void image_base::read_row(int mip_level, int x, int y, int width, float* dst) const
+	{
+		core::rgba chunk[FloatRowChunk];
+		float* r = dst;
+		float* g = dst + width;
+		float* b = dst + width * 2;
+		float* a = dst + width * 3;
+		for(int i = 0; i < width; i += FloatRowChunk)
+		{
+			int n = width - i < FloatRowChunk ? width - i : FloatRowChunk;
+			read_row(mip_level, x + i, y, n, chunk);
+			for(int j = 0; j < n; ++j)
+			{
+				const core::rgba& c = chunk[j];
+				*r++ = (float)c.r();
+				*g++ = (float)c.g();
+				*b++ = (float)c.b();
+				*a++ = (float)c.a();
+			}
+		}
+	}
+
+	void image_base::write_row(const float* src, int mip_level, int x, int y, int width)
+	{
+		struct local
+		{
+			static int to_channel(float v)
+			{
+				if(v <= 0.0f)
+					return 0;
+				if(v >= 255.0f)
+					return 255;
+				return (int)(v + 0.5f);
+			}
+		};
+
+		core::rgba chunk[FloatRowChunk];
+		const float* r = src;
+		const float* g = src + width;
+		const float* b = src + width * 2;
+		const float* a = src + width * 3;
+		for(int i = 0; i < width; i += FloatRowChunk)
+		{
+			int n = width - i < FloatRowChunk ? width - i : FloatRowChunk;
+			for(int j = 0; j < n; ++j)
+			{
+				chunk[j] = core::rgba(local::to_channel(*r++), 
+									  local::to_channel(*g++), 
+									  local::to_channel(*b++), 
+									  local::to_channel(*a++));
+			}
+			write_row(chunk, mip_level, x + i, y, n);
+		}
+	}
 
 } // end namespace
 } // end namespace
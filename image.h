@@ -31,12 +31,18 @@ namespace image
     class IMAGE_ABI image_base
     {
     public:
+		/// pass as the number of mip levels to hold the whole chain down to 1x1
+		static const int FullMipChain = 0x7fffffff;
+
+	public:
 		/// virtual destructor
 		virtual ~image_base() {}
 		
 		/// resize the image canvas
 		/// \param width	New width
 		/// \param height	New height
+		/// \param num_mip_levels Number of levels, each half the size of the one above rounded down
+		///						 to at least 1. Clamped to the levels down to 1x1.
 		/// \param preserve_contents If true existing contents are preserved on the new canvas, no rescaling of it occurs.
 		virtual bool resize_canvas(int width, int height, int num_mip_levels, bool preserve_contents) = 0;
 
@@ -82,6 +88,24 @@ namespace image
 
 		/// draw a pixel to the mip level
 		virtual void put_pixel(core::rgba, int mip_level, int x, int y) = 0;
+
+		/// read a horizontal run of pixels, converting them to rgba. The default implementation
+		/// goes through get_pixel, formats should override this with something faster.
+		/// \param dst caller supplied buffer of at least width pixels
+		virtual void read_row(int mip_level, int x, int y, int width, core::rgba* dst) const;
+
+		/// write a horizontal run of rgba pixels, converting them to the image format. The default
+		/// implementation goes through put_pixel, formats should override this with something faster.
+		virtual void write_row(const core::rgba* src, int mip_level, int x, int y, int width);
+
+		/// read a horizontal run of pixels into planar float channels. 
+		/// \param dst caller supplied buffer of 4 * width floats, laid out as width reds followed by
+		///			   width greens, blues and alphas. Values are in the range [0, 255].
+		virtual void read_row(int mip_level, int x, int y, int width, float* dst) const;
+
+		/// write a horizontal run of planar float channels, values are rounded and clamped to [0, 255].
+		/// \param src buffer of 4 * width floats in the layout described by \ref read_row
+		virtual void write_row(const float* src, int mip_level, int x, int y, int width);
 		
 		/// \returns true if the image contains the specified channel
 		virtual bool has_channel(colour_channel) const = 0;
@@ -26,7 +26,8 @@ namespace tycho
 namespace image
 {
 
-	/// 8 bit alpha image
+	/// 8 bit alpha or luminance image. Alpha only layouts read back as black with the alpha,
+	/// others such as \ref image_rgba::pixel_layout_l8 are packed and unpacked by the layout.
     class IMAGE_ABI image_a8  : public image_rgba
     {
     public:
@@ -42,7 +43,7 @@ namespace image
 		image_a8(const pixel_layout& pl) :
 			image_rgba(pl)
 		{
-			m_bytes_per_pixel = 4;
+			m_bytes_per_pixel = 1;
 		}
 		
 		virtual image_format get_image_format() const { return image_format_a8; }
@@ -53,7 +54,7 @@ namespace image
 			if(!get_mip_level(mip_level, &c))
 				return;
 			core::uint8 *pixel = (core::uint8*)(c.get_pixels() + c.get_pitch() * y  + x * m_bytes_per_pixel);
-			*pixel = clr.a();
+			*pixel = m_layout.rmask ? (core::uint8)pack_pixel(clr) : clr.a();
 		}
 
 		virtual core::rgba get_pixel(int mip_level, int x, int y) const 
@@ -62,9 +63,35 @@ namespace image
 			canvas c;
 			if(!const_cast<image_a8*>(this)->get_mip_level(mip_level, &c))
 				return core::rgba(0,0,0,0);
-			core::uint8 alpha = *(core::uint8*)(c.get_pixels() + c.get_pitch() * y  + x * m_bytes_per_pixel);
-			return core::rgba(0, 0, 0, alpha);		
+			core::uint8 value = *(core::uint8*)(c.get_pixels() + c.get_pitch() * y  + x * m_bytes_per_pixel);
+			return m_layout.rmask ? unpack_pixel(value) : core::rgba(0, 0, 0, value);		
+		}
+
+		virtual void read_row(int mip_level, int x, int y, int width, core::rgba* dst) const
+		{
+			if(m_layout.rmask)
+			{
+				image_rgba::read_row(mip_level, x, y, width, dst);
+				return;
+			}
+			const core::uint8* p = get_pixel_ptr(mip_level, x, y);
+			for(int i = 0; i < width; ++i, p += m_bytes_per_pixel)
+				dst[i] = core::rgba(0, 0, 0, *p);
+		}
+
+		virtual void write_row(const core::rgba* src, int mip_level, int x, int y, int width)
+		{
+			if(m_layout.rmask)
+			{
+				image_rgba::write_row(src, mip_level, x, y, width);
+				return;
+			}
+			core::uint8* p = get_pixel_ptr(mip_level, x, y);
+			for(int i = 0; i < width; ++i, p += m_bytes_per_pixel)
+				*p = (core::uint8)src[i].a();
 		}
+		using image_base::read_row;
+		using image_base::write_row;
     
     };
 
@@ -0,0 +1,162 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Sunday, 18 October 2026 12:05:29 AM
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/image_array.h"
+#include "image/image.h"
+#include <algorithm>
+#include <atomic>
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	/// Pixels shared by an array and the layers that are views over them, freed when the last
+	/// reference goes.
+	class array_storage
+	{
+	public:
+		array_storage(core::uint8* pixels, int num_bytes, pixel_allocator& allocator) :
+			m_pixels(pixels), m_num_bytes(num_bytes), m_allocator(allocator), m_refs(1)
+		{}
+
+		void add_ref()
+			{ ++m_refs; }
+
+		void release()
+		{
+			if(--m_refs == 0)
+			{
+				m_allocator.deallocate(m_pixels, m_num_bytes);
+				delete this;
+			}
+		}
+
+	private:
+		core::uint8* m_pixels;
+		const int m_num_bytes;
+		pixel_allocator& m_allocator;
+		std::atomic<int> m_refs;
+	};
+
+	/// deletes a layer that views shared storage then drops its reference to it
+	struct storage_view_deleter
+	{
+		storage_view_deleter(array_storage* storage) : m_storage(storage) {}
+
+		void operator()(image_base* view) const
+		{
+			delete view;
+			m_storage->release();
+		}
+
+		array_storage* m_storage;
+	};
+
+} // end namespace
+
+	image_array::image_array(array_type type) :
+		m_type(type),
+		m_storage(0)
+	{}
+
+	image_array::~image_array()
+	{
+		// layers that view the storage keep it until they go
+		m_layers.clear();
+		if(m_storage)
+			m_storage->release();
+	}
+
+	bool image_array::add_layer(image_base_ptr layer)
+	{
+		if(!layer)
+			return false;
+		if(!m_layers.empty())
+		{
+			const image_base& first = *m_layers.front();
+			if(layer->get_image_format() != first.get_image_format() ||
+			   layer->get_width() != first.get_width() ||
+			   layer->get_height() != first.get_height() ||
+			   layer->get_num_mips() != first.get_num_mips())
+			{
+				return false;
+			}
+		}
+		m_layers.push_back(layer);
+		return true;
+	}
+
+	core::uint8* image_array::allocate_storage(int num_bytes, pixel_allocator& allocator)
+	{
+		if(m_storage)
+			m_storage->release();
+		m_storage = 0;
+		core::uint8* pixels = allocator.allocate(num_bytes);
+		if(pixels)
+			m_storage = new detail::array_storage(pixels, num_bytes, allocator);
+		return pixels;
+	}
+
+	image_base_ptr image_array::share_storage(image_base* view)
+	{
+		if(!view || !m_storage)
+			return image_base_ptr(view);
+		m_storage->add_ref();
+		return image_base_ptr(view, detail::storage_view_deleter(m_storage));
+	}
+
+	bool image_array::is_complete_cube() const
+	{
+		return m_type == array_type_cube && !m_layers.empty() && (m_layers.size() % cube_face_count) == 0;
+	}
+
+	int image_array::get_num_layers(int mip_level) const
+	{
+		const int num_layers = get_num_layers();
+		if(m_type == array_type_volume && num_layers)
+			return std::max(num_layers >> mip_level, 1);
+		return num_layers;
+	}
+
+	bool image_array::get_mip_level(int layer, int mip_level, canvas* c)
+	{
+		if(layer < 0 || layer >= get_num_layers(mip_level))
+			return false;
+		return m_layers[layer]->get_mip_level(mip_level, c);
+	}
+
+	int image_array::get_width() const
+	{
+		return m_layers.empty() ? 0 : m_layers.front()->get_width();
+	}
+
+	int image_array::get_height() const
+	{
+		return m_layers.empty() ? 0 : m_layers.front()->get_height();
+	}
+
+	int image_array::get_num_mips() const
+	{
+		return m_layers.empty() ? 0 : m_layers.front()->get_num_mips();
+	}
+
+	image_format image_array::get_image_format() const
+	{
+		return m_layers.empty() ? image_format_rgba32 : m_layers.front()->get_image_format();
+	}
+
+} // end namespace
+} // end namespace
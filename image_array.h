@@ -0,0 +1,134 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Sunday, 18 October 2026 12:05:29 AM
+//////////////////////////////////////////////////////////////////////////////
+#if _MSC_VER > 1000
+#pragma once
+#endif  // _MSC_VER
+
+#ifndef __IMAGE_ARRAY_H_EB30475B_4400_4FDB_983C_FD52753197D3_
+#define __IMAGE_ARRAY_H_EB30475B_4400_4FDB_983C_FD52753197D3_
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/image_abi.h"
+#include "image/forward_decls.h"
+#include "image/canvas.h"
+#include "image/pixel_allocator.h"
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+	class array_storage;
+}
+
+	/// A set of images of the same format, size and mip count addressed by layer and mip level.
+	/// Layers are the faces of a cube map, the elements of a texture array or the depth slices
+	/// of a volume texture. Each layer is an ordinary image, loaders create them as views over a
+	/// single block of storage shared by the array and those layers.
+	class IMAGE_ABI image_array
+	{
+	public:
+		/// how the layers are addressed
+		enum array_type
+		{
+			array_type_2d,		///< array of 2d images, a single 2d image is an array of one
+			array_type_cube,	///< six faces per cube in cube_face order, more than six is an array of cubes
+			array_type_volume	///< depth slices, mip level m holds max(depth >> m, 1) slices
+		};
+
+		/// faces of a cube in the order they are stored
+		enum cube_face
+		{
+			cube_face_positive_x,
+			cube_face_negative_x,
+			cube_face_positive_y,
+			cube_face_negative_y,
+			cube_face_positive_z,
+			cube_face_negative_z,
+			cube_face_count
+		};
+
+	public:
+		/// constructor
+		image_array(array_type type);
+
+		/// destructor
+		~image_array();
+
+		/// adds a layer, it must match the format, size and mip count of the first.
+		/// \returns false if it doesn't
+		bool add_layer(image_base_ptr);
+
+		/// Allocates storage for the layers from the allocator, replacing any allocated before.
+		/// Layers created as views over it with \ref share_storage make the whole array a 
+		/// single allocation. \returns 0 if the allocation fails
+		core::uint8* allocate_storage(int num_bytes, pixel_allocator& allocator = get_default_pixel_allocator());
+
+		/// \returns a pointer to an image that is a view over the storage, which is then kept 
+		/// until the array and every such image are gone. The image is deleted with the pointer.
+		image_base_ptr share_storage(image_base* view);
+
+		/// \returns how the layers are addressed
+		array_type get_array_type() const
+			{ return m_type; }
+
+		/// \returns number of layers, for volumes this is the depth of the top level
+		int get_num_layers() const
+			{ return static_cast<int>(m_layers.size()); }
+
+		/// \returns the i'th layer
+		image_base_ptr get_layer(int i) const
+			{ return m_layers[i]; }
+
+		/// \returns a face of a cube, cube is the index of the cube in a cube array
+		image_base_ptr get_face(cube_face face, int cube = 0) const
+			{ return m_layers[cube * cube_face_count + face]; }
+
+		/// \returns true if the layers are complete cubes
+		bool is_complete_cube() const;
+
+		/// \returns number of layers holding the mip level, max(depth >> mip_level, 1) for
+		/// volumes and every layer otherwise
+		int get_num_layers(int mip_level) const;
+
+		/// \returns the canvas of a mip level of a layer
+		bool get_mip_level(int layer, int mip_level, canvas*);
+
+		/// \returns width of the top level, 0 if empty
+		int get_width() const;
+
+		/// \returns height of the top level, 0 if empty
+		int get_height() const;
+
+		/// \returns number of mip levels of each layer, 0 if empty
+		int get_num_mips() const;
+
+		/// \returns format of the layers
+		image_format get_image_format() const;
+
+	private:
+		/// non-copyable
+		image_array(const image_array&);
+		void operator=(const image_array&);
+
+	private:
+		array_type m_type;
+		std::vector<image_base_ptr> m_layers;
+		detail::array_storage* m_storage;	///< storage we hold a reference to, 0 if none
+	};
+
+} // end namespace
+} // end namespace
+
+#endif // __IMAGE_ARRAY_H_EB30475B_4400_4FDB_983C_FD52753197D3_
@@ -8,6 +8,12 @@
 // INCLUDES
 //////////////////////////////////////////////////////////////////////////////
 #include "image_dxtn.h"
+#include "dxtn_codec.h"
+#include "image_rgba32.h"
+#include "pixel_convert.h"
+#include "tile_scheduler.h"
+#include "core/memory.h"
+#include <algorithm>
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -18,6 +24,527 @@ namespace tycho
 namespace image
 {
 
+	/// encodes rows of blocks from a canvas, each row of blocks is independent of the others
+	class dxtn_encode_task : public detail::row_task
+	{
+	public:
+		dxtn_encode_task(canvas& src, int srcx, int srcy, canvas& dst, int dstx, int dsty, int width, int height) :
+			m_src(src), m_srcx(srcx), m_srcy(srcy),
+			m_dst(dst), m_dstx(dstx), m_dsty(dsty),
+			m_width(width), m_height(height)
+		{}
+
+		virtual void run(int begin, int end)
+		{
+			const int block_size = image_dxtn::BlockSize;
+			image_dxtn* dst_img = static_cast<image_dxtn*>(m_dst.get_owner());
+			std::vector<core::rgba> rows(m_width * block_size);
+			for(int by = begin; by < end; ++by)
+			{
+				const int y = by * block_size;
+				const int num_rows = std::min(block_size, m_height - y);
+				for(int r = 0; r < num_rows; ++r)
+					m_src.read_row(m_srcx, m_srcy + y + r, m_width, &rows[r * m_width]);
+				dst_img->encode_rows(m_dst.get_mip_level(), m_dstx, m_dsty + y, &rows[0], m_width, num_rows);
+			}
+		}
+
+	private:
+		canvas& m_src;
+		int m_srcx, m_srcy;
+		canvas& m_dst;
+		int m_dstx, m_dsty;
+		int m_width, m_height;
+	};
+
+	/// rows of blocks decoded per band of an rgba copy
+	static const int DecodeGrain = 4;
+
+	/// decodes rows of blocks to an rgba canvas, the blocks are decoded four rows at a time into
+	/// rgba8888 and then copied or converted into place
+	class dxtn_decode_task : public detail::row_task
+	{
+	public:
+		dxtn_decode_task(canvas& src, int srcx, int srcy, canvas& dst, int dstx, int dsty, int width, int height) :
+			m_src(src), m_srcx(srcx), m_srcy(srcy),
+			m_dst(dst), m_dstx(dstx), m_dsty(dsty),
+			m_width(width), m_height(height)
+		{
+			// core::rgba is laid out as rgba8888 so destinations in that layout are a straight copy
+			const image_rgba* dst_img = static_cast<const image_rgba*>(m_dst.get_owner());
+			image_rgba32 canonical(image_rgba::pixel_layout_rgba8888);
+			m_same_layout = dst_img->has_same_layout(canonical);
+			m_convert = m_same_layout ? 0 : find_row_converter(canonical, *dst_img);
+		}
+
+		virtual void run(int begin, int end)
+		{
+			const int block_size = image_dxtn::BlockSize;
+			const image_dxtn* src_img = static_cast<const image_dxtn*>(m_src.get_owner());
+			const image_rgba* dst_img = static_cast<const image_rgba*>(m_dst.get_owner());
+			const int bpp = dst_img->get_bytes_per_pixel();
+			const int first_x = m_srcx - m_srcx % block_size;
+			const int num_blocks = (m_srcx + m_width - first_x + block_size - 1) / block_size;
+			const int pitch = num_blocks * block_size;
+			std::vector<core::rgba> rows(pitch * block_size);
+			for(int by = begin; by < end; ++by)
+			{
+				const int block_y = (m_srcy / block_size + by) * block_size;
+				detail::decode_block_row(src_img->get_dxtn_type(), src_img->get_block_ptr(m_src.get_mip_level(), first_x, block_y),
+										 num_blocks, reinterpret_cast<core::uint8*>(&rows[0]), pitch * 4);
+				const int y0 = std::max(block_y, m_srcy);
+				const int y1 = std::min(block_y + block_size, m_srcy + m_height);
+				for(int y = y0; y < y1; ++y)
+				{
+					const core::rgba* line = &rows[(y - block_y) * pitch + m_srcx - first_x];
+					const int dst_y = m_dsty + y - m_srcy;
+					if(m_same_layout)
+						core::mem_cpy(m_dst.get_row(dst_y) + m_dstx * bpp, line, m_width * bpp);
+					else if(m_convert)
+						m_convert(reinterpret_cast<const core::uint8*>(line), m_dst.get_row(dst_y) + m_dstx * bpp, m_width);
+					else
+						m_dst.write_row(line, m_dstx, dst_y, m_width);
+				}
+			}
+		}
+
+	private:
+		canvas& m_src;
+		int m_srcx, m_srcy;
+		canvas& m_dst;
+		int m_dstx, m_dsty;
+		int m_width, m_height;
+		bool m_same_layout;
+		convert_row_fn m_convert;
+	};
+
+	image_dxtn::image_dxtn(dxtn_type type) :
+		m_type(type),
+		m_quality(dxtn_quality_normal),
+		m_width(0),
+		m_height(0),
+		m_pixels(0),
+		m_pixels_owned(false),
+		m_pixels_capacity(0),
+		m_allocator(&get_default_pixel_allocator()),
+		m_pixels_allocator(0),
+		m_num_pending(0)
+	{}
+
+	image_dxtn::~image_dxtn()
+	{
+		// views write through to memory that outlives us
+		if(!m_pixels_owned)
+			flush();
+		release_pixels();
+	}
+
+	void image_dxtn::release_pixels()
+	{
+		if(m_pixels_owned)
+			m_pixels_allocator->deallocate(m_pixels, m_pixels_capacity);
+		m_pixels = 0;
+		m_pixels_owned = false;
+		m_pixels_capacity = 0;
+		m_pixels_allocator = 0;
+	}
+
+	int image_dxtn::setup_mip_info(int width, int height, int num_mips)
+	{
+		return detail::setup_mip_table(width, height, num_mips, BlockSize, get_block_bytes(), 1, m_mips);
+	}
+
+	bool image_dxtn::resize_canvas(int width, int height, int num_mip_levels, bool preserve_contents)
+	{
+		if(width <= 0 || height <= 0 || num_mip_levels <= 0)
+			return false;
+		detail::mip_table old_mips;
+		old_mips.swap(m_mips);
+		const int total_size = setup_mip_info(width, height, num_mip_levels);
+		if(total_size < 0)
+		{
+			m_mips.swap(old_mips);
+			return false;
+		}
+		core::uint8* new_pixels = m_allocator->allocate(total_size);
+		if(!new_pixels)
+		{
+			m_mips.swap(old_mips);
+			return false;
+		}
+		
+		// the blocks each level has in common are kept as they are
+		if(preserve_contents && m_pixels)
+		{
+			m_mips.swap(old_mips);
+			flush();
+			m_mips.swap(old_mips);
+			detail::copy_mip_overlap(old_mips, m_pixels, m_mips, new_pixels);
+		}
+		discard_pending(-1);
+		release_pixels();
+		m_pixels = new_pixels;
+		m_pixels_owned = true;
+		m_pixels_capacity = total_size;
+		m_pixels_allocator = m_allocator;
+		m_width = width;
+		m_height = height;
+		return true;
+	}
+
+	bool image_dxtn::create_view(int width, int height, int num_mip_levels, core::uint8* pixels)
+	{
+		if(width <= 0 || height <= 0 || num_mip_levels <= 0 || !pixels)
+			return false;
+		flush();
+		detail::mip_table old_mips;
+		old_mips.swap(m_mips);
+		if(setup_mip_info(width, height, num_mip_levels) < 0)
+		{
+			m_mips.swap(old_mips);
+			return false;
+		}
+		release_pixels();
+		m_pixels = pixels;
+		m_pixels_owned = false;
+		m_width = width;
+		m_height = height;
+		return true;
+	}
+
+	bool image_dxtn::raw_copy(int mip_level, int x, int y, int width, int height, const core::uint8* src, int src_len)
+	{
+		// validate parameters
+		if(x < 0 || y < 0 || !src || !src_len || mip_level >= get_num_mips() ||
+		   (x % BlockSize) != 0 || (y % BlockSize) != 0)
+		{
+			return false;
+		}
+
+		// crop to target canvas size in blocks
+		const int bx = x / BlockSize;
+		const int by = y / BlockSize;
+		const int src_wide = (width + BlockSize - 1) / BlockSize;
+		const int src_high = (height + BlockSize - 1) / BlockSize;
+		if(bx > get_blocks_wide(mip_level) || by > get_blocks_high(mip_level))
+			return false;
+		if(src_wide * src_high * get_block_bytes() > src_len)
+			return false;
+		const int wide = std::min(src_wide, get_blocks_wide(mip_level) - bx);
+		const int high = std::min(src_high, get_blocks_high(mip_level) - by);
+		flush();
+
+		// copy a row of blocks at a time into place
+		const int block_bytes = get_block_bytes();
+		const int dst_stride = get_blocks_wide(mip_level) * block_bytes;
+		const int src_stride = src_wide * block_bytes;
+		core::uint8* dst_ptr = get_blocks(mip_level) + by * dst_stride + bx * block_bytes;
+		for(int row = 0; row < high; ++row)
+		{
+			core::mem_cpy(dst_ptr, src, wide * block_bytes);
+			dst_ptr += dst_stride;
+			src += src_stride;
+		}
+		return true;
+	}
+
+	int image_dxtn::get_stride() const
+	{
+		return m_mips.empty() ? 0 : get_blocks_wide(0) * get_block_bytes();
+	}
+
+	int image_dxtn::get_block_bytes() const
+	{
+		return detail::get_block_bytes(m_type);
+	}
+
+	void image_dxtn::clear(core::rgba clr, int mip_level)
+	{
+		if(mip_level >= get_num_mips())
+			return;
+		discard_pending(mip_level);
+		core::rgba pixels[BlockSize * BlockSize];
+		for(int i = 0; i < BlockSize * BlockSize; ++i)
+			pixels[i] = clr;
+		core::uint8 block[16];
+		detail::encode_block(m_type, m_quality, pixels, block);
+		const int block_bytes = get_block_bytes();
+		const int num_blocks = get_blocks_wide(mip_level) * get_blocks_high(mip_level);
+		core::uint8* dst = get_blocks(mip_level);
+		for(int i = 0; i < num_blocks; ++i, dst += block_bytes)
+			core::mem_cpy(dst, block, block_bytes);
+	}
+
+	bool image_dxtn::get_mip_level(int i, canvas* out_canvas)
+	{
+		if(i >= get_num_mips() || !out_canvas)
+			return false;
+		flush();
+		const mip_info& mip = m_mips[i];
+		*out_canvas = canvas(this, mip.w, mip.h, i, m_pixels + mip.offset, mip.pitch * mip.rows, mip.pitch);
+		return true;
+	}
+
+	core::uint8* image_dxtn::get_block_ptr(int mip_level, int x, int y) const
+	{
+		TYCHO_ASSERT(mip_level < get_num_mips());
+		const int block_bytes = get_block_bytes();
+		return m_pixels + m_mips[mip_level].offset +
+			   ((y / BlockSize) * get_blocks_wide(mip_level) + (x / BlockSize)) * block_bytes;
+	}
+
+	core::rgba image_dxtn::get_pixel(int mip_level, int x, int y) const
+	{
+		core::rgba clr;
+		read_row(mip_level, x, y, 1, &clr);
+		return clr;
+	}
+
+	void image_dxtn::put_pixel(core::rgba clr, int mip_level, int x, int y)
+	{
+		write_row(&clr, mip_level, x, y, 1);
+	}
+
+	void image_dxtn::read_row(int mip_level, int x, int y, int width, core::rgba* dst) const
+	{
+		TYCHO_ASSERT(x >= 0 && y >= 0 && x + width <= m_mips[mip_level].w && y < m_mips[mip_level].h);
+		
+		// rows being written are read from their decoded pixels
+		if(m_num_pending > 0)
+		{
+			std::lock_guard<std::mutex> lock(m_write_mutex);
+			pending_map::const_iterator it = m_pending.find(std::make_pair(mip_level, y / BlockSize));
+			if(it != m_pending.end())
+			{
+				const core::rgba* row = &it->second.pixels[(y % BlockSize) * m_mips[mip_level].w + x];
+				std::copy(row, row + width, dst);
+				return;
+			}
+		}
+		
+		core::rgba pixels[BlockSize * BlockSize];
+		const int row = (y % BlockSize) * BlockSize;
+		const int block_bytes = get_block_bytes();
+		const core::uint8* block = get_block_ptr(mip_level, x, y);
+		for(int i = 0; i < width; block += block_bytes)
+		{
+			detail::decode_block(m_type, block, pixels);
+			for(int bx = (x + i) % BlockSize; bx < BlockSize && i < width; ++bx, ++i)
+				dst[i] = pixels[row + bx];
+		}
+	}
+
+	void image_dxtn::write_row(const core::rgba* src, int mip_level, int x, int y, int width)
+	{
+		TYCHO_ASSERT(x >= 0 && y >= 0 && x + width <= m_mips[mip_level].w && y < m_mips[mip_level].h);
+		const int w = m_mips[mip_level].w;
+		const int block_y = y / BlockSize;
+		const int num_rows = std::min(BlockSize, m_mips[mip_level].h - block_y * BlockSize);
+		pending_row complete;
+		{
+			std::lock_guard<std::mutex> lock(m_write_mutex);
+			const pending_map::key_type key(mip_level, block_y);
+			pending_map::iterator it = m_pending.find(key);
+			if(it == m_pending.end())
+			{
+				// the first write to a row of blocks decodes it so pixels never written keep their values
+				const int num_blocks = get_blocks_wide(mip_level);
+				std::vector<core::rgba> blocks(num_blocks * BlockSize * BlockSize);
+				detail::decode_block_row(m_type, get_block_ptr(mip_level, 0, y), num_blocks, 
+										 reinterpret_cast<core::uint8*>(&blocks[0]), num_blocks * BlockSize * 4);
+				pending_row& row = m_pending[key];
+				row.pixels.resize(w * num_rows);
+				row.written.resize(w * num_rows, false);
+				row.num_written = 0;
+				for(int r = 0; r < num_rows; ++r)
+					std::copy(&blocks[r * num_blocks * BlockSize], &blocks[r * num_blocks * BlockSize] + w, &row.pixels[r * w]);
+				it = m_pending.find(key);
+				++m_num_pending;
+			}
+			pending_row& row = it->second;
+			const int first = (y % BlockSize) * w + x;
+			std::copy(src, src + width, &row.pixels[first]);
+			for(int i = first; i < first + width; ++i)
+			{
+				if(!row.written[i])
+				{
+					row.written[i] = true;
+					++row.num_written;
+				}
+			}
+			if(row.num_written < w * num_rows)
+				return;
+			complete.pixels.swap(row.pixels);
+			m_pending.erase(it);
+			--m_num_pending;
+		}
+		
+		// rows of blocks are independent so complete ones are encoded outside the lock
+		encode_rows(mip_level, 0, block_y * BlockSize, &complete.pixels[0], w, num_rows);
+	}
+
+	void image_dxtn::flush() const
+	{
+		pending_map pending;
+		{
+			std::lock_guard<std::mutex> lock(m_write_mutex);
+			pending.swap(m_pending);
+			m_num_pending = 0;
+		}
+		
+		// the pixels are what the image holds, encoding them doesn't change what it appears to be
+		image_dxtn* self = const_cast<image_dxtn*>(this);
+		for(pending_map::iterator it = pending.begin(); it != pending.end(); ++it)
+		{
+			const int mip_level = it->first.first;
+			const int y = it->first.second * BlockSize;
+			self->encode_rows(mip_level, 0, y, &it->second.pixels[0], m_mips[mip_level].w, std::min(BlockSize, m_mips[mip_level].h - y));
+		}
+	}
+
+	void image_dxtn::discard_pending(int mip_level)
+	{
+		std::lock_guard<std::mutex> lock(m_write_mutex);
+		for(pending_map::iterator it = m_pending.begin(); it != m_pending.end();)
+		{
+			if(mip_level < 0 || it->first.first == mip_level)
+			{
+				m_pending.erase(it++);
+				--m_num_pending;
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	bool image_dxtn::copy(int dstx, int dsty, int srcx, int srcy, int width, int height, canvas& src_canvas, canvas& dst_canvas)
+	{
+		// allow 0 width and height as a no op
+		if(width == 0 || height == 0)
+			return true;
+
+		// crop to fit to source and destination
+		if(dstx >= dst_canvas.get_width() ||
+		   dsty >= dst_canvas.get_height() ||
+		   srcx >= src_canvas.get_width() ||
+		   srcy >= src_canvas.get_height())
+		{
+			return true;
+		}
+		if((dstx + width) > dst_canvas.get_width())
+			width = dst_canvas.get_width() - dstx;
+		if((dsty + height) > dst_canvas.get_height())
+			height = dst_canvas.get_height() - dsty;
+		if((srcx + width) > src_canvas.get_width())
+			width = src_canvas.get_width() - srcx;
+		if((srcy + height) > src_canvas.get_height())
+			height = src_canvas.get_height() - srcy;
+
+		// this may be either the source or the destination, blocks are read and written directly
+		// so pending writes to either must be encoded first
+		const bool src_dxtn = is_dxtn_format(src_canvas.get_format());
+		const bool dst_dxtn = is_dxtn_format(dst_canvas.get_format());
+		if(src_dxtn)
+			static_cast<const image_dxtn*>(src_canvas.get_owner())->flush();
+		if(dst_dxtn)
+			static_cast<const image_dxtn*>(dst_canvas.get_owner())->flush();
+
+		// block aligned copies between the same scheme are a copy of the blocks, partial blocks are
+		// only allowed where they end at the edge of both canvases
+		if(src_dxtn && dst_dxtn)
+		{
+			const image_dxtn* src_img = static_cast<const image_dxtn*>(src_canvas.get_owner());
+			const image_dxtn* dst_img = static_cast<const image_dxtn*>(dst_canvas.get_owner());
+			const bool aligned = (srcx | srcy | dstx | dsty) % BlockSize == 0 &&
+				(width % BlockSize == 0 || (srcx + width == src_canvas.get_width() && dstx + width == dst_canvas.get_width())) &&
+				(height % BlockSize == 0 || (srcy + height == src_canvas.get_height() && dsty + height == dst_canvas.get_height()));
+			if(src_img->get_dxtn_type() == dst_img->get_dxtn_type() && aligned)
+			{
+				const int block_bytes = dst_img->get_block_bytes();
+				const int row_bytes = (width + BlockSize - 1) / BlockSize * block_bytes;
+				for(int y = 0; y < height; y += BlockSize)
+				{
+					core::mem_cpy(dst_img->get_block_ptr(dst_canvas.get_mip_level(), dstx, dsty + y),
+								  src_img->get_block_ptr(src_canvas.get_mip_level(), srcx, srcy + y), row_bytes);
+				}
+				return true;
+			}
+		}
+
+		// block aligned destinations are encoded a row of blocks at a time from the source so each 
+		// block is compressed once
+		const bool dst_aligned = (dstx | dsty) % BlockSize == 0 &&
+			(width % BlockSize == 0 || dstx + width == dst_canvas.get_width()) &&
+			(height % BlockSize == 0 || dsty + height == dst_canvas.get_height());
+		if(dst_dxtn && dst_aligned)
+		{
+			dxtn_encode_task task(src_canvas, srcx, srcy, dst_canvas, dstx, dsty, width, height);
+			detail::parallel_rows((height + BlockSize - 1) / BlockSize, 1, task);
+			return true;
+		}
+
+		// rgba destinations are decoded into a row of blocks at a time
+		if(src_dxtn && image_rgba::is_rgba_format(dst_canvas.get_format()))
+		{
+			const int first_row = srcy / BlockSize;
+			const int last_row = (srcy + height - 1) / BlockSize;
+			dxtn_decode_task task(src_canvas, srcx, srcy, dst_canvas, dstx, dsty, width, height);
+			detail::parallel_rows(last_row - first_row + 1, DecodeGrain, task);
+			return true;
+		}
+
+		// otherwise convert a row at a time through an rgba line buffer
+		std::vector<core::rgba> line(width);
+		for(int y = 0; y < height; ++y)
+		{
+			src_canvas.read_row(srcx, srcy + y, width, &line[0]);
+			dst_canvas.write_row(&line[0], dstx, dsty + y, width);
+		}
+		return true;
+	}
+
+	void image_dxtn::encode_rows(int mip_level, int x, int y, const core::rgba* rows, int width, int height)
+	{
+		TYCHO_ASSERT(x % BlockSize == 0 && y % BlockSize == 0 && height <= BlockSize);
+		core::rgba pixels[BlockSize * BlockSize];
+		const int block_bytes = get_block_bytes();
+		core::uint8* block = get_block_ptr(mip_level, x, y);
+		for(int bx = 0; bx < width; bx += BlockSize, block += block_bytes)
+		{
+			// blocks hanging over the edge of the image repeat the last row and column
+			for(int py = 0; py < BlockSize; ++py)
+			{
+				const core::rgba* row = rows + std::min(py, height - 1) * width;
+				for(int px = 0; px < BlockSize; ++px)
+					pixels[py * BlockSize + px] = row[std::min(bx + px, width - 1)];
+			}
+			detail::encode_block(m_type, m_quality, pixels, block);
+		}
+	}
+
+	bool image_dxtn::has_channel(colour_channel c) const
+	{
+		switch(m_type)
+		{
+			case dxtn_type_bc4 : return c == colour_channel_red;
+			case dxtn_type_bc5 : return c == colour_channel_red || c == colour_channel_green;
+			default : return true;
+		}
+	}
+
+	math::recti image_dxtn::get_rect(int mip_level)
+	{
+		TYCHO_ASSERT(mip_level < get_num_mips());
+		return math::recti(0, 0, m_mips[mip_level].w, m_mips[mip_level].h);
+	}
+
+	/// \returns true if the passed format is a block compressed format
+	bool image_dxtn::is_dxtn_format(image_format fmt)
+	{
+		return fmt == image_format_dxtn;
+	}
 
 } // end namespace
 
@@ -14,6 +14,14 @@
 // INCLUDES
 //////////////////////////////////////////////////////////////////////////////
 #include "image/image_abi.h"
+#include "image/canvas.h"
+#include "image/image.h"
+#include "image/mip_table.h"
+#include "image/pixel_allocator.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
 
 //////////////////////////////////////////////////////////////////////////////
 // CLASS
@@ -24,12 +32,179 @@ namespace tycho
 namespace image
 {
 
-    class IMAGE_ABI image_dxtn
+	/// Block compressed image, pixels are stored in 4x4 blocks in the layout the gpu expects so
+	/// the blocks of a mip level can be uploaded directly. Pixel and row access decode the blocks
+	/// on read. Writes go to a decoded copy of their row of blocks which is encoded once every
+	/// pixel of it has been written, or when the writes are flushed, so rows written one at a
+	/// time are compressed once. It is still much faster to fill the image a block at a time
+	/// with raw_copy or copy. Copies to rgba images decode a row of blocks at a time.
+    class IMAGE_ABI image_dxtn : public image_base
     {
     public:
-    
+		/// compression schemes
+		enum dxtn_type
+		{
+			dxtn_type_dxt1,		///< BC1, 565 colour with optional 1 bit alpha, 8 bytes per block
+			dxtn_type_dxt3,		///< BC2, dxt1 colour with explicit 4 bit alpha, 16 bytes per block
+			dxtn_type_dxt5,		///< BC3, dxt1 colour with interpolated alpha, 16 bytes per block
+			dxtn_type_bc4,		///< BC4, red as an interpolated alpha block, 8 bytes per block. Decodes as (r, 0, 0, 255)
+			dxtn_type_bc5		///< BC5, red and green as two interpolated alpha blocks, 16 bytes per block. Decodes as (r, g, 0, 255)
+		};
+
+		/// encoder quality tiers, each is slower than the one before and never worse
+		enum dxtn_quality
+		{
+			dxtn_quality_fast,		///< range fit, endpoints at the corners of the bounding box of the block
+			dxtn_quality_normal,	///< cluster fit, best least squares endpoints over every ordered split of the block
+			dxtn_quality_high		///< iterative cluster fit followed by a search around the endpoints
+		};
+
+		/// width and height of a block in pixels
+		static const int BlockSize = 4;
+
+    public:
+		/// constructor
+		image_dxtn(dxtn_type type);
+
+		/// destructor
+		~image_dxtn();
+
+		/// \name image_base interface
+		//@{
+		/// mip levels are floor(size / 2^level) pixels down to 1x1, each level is padded out to
+		/// whole blocks. preserve_contents keeps the blocks each level has in common with the old one.
+		virtual bool resize_canvas(int width, int height, int num_mip_levels, bool preserve_contents);
+		virtual bool create_view(int width, int height, int num_mip_levels, core::uint8* pixels);
+
+		/// raw copy of blocks, x and y must be on a block boundary and src is rows of
+		/// (width + 3) / 4 blocks.
+		virtual bool raw_copy(int mip_level, int x, int y, int width, int height, const core::uint8* src, int src_len);
+		virtual int  get_width() const				{ return m_width; }
+		virtual int  get_height() const				{ return m_height; }
+
+		/// \returns bytes per row of blocks on the top level
+		virtual int  get_stride() const;
+		virtual int  get_num_mips() const			{ return static_cast<int>(m_mips.size()); }
+		virtual void clear(core::rgba, int mip_level);
+
+		/// the canvas pitch is the bytes per row of blocks, canvas::get_row is not meaningful.
+		/// Pending writes are flushed first.
+		virtual bool get_mip_level(int i, canvas*);
+		virtual image_format get_image_format() const	{ return image_format_dxtn; }
+		virtual core::rgba get_pixel(int mip_level, int x, int y) const;
+		virtual void put_pixel(core::rgba, int mip_level, int x, int y);
+		virtual void read_row(int mip_level, int x, int y, int width, core::rgba* dst) const;
+		virtual void write_row(const core::rgba* src, int mip_level, int x, int y, int width);
+		using image_base::read_row;
+		using image_base::write_row;
+		virtual bool has_channel(colour_channel) const;
+		virtual bool copy(int dstx, int dxty, int srcx, int srcy, int width, int height, canvas& src_canvas, canvas& dst_canvas);
+		virtual math::recti get_rect(int mip_level);
+		//@}
+
+		/// \returns the compression scheme
+		dxtn_type get_dxtn_type() const
+			{ return m_type; }
+
+		/// \returns the quality blocks are encoded at
+		dxtn_quality get_quality() const
+			{ return m_quality; }
+
+		/// set the quality blocks are encoded at, defaults to dxtn_quality_normal
+		void set_quality(dxtn_quality quality)
+			{ m_quality = quality; }
+
+		/// \returns bytes allocated for the blocks, 0 for views
+		int get_capacity() const
+			{ return m_pixels_capacity; }
+
+		/// \returns the allocator the blocks are allocated with
+		pixel_allocator& get_allocator() const
+			{ return *m_allocator; }
+
+		/// set the allocator the blocks are allocated with from the next resize, defaults to 
+		/// \ref get_default_pixel_allocator
+		void set_allocator(pixel_allocator& allocator)
+			{ m_allocator = &allocator; }
+
+		/// \returns bytes per block
+		int get_block_bytes() const;
+
+		/// \returns blocks across the mip level
+		int get_blocks_wide(int mip_level) const
+			{ return (m_mips[mip_level].w + BlockSize - 1) / BlockSize; }
+
+		/// \returns blocks down the mip level
+		int get_blocks_high(int mip_level) const
+			{ return (m_mips[mip_level].h + BlockSize - 1) / BlockSize; }
+
+		/// \returns the blocks of the mip level, rows of blocks from the top. Pending writes are 
+		/// flushed first.
+		core::uint8* get_blocks(int mip_level)
+			{ flush(); return m_pixels + m_mips[mip_level].offset; }
+
+		/// \returns the blocks of the mip level, const version
+		const core::uint8* get_blocks(int mip_level) const
+			{ flush(); return m_pixels + m_mips[mip_level].offset; }
+
+		/// \returns pointer to the block containing pixel x, y, pending writes are not flushed
+		core::uint8* get_block_ptr(int mip_level, int x, int y) const;
+
+		/// encodes the rows of blocks that have been partly written, pixels not written keep 
+		/// their decoded values
+		void flush() const;
+
+		/// \returns size in bytes of the blocks of the mip level
+		int get_mip_byte_size(int mip_level) const
+			{ return get_blocks_wide(mip_level) * get_blocks_high(mip_level) * get_block_bytes(); }
+
+		/// Encodes a row of blocks, x and y are on a block boundary and rows holds up to four rows
+		/// of width pixels. Blocks hanging over the edge of the rows repeat the last row and column.
+		/// Rows of blocks may be encoded from several threads at once.
+		void encode_rows(int mip_level, int x, int y, const core::rgba* rows, int width, int height);
+
+		/// \returns true if the passed format is a block compressed format
+		static bool is_dxtn_format(image_format);
+
+    private:
+		/// non-copyable
+		image_dxtn(const image_dxtn&);
+		void operator=(const image_dxtn&);
+
+		/// sets up the mip table, returns the total size in bytes or -1 if it doesn't fit an int
+		int setup_mip_info(int width, int height, int num_mips);
+
+		/// drops pending writes without encoding them, all levels if mip_level is negative
+		void discard_pending(int mip_level);
+
+		/// frees the blocks if we own them
+		void release_pixels();
+
     private:
-    
+		typedef detail::mip_table_level mip_info;
+
+		/// decoded pixels of a row of blocks being written
+		struct pending_row
+		{
+			std::vector<core::rgba> pixels;		///< rows of the level width, as many as the image has
+			std::vector<bool> written;			///< set for the pixels written so far
+			int num_written;
+		};
+		typedef std::map<std::pair<int, int>, pending_row> pending_map;	///< keyed by mip level and block row
+
+		dxtn_type m_type;
+		dxtn_quality m_quality;
+		int m_width;
+		int m_height;
+		detail::mip_table m_mips;
+		core::uint8* m_pixels;
+		bool m_pixels_owned;
+		int m_pixels_capacity;				///< bytes allocated for owned blocks
+		pixel_allocator* m_allocator;		///< allocator for new blocks
+		pixel_allocator* m_pixels_allocator; ///< allocator the owned blocks came from
+		mutable pending_map m_pending;
+		mutable std::atomic<int> m_num_pending;	///< size of m_pending, lets reads skip the lock when nothing is pending
+		mutable std::mutex m_write_mutex;	///< guards m_pending, rows sharing a block may be written from several threads
     };
 
 } // end namespace
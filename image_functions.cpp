@@ -12,6 +12,13 @@
 #include "canvas.h"
 #include "image.h"
 #include "image_rgb24.h"
+#include "image_dxtn.h"
+#include "image_rgba64.h"
+#include "mip_generator.h"
+#include "resample.h"
+#include "srgb.h"
+#include "tile_scheduler.h"
+#include <vector>
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -33,51 +40,97 @@ namespace image
 	typedef kernel<float, 2> kernel2f;
 	typedef kernel<float, 3> kernel3f;
 	
+	/// convolves a band of destination rows with the kernel
 	template<class T>
-	void apply_kernel(canvas& src, canvas& dst, const T& k)
+	class apply_kernel_task : public detail::row_task
 	{
-		float scale_x = (float)src.get_width() / dst.get_width();
-		float scale_y = (float)src.get_height() / dst.get_height();
+	public:
+		apply_kernel_task(canvas& src, canvas& dst, const T& k) :
+			m_src(src),
+			m_dst(dst),
+			m_kernel(k)
+		{}
 		
-		// for each pixel in the destination image
-		for(int y = 0; y < dst.get_height(); ++y)
+		virtual void run(int begin, int end)
 		{
-			for(int x = 0; x < dst.get_width(); ++x)
+			const int src_width = m_src.get_width();
+			const int src_height = m_src.get_height();
+			const int dst_width = m_dst.get_width();
+			float scale_x = (float)src_width / dst_width;
+			float scale_y = (float)src_height / m_dst.get_height();
+			
+			// the source rows under the kernel are cached, each destination row needs kernel_size
+			// consecutive source rows so indexing the cache by row modulo kernel_size never collides.
+			std::vector<core::rgba> rows(T::kernel_size * src_width);
+			int row_tags[T::kernel_size];
+			for(int i = 0; i < T::kernel_size; ++i)
+				row_tags[i] = -1;
+			std::vector<core::rgba> out(dst_width);
+			
+			// for each pixel in the destination image
+			int ks = (T::kernel_size-1)/2;
+			for(int y = begin; y < end; ++y)
 			{
-				float src_center_x = (float)(x + 0.5f) * scale_x;
 				float src_center_y = (float)(y + 0.5f) * scale_y;
+				for(int ty = -ks; ty < T::kernel_size - ks; ++ty)
+				{
+					int sy = static_cast<int>(math::floor(src_center_y + ty));
+					if(sy >= 0 && sy < src_height && row_tags[sy % T::kernel_size] != sy)
+					{
+						m_src.read_row(0, sy, src_width, &rows[(sy % T::kernel_size) * src_width]);
+						row_tags[sy % T::kernel_size] = sy;
+					}
+				}
 				
-				// convolve
-				float sumr = 0;
-				float sumg = 0;
-				float sumb = 0;
-				float suma = 0;
-				int ks = (T::kernel_size-1)/2;
-				for(int ky = 0, ty = -ks; ky < T::kernel_size; ++ky, ++ty)
+				for(int x = 0; x < dst_width; ++x)
 				{
-					for(int kx = 0, tx = -ks; kx < T::kernel_size; ++kx, ++tx)
+					float src_center_x = (float)(x + 0.5f) * scale_x;
+					
+					// convolve
+					float sumr = 0;
+					float sumg = 0;
+					float sumb = 0;
+					float suma = 0;
+					for(int ky = 0, ty = -ks; ky < T::kernel_size; ++ky, ++ty)
 					{
-						int sx = static_cast<int>(math::floor(src_center_x + tx));
 						int sy = static_cast<int>(math::floor(src_center_y + ty));
-						
-						if(sx >= 0 && sx < src.get_width() && 
-						   sy >= 0 && sy < src.get_height())
+						if(sy < 0 || sy >= src_height)
+							continue;
+						const core::rgba* row = &rows[(sy % T::kernel_size) * src_width];
+						for(int kx = 0, tx = -ks; kx < T::kernel_size; ++kx, ++tx)
 						{
-							const core::rgba& clr = src.get_pixel(sx, sy);
-							const typename T::base_type& kv = k.value[kx][ky];
-							sumr += kv * clr.r();
-							sumg += kv * clr.g();
-							sumb += kv * clr.b();
-							suma += kv * clr.a();
+							int sx = static_cast<int>(math::floor(src_center_x + tx));						
+							if(sx >= 0 && sx < src_width)
+							{
+								const core::rgba& clr = row[sx];
+								const typename T::base_type& kv = m_kernel.value[kx][ky];
+								sumr += kv * clr.r();
+								sumg += kv * clr.g();
+								sumb += kv * clr.b();
+								suma += kv * clr.a();
+							}
 						}
 					}
+					out[x] = core::rgba((int)math::clamp(sumr, 0.0f, 255.0f),
+										(int)math::clamp(sumg, 0.0f, 255.0f),
+										(int)math::clamp(sumb, 0.0f, 255.0f),
+										(int)math::clamp(suma, 0.0f, 255.0f));
 				}
-				dst.put_pixel(core::rgba((int)math::clamp(sumr, 0.0f, 255.0f),
-										 (int)math::clamp(sumg, 0.0f, 255.0f),
-										 (int)math::clamp(sumb, 0.0f, 255.0f),
-										 (int)math::clamp(suma, 0.0f, 255.0f)), x, y);
+				m_dst.write_row(&out[0], 0, y, dst_width);
 			}
 		}
+		
+	private:
+		canvas& m_src;
+		canvas& m_dst;
+		const T& m_kernel;
+	};
+	
+	template<class T>
+	void apply_kernel(canvas& src, canvas& dst, const T& k)
+	{
+		apply_kernel_task<T> task(src, dst, k);
+		detail::parallel_rows(dst.get_height(), 16, task);
 	}
 
 	/// Shrink the image to the nearest lower power of 2 boundary in width and height
@@ -106,6 +159,34 @@ namespace image
 		return copy(src_c, dst_c, src->get_rect(0), vector2i(0,0));
 	}	
 	
+	/// converts a band of rows through an rgba line buffer
+	class convert_rows_task : public detail::row_task
+	{
+	public:
+		convert_rows_task(canvas& src, int srcx, int srcy, canvas& dst, int dstx, int dsty, int width) :
+			m_src(src), m_srcx(srcx), m_srcy(srcy),
+			m_dst(dst), m_dstx(dstx), m_dsty(dsty),
+			m_width(width)
+		{}
+		
+		virtual void run(int begin, int end)
+		{
+			std::vector<core::rgba> line(m_width);
+			for(int y = begin; y < end; ++y)
+			{
+				m_src.read_row(m_srcx, m_srcy + y, m_width, &line[0]);
+				m_dst.write_row(&line[0], m_dstx, m_dsty + y, m_width);
+			}
+		}
+		
+	private:
+		canvas& m_src;
+		const int m_srcx, m_srcy;
+		canvas& m_dst;
+		const int m_dstx, m_dsty;
+		const int m_width;
+	};
+	
 	/// Copy from one canvas to another, this will convert the pixel format if necessary.
 	IMAGE_ABI bool copy(canvas& src_canvas, canvas& dst_canvas, const math::recti& src_rect, const math::vector2i& dst_pos)
 	{
@@ -113,13 +194,32 @@ namespace image
 		if(src_rect.get_width() == 0 || src_rect.get_height() == 0)
 			return true;
 			
-			
-		int width = dst_canvas.get_width();
-		int height = dst_canvas.get_height();
+		vector2i tl = src_rect.get_top_left();
+		int width = src_rect.get_width();
+		int height = src_rect.get_height();
 		
-		// crop to fit to destination
-		if(dst_pos.x() >= width ||
-		   dst_pos.y() >= height)
+		// rgba images know how to convert between their layouts efficiently and block compressed
+		// images encode and decode whole blocks at a time
+		if((image_rgba::is_rgba_format(src_canvas.get_format()) &&
+		    image_rgba::is_rgba_format(dst_canvas.get_format())) ||
+		   image_dxtn::is_dxtn_format(dst_canvas.get_format()))
+		{
+			return dst_canvas.get_owner()->copy(dst_pos.x(), dst_pos.y(), tl.x(), tl.y(), width, height, src_canvas, dst_canvas);
+		}
+		if(image_dxtn::is_dxtn_format(src_canvas.get_format()))
+			return src_canvas.get_owner()->copy(dst_pos.x(), dst_pos.y(), tl.x(), tl.y(), width, height, src_canvas, dst_canvas);
+		
+		// 16 bit images keep their precision by converting through float rows
+		if(image_rgba64::is_rgba64_format(dst_canvas.get_format()))
+			return dst_canvas.get_owner()->copy(dst_pos.x(), dst_pos.y(), tl.x(), tl.y(), width, height, src_canvas, dst_canvas);
+		if(image_rgba64::is_rgba64_format(src_canvas.get_format()))
+			return src_canvas.get_owner()->copy(dst_pos.x(), dst_pos.y(), tl.x(), tl.y(), width, height, src_canvas, dst_canvas);
+		
+		// crop to fit to source and destination
+		if(dst_pos.x() >= dst_canvas.get_width() ||
+		   dst_pos.y() >= dst_canvas.get_height() ||
+		   tl.x() >= src_canvas.get_width() ||
+		   tl.y() >= src_canvas.get_height())
 		{
 			return true;
 		}
@@ -128,30 +228,56 @@ namespace image
 			width = dst_canvas.get_width() - dst_pos.x();
 		if((dst_pos.y() + height) > dst_canvas.get_height())
 			height = dst_canvas.get_height() - dst_pos.y();
+		if((tl.x() + width) > src_canvas.get_width())
+			width = src_canvas.get_width() - tl.x();
+		if((tl.y() + height) > src_canvas.get_height())
+			height = src_canvas.get_height() - tl.y();
 		 
-		// super slow 
-		vector2i tl = src_rect.get_top_left();
-		for(int sy = tl.y(), dy = dst_pos.y(); sy < height; ++sy, ++dy)
+		// convert a row at a time through an rgba line buffer
+		convert_rows_task task(src_canvas, tl.x(), tl.y(), dst_canvas, dst_pos.x(), dst_pos.y(), width);
+		detail::parallel_rows(height, 16, task);
+		return true;
+	}
+	
+	/// clips a rectangle to the canvas
+	static detail::region clip_to_canvas(const canvas& c, const math::recti& rect)
+	{
+		vector2i tl = rect.get_top_left();
+		detail::region r = { tl.x(), tl.y(), rect.get_width(), rect.get_height() };
+		if(r.x < 0)
 		{
-			for(int sx = tl.x(), dx = dst_pos.x(); sx < width; ++sx, ++dx)
-			{
-				core::rgba pixel = src_canvas.get_pixel(sx, sy);
-				dst_canvas.put_pixel(pixel, dx, dy);
-			}
+			r.width += r.x;
+			r.x = 0;
 		}
-		return true;
+		if(r.y < 0)
+		{
+			r.height += r.y;
+			r.y = 0;
+		}
+		if(r.x + r.width > c.get_width())
+			r.width = c.get_width() - r.x;
+		if(r.y + r.height > c.get_height())
+			r.height = c.get_height() - r.y;
+		return r;
 	}
 	
 	/// Resize the image from one canvas to another, this will convert the pixel format if necessary.
-	/// \todo implement src_rect + dst_rect support
-	IMAGE_ABI bool resize(canvas& src_canvas, canvas& dst_canvas, const math::recti& /*src_rect*/, const math::recti& /*dst_rect*/, filter_type)
-	{
-		kernel2f box_filter;
-		box_filter.value[0][0] = 0.25f;
-		box_filter.value[0][1] = 0.25f;
-		box_filter.value[1][0] = 0.25f;
-		box_filter.value[1][1] = 0.25f;
-		apply_kernel(src_canvas, dst_canvas, box_filter);		
+	IMAGE_ABI bool resize(canvas& src_canvas, canvas& dst_canvas, const math::recti& src_rect, const math::recti& dst_rect, filter_type filter, int flags, pixel_arena* arena)
+	{
+		if(detail::get_filter_support(filter) == 0.0f)
+			return false;
+			
+		detail::region src_region = clip_to_canvas(src_canvas, src_rect);
+		detail::region dst_region = clip_to_canvas(dst_canvas, dst_rect);
+		
+		// allow 0 width and height as a no op
+		if(src_region.width <= 0 || src_region.height <= 0 ||
+		   dst_region.width <= 0 || dst_region.height <= 0)
+		{
+			return true;
+		}
+		
+		detail::resample(src_canvas, src_region, dst_canvas, dst_region, filter, flags, arena);
 		return true;
 	}
 	
@@ -200,26 +326,94 @@ namespace image
 #endif			
 	}
 	
+	/// encodes the colour channels of a band of rows from linear to sRGB
+	class gamma_correct_task : public detail::row_task
+	{
+	public:
+		gamma_correct_task(canvas& c) :
+			m_canvas(c),
+			m_table(detail::get_srgb_tables().from_linear8)
+		{}
+		
+		virtual void run(int begin, int end)
+		{
+			const int width = m_canvas.get_width();
+			std::vector<core::rgba> line(width);
+			for(int y = begin; y < end; ++y)
+			{
+				m_canvas.read_row(0, y, width, &line[0]);
+				for(int x = 0; x < width; ++x)
+				{
+					core::rgba& c = line[x];
+					c = core::rgba(m_table[c.r()], m_table[c.g()], m_table[c.b()], c.a());
+				}
+				m_canvas.write_row(&line[0], 0, y, width);
+			}
+		}
+		
+	private:
+		canvas& m_canvas;
+		const core::uint8* m_table;
+	};
+	
 	/// gamma correct the image
-	IMAGE_ABI bool gamma_correct(image_base_ptr)
+	IMAGE_ABI bool gamma_correct(image_base_ptr img)
 	{
-		return false;
+		for(int m = 0; m < img->get_num_mips(); ++m)
+		{
+			canvas c;
+			if(!img->get_mip_level(m, &c))
+				return false;
+			gamma_correct_task task(c);
+			detail::parallel_rows(c.get_height(), 16, task);
+		}
+		return true;
 	}
 	
+	/// number of levels in a full mip chain down to 1x1
+	IMAGE_ABI int get_mip_chain_length(int width, int height)
+	{
+		int length = 1;
+		while((width >> length) > 0 || (height >> length) > 0)
+			++length;
+		return length;
+	}
+
 	/// build the mip chain for the image
-	/// \todo implement support for min_mip_width and min_mip_height
-	IMAGE_ABI bool build_mip_chain(image_base_ptr img, int /*min_mip_width*/, int /*min_mip_height*/)
+	IMAGE_ABI bool build_mip_chain(image_base_ptr img, int min_mip_width, int min_mip_height, filter_type filter, int flags)
 	{
-		canvas src_c;
-		if(!img->get_mip_level(0, &src_c))
+		if(detail::get_filter_support(filter) == 0.0f)
 			return false;
 			
-		for(int m = 1; m < img->get_num_mips(); ++m)
+		// stop at the smallest level that is still at least the minimum size
+		int last = 0;
+		for(int m = 1; m < img->get_num_mips(); ++m, ++last)
+		{
+			canvas c;
+			if(!img->get_mip_level(m, &c))
+				return false;
+			if(c.get_width() < min_mip_width || c.get_height() < min_mip_height)
+				break;
+		}
+		
+		// box filtered levels that halve in size are the average of each 2x2 block above, these
+		// are all made in a single pass over the top level
+		int m = 0;
+		if(filter == filter_type_box)
+		{
+			m = detail::find_cascade_end(*img, 0, last);
+			detail::cascade_mips(*img, 0, m, (flags & resample_flag_srgb) != 0);
+		}
+			
+		canvas src_c;
+		if(!img->get_mip_level(m, &src_c))
+			return false;
+		for(++m; m <= last; ++m)
 		{
 			canvas dst_c;
 			if(!img->get_mip_level(m, &dst_c))
 				return false;
-			if(!image::resize(src_c, dst_c, img->get_rect(m-1), img->get_rect(m), filter_type_box))
+			if(!image::resize(src_c, dst_c, img->get_rect(m-1), img->get_rect(m), filter, flags))
 				return false;
 			src_c = dst_c;
 		}
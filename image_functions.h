@@ -30,9 +30,31 @@ namespace image
 	{
 		filter_type_invalid = 0,
 		filter_type_box,
-		filter_type_gaussian
+		filter_type_gaussian,
+		filter_type_triangle,
+		filter_type_mitchell,	///< mitchell netravali cubic, B = C = 1/3
+		filter_type_lanczos3,
+		filter_type_kaiser		///< kaiser windowed sinc, 3 lobes
 	};
 	
+	/// options for resize and build_mip_chain
+	enum resample_flags
+	{
+		resample_flag_none			= 0,
+		resample_flag_fixed_point	= 1 << 0,	///< filter 8 bit channels with 14 bit fixed point weights instead of floats, 
+												///< faster and bit exact across machines but loses precision on wider channels
+		resample_flag_srgb			= 1 << 1	///< colour channels are sRGB encoded, filter them in linear light. 
+												///< this takes precedence over resample_flag_fixed_point
+	};
+	
+	/// Set the number of threads the image functions split their work across, 0 uses one per 
+	/// hardware thread and 1 runs everything on the calling thread. Results are identical 
+	/// whatever the count. Calls from inside a task are ignored.
+	IMAGE_ABI void set_num_worker_threads(int num_threads);
+	
+	/// \returns the number of threads the image functions split their work across
+	IMAGE_ABI int get_num_worker_threads();
+	
 	/// Shrink the image to the nearest lower power of 2 boundary in width and height
 	/// if not already a power of 2.
 	IMAGE_ABI bool shrink_to_pow2(image_base_ptr, filter_type);
@@ -48,17 +70,28 @@ namespace image
 	IMAGE_ABI bool copy(canvas& src_canvas, canvas& dst_canvas, const math::recti& src_rect, const math::vector2i& dst_pos);
 	
 	/// Resize the image from one canvas to another, this will convert the pixel format if necessary.
-	IMAGE_ABI bool resize(canvas& src_canvas, canvas& dst_canvas, const math::recti& src_rect, const math::recti& dst_rect, filter_type);
+	/// The source rectangle is filtered into the destination rectangle, both are clipped to their canvas. 
+	/// The filter is applied separably so the cost per pixel is linear in the filter width.
+	/// \param flags combination of resample_flags
+	/// \param arena row buffers come from here if set
+	IMAGE_ABI bool resize(canvas& src_canvas, canvas& dst_canvas, const math::recti& src_rect, const math::recti& dst_rect, filter_type, int flags = resample_flag_none, pixel_arena* arena = 0);
 	
 	/// gamma correct the image, this corrects all the canvas in the mip chain. Ideally
 	/// images should have mip maps generated in linear space then re gamma'd to avoid 
-	/// accuracy loss.
+	/// accuracy loss. The colour channels are encoded from linear to sRGB, alpha is unchanged.
 	IMAGE_ABI bool gamma_correct(image_base_ptr);
 	
-	/// build the mip chain for the image
-	/// \param min_mip_width minimum width to create mip levels to
-	/// \param min_mip_height minimum height to create mip levels to
-	IMAGE_ABI bool build_mip_chain(image_base_ptr, int min_mip_width, int min_mip_height);
+	/// \returns number of levels in a full mip chain down to 1x1 for an image of the passed size
+	IMAGE_ABI int get_mip_chain_length(int width, int height);
+
+	/// build the mip chain for the image, each level is filtered from the one above. Box filtered 
+	/// levels that are half the size of the one above are made in a single tiled pass over the 
+	/// top level.
+	/// \param min_mip_width minimum width to create mip levels to, smaller levels are left untouched
+	/// \param min_mip_height minimum height to create mip levels to, smaller levels are left untouched
+	/// \param filter filter used to create each level from the one above
+	/// \param flags combination of resample_flags
+	IMAGE_ABI bool build_mip_chain(image_base_ptr, int min_mip_width, int min_mip_height, filter_type filter = filter_type_box, int flags = resample_flag_none);
 
 
 	// experimental
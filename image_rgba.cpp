@@ -8,7 +8,13 @@
 // INCLUDES
 //////////////////////////////////////////////////////////////////////////////
 #include "image_rgba.h"
+#include "pixel_convert.h"
+#include "tile_scheduler.h"
 #include "core/memory.h"
+#include <algorithm>
+#include <climits>
+#include <string.h>
+#include <vector>
 
 //////////////////////////////////////////////////////////////////////////////
 // CLASS
@@ -25,10 +31,12 @@ namespace image
 	image_rgba::pixel_layout image_rgba::pixel_layout_bgr888   = { 0, 0xff, 8, 0xff, 16, 0xff, 0, 0 };
 	image_rgba::pixel_layout image_rgba::pixel_layout_argb4444 = { 8, 0xf, 4, 0xf, 0, 0xf, 12, 0xf};
 	image_rgba::pixel_layout image_rgba::pixel_layout_argb1555   = { 10, 0x1f, 5, 0x1f, 0, 0x1f, 15, 0x1};
-	image_rgba::pixel_layout image_rgba::pixel_layout_rgb565     = { 11, 0x1f, 5, 0x1f, 0, 0x1f, 0, 0};
-	image_rgba::pixel_layout image_rgba::pixel_layout_bgr565     = {  0, 0x1f, 5, 0x1f, 11, 0x1f, 0, 0};
+	image_rgba::pixel_layout image_rgba::pixel_layout_rgb565     = { 11, 0x1f, 5, 0x3f, 0, 0x1f, 0, 0};
+	image_rgba::pixel_layout image_rgba::pixel_layout_bgr565     = {  0, 0x1f, 5, 0x3f, 11, 0x1f, 0, 0};
 	image_rgba::pixel_layout image_rgba::pixel_layout_bgrx5551   = {  0, 0x1f, 5, 0x1f, 11, 0x1f, 0, 0};
 	image_rgba::pixel_layout image_rgba::pixel_layout_a8   = {  0, 0, 0, 0, 0, 0, 0, 0xff};
+	image_rgba::pixel_layout image_rgba::pixel_layout_l8   = {  0, 0xff, 0, 0xff, 0, 0xff, 0, 0};
+	image_rgba::pixel_layout image_rgba::pixel_layout_la88 = {  8, 0xff, 8, 0xff, 8, 0xff, 0, 0xff};
 	
 	/// constructor. takes a series of shifts and masks to access the underlying colour channels
 	image_rgba::image_rgba(int rshift, int rmask, int gshift, int gmask, int bshift, int bmask, int ashift, int amask) :
@@ -36,10 +44,13 @@ namespace image
 		m_height(0),
 		m_bytes_per_pixel(0),
 		m_num_mip_levels(0),
+		m_row_alignment(1),
 		m_pixels(0),
-		m_pixels_owned(false)
+		m_pixels_owned(false),
+		m_pixels_capacity(0),
+		m_allocator(&get_default_pixel_allocator()),
+		m_pixels_allocator(0)
 	{
-		core::mem_zero(m_mip_offsets);
 		m_layout.rshift = rshift;
 		m_layout.rmask = rmask;
 		m_layout.gshift = gshift;
@@ -57,78 +68,171 @@ namespace image
 		m_height(0),
 		m_bytes_per_pixel(0),
 		m_num_mip_levels(0),
+		m_row_alignment(1),
 		m_pixels(0),
-		m_pixels_owned(false)
+		m_pixels_owned(false),
+		m_pixels_capacity(0),
+		m_allocator(&get_default_pixel_allocator()),
+		m_pixels_allocator(0)
 	{
 	}
 	
 	/// destructor
 	image_rgba::~image_rgba()
+	{
+		release_pixels();
+	}
+	
+	void image_rgba::release_pixels()
 	{
 		if(m_pixels_owned)
-			core::safe_delete_array(m_pixels);
-		else
-			m_pixels = 0;
+			m_pixels_allocator->deallocate(m_pixels, m_pixels_capacity);
+		m_pixels = 0;
+		m_pixels_owned = false;
+		m_pixels_capacity = 0;
+		m_pixels_allocator = 0;
 	}
 	
 	
+	void image_rgba::set_row_alignment(int alignment)
+	{
+		TYCHO_ASSERT(alignment > 0);
+		m_row_alignment = alignment;
+	}
+	
 	int image_rgba::setup_mip_info(int width, int height, int num_mip_levels)
 	{
-		int total_size = 0;
-		{
-			mip_info& mip = m_mip_offsets[0];
-			mip.offset = 0;
-			mip.w = width;
-			mip.h = height;
-			total_size += width * height * m_bytes_per_pixel;
-			int w = width >> 1, h = height >> 1;
-			int m = 1;
-			for(; w > 4 && h > 4 && m < num_mip_levels; w >>= 1, h >>= 1, ++m)
-			{
-				mip_info& mip = m_mip_offsets[m];
-				mip.offset = total_size;
-				mip.w = w;
-				mip.h = h;				
-				total_size += w * h * m_bytes_per_pixel;
-			}
-		}
-		return total_size;
+		return detail::setup_mip_table(width, height, num_mip_levels, 1, m_bytes_per_pixel, m_row_alignment, m_mip_offsets);
 	}
 	
 	bool image_rgba::resize_canvas(int width, int height, int num_mip_levels, bool preserve_contents)
 	{ 
-		if(num_mip_levels >= MaxMips)
+		if(width <= 0 || height <= 0 || num_mip_levels <= 0)
 			return false;
 		
 		// calculate total size including mip chain and setup mip offsets	
-		int total_size = setup_mip_info(width, height, num_mip_levels);
-		core::uint8* new_pixels = new core::uint8[total_size];
-		if(preserve_contents && m_pixels)
+		detail::mip_table old_mips;
+		old_mips.swap(m_mip_offsets);
+		const int total_size = setup_mip_info(width, height, num_mip_levels);
+		if(total_size < 0)
 		{
-			//copy(0, 0, 0, 0, m_width, m_height, m_canvas, new_canvas);
+			m_mip_offsets.swap(old_mips);
+			return false;
 		}
-		if(m_pixels_owned)
-			delete[] m_pixels;
+		const bool preserve = preserve_contents && m_pixels;
+		const int num_preserved = preserve ? static_cast<int>(std::min(old_mips.size(), m_mip_offsets.size())) : 0;
+		
+		// reuse our own buffer if it is big enough and not mostly wasted, moving what is kept
+		// into place unless the levels overlap in a way that can't be done in place
+		if(m_pixels_owned && m_pixels_allocator == m_allocator &&
+		   total_size <= m_pixels_capacity && total_size >= m_pixels_capacity / 2 &&
+		   move_levels(old_mips, num_preserved))
+		{
+			m_width = width;
+			m_height = height;
+			m_num_mip_levels = static_cast<int>(m_mip_offsets.size());
+			return true;
+		}
+		
+		core::uint8* new_pixels = m_allocator->allocate(total_size);
+		if(!new_pixels)
+		{
+			m_mip_offsets.swap(old_mips);
+			return false;
+		}
+		if(preserve)
+			detail::copy_mip_overlap(old_mips, m_pixels, m_mip_offsets, new_pixels);
+		release_pixels();
 		m_pixels = new_pixels;
 		m_pixels_owned = true;
+		m_pixels_capacity = total_size;
+		m_pixels_allocator = m_allocator;
 		m_width = width;
 		m_height = height;
-		m_num_mip_levels = num_mip_levels;
+		m_num_mip_levels = static_cast<int>(m_mip_offsets.size());
+		return true;
+	}
+
+	bool image_rgba::move_levels(const detail::mip_table& old_mips, int num_levels)
+	{
+		// rows can be moved within the buffer if every one moves the same way, forwards from
+		// the start when they all move down and backwards from the end when they all move up.
+		// the distance a row moves changes linearly down a level so its ends decide.
+		bool down = false, up = false;
+		for(int m = 0; m < num_levels; ++m)
+		{
+			const mip_info& src = old_mips[m];
+			const mip_info& dst = m_mip_offsets[m];
+			const int last = std::min(src.rows, dst.rows) - 1;
+			const int first_move = dst.offset - src.offset;
+			const int last_move = first_move + last * (dst.pitch - src.pitch);
+			down = down || first_move < 0 || last_move < 0;
+			up = up || first_move > 0 || last_move > 0;
+		}
+		if(down && up)
+			return false;
+			
+		if(down)
+		{
+			for(int m = 0; m < num_levels; ++m)
+			{
+				const mip_info& src = old_mips[m];
+				const mip_info& dst = m_mip_offsets[m];
+				const int row_bytes = std::min(src.row_bytes, dst.row_bytes);
+				const int rows = std::min(src.rows, dst.rows);
+				for(int y = 0; y < rows; ++y)
+					memmove(m_pixels + dst.offset + y * dst.pitch, m_pixels + src.offset + y * src.pitch, row_bytes);
+			}
+		}
+		else if(up)
+		{
+			for(int m = num_levels - 1; m >= 0; --m)
+			{
+				const mip_info& src = old_mips[m];
+				const mip_info& dst = m_mip_offsets[m];
+				const int row_bytes = std::min(src.row_bytes, dst.row_bytes);
+				for(int y = std::min(src.rows, dst.rows) - 1; y >= 0; --y)
+					memmove(m_pixels + dst.offset + y * dst.pitch, m_pixels + src.offset + y * src.pitch, row_bytes);
+			}
+		}
 		return true;
 	}
 
 	bool image_rgba::create_view(int width, int height, int num_mip_levels, core::uint8* pixels)
 	{
-		if(num_mip_levels >= MaxMips)
+		if(width <= 0 || height <= 0 || num_mip_levels <= 0 || !pixels)
 			return false;
-		if(m_pixels_owned)
-			delete[] m_pixels;
-		setup_mip_info(width, height, num_mip_levels);
+		detail::mip_table old_mips;
+		old_mips.swap(m_mip_offsets);
+		if(setup_mip_info(width, height, num_mip_levels) < 0)
+		{
+			m_mip_offsets.swap(old_mips);
+			return false;
+		}
+		release_pixels();
+		m_pixels = pixels;
+		m_pixels_owned = false;
+		m_width = width;
+		m_height = height;
+		m_num_mip_levels = static_cast<int>(m_mip_offsets.size());
+		return true;
+	}
+
+	bool image_rgba::create_view(int width, int height, core::uint8* pixels, int pitch)
+	{
+		if(width <= 0 || height <= 0 || !pixels || pitch < (core::int64)width * m_bytes_per_pixel || 
+		   (core::int64)pitch * height > INT_MAX)
+		{
+			return false;
+		}
+		release_pixels();
+		setup_mip_info(width, height, 1);
+		m_mip_offsets[0].pitch = pitch;
 		m_pixels = pixels;
 		m_pixels_owned = false;
 		m_width = width;
 		m_height = height;
-		m_num_mip_levels = num_mip_levels;
+		m_num_mip_levels = 1;
 		return true;
 	}
 	
@@ -150,7 +254,7 @@ namespace image
 			height = c.get_height() - y;
 			
 		// copy a line at a time into place		
-		int dst_stride = c.get_width() * m_bytes_per_pixel;
+		int dst_stride = c.get_pitch();
 		core::uint8* dst_ptr = c.get_pixels() + dst_stride * y + x * m_bytes_per_pixel;
 		int src_stride = width * m_bytes_per_pixel;
 		const core::uint8* src_ptr = src;
@@ -166,13 +270,12 @@ namespace image
 	
 	void image_rgba::clear(core::rgba clr, int mip_level)
 	{
-		for(int y = 0; y < get_height(); ++y)
-		{
-			for(int x = 0; x < get_width(); ++x)
-			{
-				put_pixel(clr, mip_level, x, y);
-			}
-		}
+		if(mip_level >= m_num_mip_levels)
+			return;
+		const mip_info& mip = m_mip_offsets[mip_level];
+		std::vector<core::rgba> row(mip.w, clr);
+		for(int y = 0; y < mip.h; ++y)
+			write_row(&row[0], mip_level, 0, y, mip.w);
 	}
 
 	bool image_rgba::has_channel(colour_channel c) const
@@ -188,6 +291,68 @@ namespace image
 	}
 
 
+	/// smallest band of rows a thread copies when the layouts match
+	static const int CopyBandBytes = 64 * 1024;
+	
+	/// copies a band of rows between two rgba canvases
+	class rgba_copy_task : public detail::row_task
+	{
+	public:
+		rgba_copy_task(canvas& src, int srcx, int srcy, canvas& dst, int dstx, int dsty, int width, bool same_layout, convert_row_fn convert) :
+			m_src(src), m_srcx(srcx), m_srcy(srcy),
+			m_dst(dst), m_dstx(dstx), m_dsty(dsty),
+			m_width(width),
+			m_same_layout(same_layout),
+			m_convert(convert)
+		{}
+		
+		virtual void run(int begin, int end)
+		{
+			const image_rgba* src_img = static_cast<const image_rgba*>(m_src.get_owner());
+			const image_rgba* dst_img = static_cast<const image_rgba*>(m_dst.get_owner());
+			const int src_offset = m_srcx * src_img->get_bytes_per_pixel();
+			const int dst_offset = m_dstx * dst_img->get_bytes_per_pixel();
+			if(m_same_layout)
+			{
+				// in one go if the rows are contiguous
+				const int row_bytes = m_width * src_img->get_bytes_per_pixel();
+				if(row_bytes == m_src.get_pitch() && row_bytes == m_dst.get_pitch())
+				{
+					core::mem_cpy(m_dst.get_row(m_dsty + begin), m_src.get_row(m_srcy + begin), row_bytes * (end - begin));
+				}
+				else
+				{
+					for(int y = begin; y < end; ++y)
+						core::mem_cpy(m_dst.get_row(m_dsty + y) + dst_offset, m_src.get_row(m_srcy + y) + src_offset, row_bytes);
+				}
+			}
+			else if(m_convert)
+			{
+				for(int y = begin; y < end; ++y)
+					m_convert(m_src.get_row(m_srcy + y) + src_offset, m_dst.get_row(m_dsty + y) + dst_offset, m_width);
+			}
+			else
+			{
+				// otherwise convert a row at a time through an rgba line buffer
+				std::vector<core::rgba> line(m_width);
+				for(int y = begin; y < end; ++y)
+				{
+					m_src.read_row(m_srcx, m_srcy + y, m_width, &line[0]);
+					m_dst.write_row(&line[0], m_dstx, m_dsty + y, m_width);
+				}
+			}
+		}
+		
+	private:
+		canvas& m_src;
+		const int m_srcx, m_srcy;
+		canvas& m_dst;
+		const int m_dstx, m_dsty;
+		const int m_width;
+		const bool m_same_layout;
+		const convert_row_fn m_convert;
+	};
+	
 	/// copy from one rgba surface to another
 	bool image_rgba::copy(int dstx, int dsty, int srcx, int srcy, int width, int height, canvas& src_canvas, canvas& dst_canvas)
 	{
@@ -202,9 +367,11 @@ namespace image
 		if(width == 0 || height == 0)
 			return true;
 			
-		// crop to fit to destination
+		// crop to fit to source and destination
 		if(dstx >= dst_canvas.get_width() ||
-		   dsty >= dst_canvas.get_height())
+		   dsty >= dst_canvas.get_height() ||
+		   srcx >= src_canvas.get_width() ||
+		   srcy >= src_canvas.get_height())
 		{
 			return true;
 		}		
@@ -212,16 +379,27 @@ namespace image
 			width = dst_canvas.get_width() - dstx;
 		if((dsty + height) > dst_canvas.get_height())
 			height = dst_canvas.get_height() - dsty;
+		if((srcx + width) > src_canvas.get_width())
+			width = src_canvas.get_width() - srcx;
+		if((srcy + height) > src_canvas.get_height())
+			height = src_canvas.get_height() - srcy;
 		 
-		// super slow 
-		for(int sy = srcy, dy = dsty; sy < (srcy + height); ++sy, ++dy)
+		const image_rgba* src_img = static_cast<const image_rgba*>(src_canvas.get_owner());
+		const image_rgba* dst_img = static_cast<const image_rgba*>(dst_canvas.get_owner());
+		
+		// identical layouts are a straight copy of the bytes, otherwise use a converter specialised 
+		// for the two layouts if there is one. bands of straight copies are sized so each thread 
+		// moves a reasonable amount of memory.
+		const bool same_layout = src_img->has_same_layout(*dst_img);
+		const convert_row_fn convert = same_layout ? 0 : find_row_converter(*src_img, *dst_img);
+		int grain = 16;
+		if(same_layout)
 		{
-			for(int sx = srcx, dx = dstx; sx < (srcx + width); ++sx, ++dx)
-			{
-				core::rgba pixel = src_canvas.get_pixel(sx, sy);
-				dst_canvas.put_pixel(pixel, dx, dy);
-			}
+			const int row_bytes = width * src_img->get_bytes_per_pixel();
+			grain = row_bytes < CopyBandBytes ? CopyBandBytes / row_bytes : 1;
 		}
+		rgba_copy_task task(src_canvas, srcx, srcy, dst_canvas, dstx, dsty, width, same_layout, convert);
+		detail::parallel_rows(height, grain, task);
 		return true;
 	}
 	
@@ -231,13 +409,50 @@ namespace image
 			return false;
 			
 		const mip_info& mip = m_mip_offsets[i];
-		*out_canvas = canvas(this, mip.w, mip.h, i, &m_pixels[mip.offset], m_bytes_per_pixel * mip.w * mip.h, m_bytes_per_pixel * mip.w);
+		*out_canvas = canvas(this, mip.w, mip.h, i, &m_pixels[mip.offset], mip.pitch * mip.h, mip.pitch);
 		return true;
 	}
 
+	core::uint8* image_rgba::get_pixel_ptr(int mip_level, int x, int y) const
+	{
+		TYCHO_ASSERT(mip_level < m_num_mip_levels);
+		const mip_info& mip = m_mip_offsets[mip_level];
+		return m_pixels + mip.offset + y * mip.pitch + x * m_bytes_per_pixel;
+	}
+	
+	void image_rgba::read_row(int mip_level, int x, int y, int width, core::rgba* dst) const
+	{
+		TYCHO_ASSERT(x >= 0 && y >= 0 && x + width <= m_mip_offsets[mip_level].w && y < m_mip_offsets[mip_level].h);
+		const core::uint8* p = get_pixel_ptr(mip_level, x, y);
+		const core::rgba* end = dst + width;
+		switch(m_bytes_per_pixel)
+		{
+			case 1 : for(; dst != end; ++dst, p += 1) *dst = unpack_pixel(detail::packed_pixel<1>::load(p)); break;
+			case 2 : for(; dst != end; ++dst, p += 2) *dst = unpack_pixel(detail::packed_pixel<2>::load(p)); break;
+			case 3 : for(; dst != end; ++dst, p += 3) *dst = unpack_pixel(detail::packed_pixel<3>::load(p)); break;
+			case 4 : for(; dst != end; ++dst, p += 4) *dst = unpack_pixel(detail::packed_pixel<4>::load(p)); break;
+			default: TYCHO_NOT_IMPLEMENTED; break;
+		}
+	}
+
+	void image_rgba::write_row(const core::rgba* src, int mip_level, int x, int y, int width)
+	{
+		TYCHO_ASSERT(x >= 0 && y >= 0 && x + width <= m_mip_offsets[mip_level].w && y < m_mip_offsets[mip_level].h);
+		core::uint8* p = get_pixel_ptr(mip_level, x, y);
+		const core::rgba* end = src + width;
+		switch(m_bytes_per_pixel)
+		{
+			case 1 : for(; src != end; ++src, p += 1) detail::packed_pixel<1>::store(p, pack_pixel(*src)); break;
+			case 2 : for(; src != end; ++src, p += 2) detail::packed_pixel<2>::store(p, pack_pixel(*src)); break;
+			case 3 : for(; src != end; ++src, p += 3) detail::packed_pixel<3>::store(p, pack_pixel(*src)); break;
+			case 4 : for(; src != end; ++src, p += 4) detail::packed_pixel<4>::store(p, pack_pixel(*src)); break;
+			default: TYCHO_NOT_IMPLEMENTED; break;
+		}
+	}
+
 	int image_rgba::get_stride() const
 	{
-		return get_width() * m_bytes_per_pixel;
+		return m_mip_offsets.empty() ? 0 : m_mip_offsets[0].pitch;
 	}
 	
 	
@@ -257,7 +472,7 @@ namespace image
 			case image_format_rgba16 :
 			case image_format_a8 : return true;
                 
-            default: TYCHO_NOT_IMPLEMENTED; break;
+            default: break;
 		}		
 		return false;
 	}
@@ -16,6 +16,8 @@
 #include "image/image_abi.h"
 #include "image/canvas.h"
 #include "image/image.h"
+#include "image/pixel_allocator.h"
+#include "image/mip_table.h"
 
 //////////////////////////////////////////////////////////////////////////////
 // CLASS
@@ -36,6 +38,20 @@ namespace image
 			int gshift, gmask;
 			int bshift, bmask;
 			int ashift, amask;				
+			
+			bool operator==(const pixel_layout& o) const
+			{
+				return rshift == o.rshift && rmask == o.rmask &&
+					   gshift == o.gshift && gmask == o.gmask &&
+					   bshift == o.bshift && bmask == o.bmask &&
+					   ashift == o.ashift && amask == o.amask;
+			}
+
+			/// \returns true if red, green and blue are the same bits, they hold a luminance
+			bool is_luminance() const
+			{
+				return rmask && rshift == gshift && rmask == gmask && rshift == bshift && rmask == bmask;
+			}
 		};
 		
 		static pixel_layout pixel_layout_rgba8888;
@@ -49,6 +65,8 @@ namespace image
 		static pixel_layout pixel_layout_bgrx8888;
 		static pixel_layout pixel_layout_bgr888;
 		static pixel_layout pixel_layout_a8;
+		static pixel_layout pixel_layout_l8;	///< grey in red, green and blue, alpha is opaque
+		static pixel_layout pixel_layout_la88;	///< grey in red, green and blue followed by alpha
 		
     public:
 		/// constructor. takes a series of shifts and masks to access the underlying colour channels
@@ -74,6 +92,10 @@ namespace image
 		virtual bool get_mip_level(int i, canvas*);
 		virtual int  get_stride() const;
 		virtual math::recti get_rect(int mip_level);
+		virtual void read_row(int mip_level, int x, int y, int width, core::rgba* dst) const;
+		virtual void write_row(const core::rgba* src, int mip_level, int x, int y, int width);
+		using image_base::read_row;
+		using image_base::write_row;
 		//@}
 		
 		/// \returns The pixel layout for this image
@@ -82,27 +104,111 @@ namespace image
 		
 		/// \returns true if the passed format is a rgba format
 		static bool is_rgba_format(image_format);
+
+		/// \returns bytes allocated for the pixels, resizes that fit reuse them if they use at
+		/// least half, 0 for views
+		int get_capacity() const
+			{ return m_pixels_capacity; }
+
+		/// \returns the allocator the pixels are allocated with
+		pixel_allocator& get_allocator() const
+			{ return *m_allocator; }
+
+		/// set the allocator the pixels are allocated with from the next resize, defaults to 
+		/// \ref get_default_pixel_allocator. Pixels already allocated are freed with the 
+		/// allocator they came from.
+		void set_allocator(pixel_allocator& allocator)
+			{ m_allocator = &allocator; }
+
+		/// creates a view of a single level over an external pixel buffer whose rows are pitch bytes
+		/// apart, such as a locked texture or staging buffer. \returns false if pitch is shorter 
+		/// than a row.
+		bool create_view(int width, int height, core::uint8* pixels, int pitch);
+
+		/// \returns the number of bytes rows are padded to a multiple of
+		int get_row_alignment() const
+			{ return m_row_alignment; }
+
+		/// set the number of bytes rows are padded to a multiple of from the next resize_canvas
+		/// or create_view, defaults to 1 for tightly packed rows. Row starts are aligned relative
+		/// to the pixels, which the allocator aligns to \ref pixel_allocator::Alignment.
+		void set_row_alignment(int alignment);
+
+		/// \returns number of bytes per pixel
+		int get_bytes_per_pixel() const
+			{ return m_bytes_per_pixel; }
+		
+		/// \returns true if the other image stores its pixels in exactly the same way as this one
+		bool has_same_layout(const image_rgba& other) const
+		{
+			return get_image_format() == other.get_image_format() &&
+				   m_bytes_per_pixel == other.m_bytes_per_pixel &&
+				   m_layout == other.m_layout;
+		}
+		
+    protected:
+		/// \returns pointer to pixel x,y in the mip level
+		core::uint8* get_pixel_ptr(int mip_level, int x, int y) const;
 		
+		/// \returns pixel packed into an integer using this images layout, luminance layouts
+		/// store the luminance of red, green and blue
+		core::uint32 pack_pixel(core::rgba clr) const
+		{
+			if(m_layout.is_luminance())
+			{
+				return ((get_luminance(clr) & m_layout.rmask) << m_layout.rshift) |
+					   ((clr.a() & m_layout.amask) << m_layout.ashift);
+			}
+			return ((clr.r() & m_layout.rmask) << m_layout.rshift) |
+				   ((clr.g() & m_layout.gmask) << m_layout.gshift) |
+				   ((clr.b() & m_layout.bmask) << m_layout.bshift) |
+				   ((clr.a() & m_layout.amask) << m_layout.ashift);
+		}
+		
+		/// \returns the luminance of the colour, grey colours are returned as they are
+		static int get_luminance(core::rgba clr)
+			{ return (clr.r() * 77 + clr.g() * 150 + clr.b() * 29 + 128) >> 8; }
+
+		/// \returns integer pixel unpacked using this images layout, missing channels are 255
+		core::rgba unpack_pixel(core::uint32 pixel) const
+		{
+			int red   = m_layout.rmask ? (pixel >> m_layout.rshift) & m_layout.rmask : 255;
+			int green = m_layout.gmask ? (pixel >> m_layout.gshift) & m_layout.gmask : 255;
+			int blue  = m_layout.bmask ? (pixel >> m_layout.bshift) & m_layout.bmask : 255;
+			int alpha = m_layout.amask ? (pixel >> m_layout.ashift) & m_layout.amask : 255;
+			return core::rgba(red, green, blue, alpha);		
+		}
+		
+    protected:
+		typedef detail::mip_table_level mip_info;
+
     private:
 		/// non-copyable, use clone method instead
 		void operator=(const image_rgba&);
+
+		/// sets up the mip table, returns the total size in bytes or -1 if it doesn't fit an int
 		int setup_mip_info(int width, int height, int num_mips);
+
+		/// frees the pixels if we own them
+		void release_pixels();
+
+		/// moves the overlap of the old levels to the current layout in the same buffer,
+		/// \returns false if rows would be overwritten before they are moved
+		bool move_levels(const detail::mip_table& old_mips, int num_levels);
 		
     protected:
-		static const int MaxMips = 10;
-		struct mip_info
-		{
-			int w, h, offset;
-		};
-    
 		pixel_layout	m_layout;
 		int				m_width;			///< width of image
 		int				m_height;			///< height of image
 		int				m_bytes_per_pixel;	///< number of bytes per pixel
 		int				m_num_mip_levels;
+		int				m_row_alignment;	///< rows are padded to a multiple of this many bytes
 		core::uint8*	m_pixels;			///< raw pixels
 		bool			m_pixels_owned;		///< true if we own the pixel memory s should delete it
-		mip_info		m_mip_offsets[MaxMips]; ///< offsets to mip maps in pixel buffer
+		int				m_pixels_capacity;	///< bytes allocated for owned pixels, can be more than the levels use
+		pixel_allocator* m_allocator;		///< allocator for new pixels
+		pixel_allocator* m_pixels_allocator; ///< allocator the owned pixels came from
+		detail::mip_table m_mip_offsets;	///< offsets to mip maps in pixel buffer
     };
 
 } // end namespace
@@ -42,7 +42,7 @@ namespace image
 		image_rgba16(const pixel_layout& pl) :
 			image_rgba(pl)
 		{
-			m_bytes_per_pixel = 4;
+			m_bytes_per_pixel = 2;
 		}
 		
 		virtual image_format get_image_format() const { return image_format_rgba16; }
@@ -53,10 +53,7 @@ namespace image
 			if(!get_mip_level(mip_level, &c))
 				return;
 			core::uint8* p = c.get_pixels() + c.get_pitch() * y + x * m_bytes_per_pixel;
-			int new_pixel = ((clr.r() & m_layout.rmask) << m_layout.rshift) |
-							((clr.g() & m_layout.gmask) << m_layout.gshift) |
-		                    ((clr.b() & m_layout.bmask) << m_layout.bshift) |
-		                    ((clr.a() & m_layout.amask) << m_layout.ashift);
+			core::uint32 new_pixel = pack_pixel(clr);
 			p[0] = (core::uint8)(new_pixel >> 8);
 			p[1] = (core::uint8)(new_pixel);
 		}
@@ -0,0 +1,303 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Sunday, 18 October 2026 12:11:42 AM
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image_rgba64.h"
+#include "tile_scheduler.h"
+#include "core/debug/assert.h"
+#include "core/memory.h"
+#include <algorithm>
+
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+namespace tycho
+{
+namespace image
+{
+
+	/// \returns 16 bit channel rounded to 8 bits
+	static inline int to_8bit(core::uint16 v)
+	{
+		return (v * 255 + 32767) / 65535;
+	}
+
+	/// \returns 8 bit channel widened to 16 bits, 255 maps to 65535
+	static inline core::uint16 to_16bit(int v)
+	{
+		return (core::uint16)(v * 257);
+	}
+
+	/// \returns float channel in [0, 255] rounded and clamped to 16 bits
+	static inline core::uint16 float_to_16bit(float v)
+	{
+		const float s = v * 257.0f + 0.5f;
+		if(s <= 0.0f)
+			return 0;
+		if(s >= 65535.0f)
+			return 65535;
+		return (core::uint16)s;
+	}
+
+	/// converts a band of rows to or from a 16 bit canvas through float rows
+	class rgba64_copy_task : public detail::row_task
+	{
+	public:
+		rgba64_copy_task(canvas& src, int srcx, int srcy, canvas& dst, int dstx, int dsty, int width) :
+			m_src(src), m_srcx(srcx), m_srcy(srcy),
+			m_dst(dst), m_dstx(dstx), m_dsty(dsty),
+			m_width(width)
+		{}
+
+		virtual void run(int begin, int end)
+		{
+			const bool both = m_src.get_format() == image_format_rgba64 && m_dst.get_format() == image_format_rgba64;
+			std::vector<float> line(both ? 0 : m_width * 4);
+			for(int y = begin; y < end; ++y)
+			{
+				if(both)
+				{
+					core::mem_cpy(m_dst.get_row(m_dsty + y) + m_dstx * image_rgba64::BytesPerPixel,
+								  m_src.get_row(m_srcy + y) + m_srcx * image_rgba64::BytesPerPixel,
+								  m_width * image_rgba64::BytesPerPixel);
+				}
+				else
+				{
+					m_src.read_row(m_srcx, m_srcy + y, m_width, &line[0]);
+					m_dst.write_row(&line[0], m_dstx, m_dsty + y, m_width);
+				}
+			}
+		}
+
+	private:
+		canvas& m_src;
+		const int m_srcx, m_srcy;
+		canvas& m_dst;
+		const int m_dstx, m_dsty;
+		const int m_width;
+	};
+
+	image_rgba64::image_rgba64() :
+		m_width(0),
+		m_height(0),
+		m_pixels(0),
+		m_pixels_owned(false),
+		m_pixels_capacity(0),
+		m_allocator(&get_default_pixel_allocator()),
+		m_pixels_allocator(0)
+	{}
+
+	image_rgba64::~image_rgba64()
+	{
+		release_pixels();
+	}
+
+	void image_rgba64::release_pixels()
+	{
+		if(m_pixels_owned)
+			m_pixels_allocator->deallocate(m_pixels, m_pixels_capacity);
+		m_pixels = 0;
+		m_pixels_owned = false;
+		m_pixels_capacity = 0;
+		m_pixels_allocator = 0;
+	}
+
+	int image_rgba64::setup_mip_info(int width, int height, int num_mips)
+	{
+		return detail::setup_mip_table(width, height, num_mips, 1, BytesPerPixel, 1, m_mips);
+	}
+
+	bool image_rgba64::resize_canvas(int width, int height, int num_mip_levels, bool preserve_contents)
+	{
+		if(width <= 0 || height <= 0 || num_mip_levels <= 0)
+			return false;
+		detail::mip_table old_mips;
+		old_mips.swap(m_mips);
+		const int total_size = setup_mip_info(width, height, num_mip_levels);
+		if(total_size < 0)
+		{
+			m_mips.swap(old_mips);
+			return false;
+		}
+		core::uint8* new_pixels = m_allocator->allocate(total_size);
+		if(!new_pixels)
+		{
+			m_mips.swap(old_mips);
+			return false;
+		}
+		if(preserve_contents && m_pixels)
+			detail::copy_mip_overlap(old_mips, m_pixels, m_mips, new_pixels);
+		release_pixels();
+		m_pixels = new_pixels;
+		m_pixels_owned = true;
+		m_pixels_capacity = total_size;
+		m_pixels_allocator = m_allocator;
+		m_width = width;
+		m_height = height;
+		return true;
+	}
+
+	bool image_rgba64::create_view(int width, int height, int num_mip_levels, core::uint8* pixels)
+	{
+		if(width <= 0 || height <= 0 || num_mip_levels <= 0 || !pixels)
+			return false;
+		detail::mip_table old_mips;
+		old_mips.swap(m_mips);
+		if(setup_mip_info(width, height, num_mip_levels) < 0)
+		{
+			m_mips.swap(old_mips);
+			return false;
+		}
+		release_pixels();
+		m_pixels = pixels;
+		m_pixels_owned = false;
+		m_width = width;
+		m_height = height;
+		return true;
+	}
+
+	bool image_rgba64::raw_copy(int mip_level, int x, int y, int width, int height, const core::uint8* src, int src_len)
+	{
+		// validate parameters
+		if(x < 0 || y < 0 || !src || !src_len || mip_level >= get_num_mips())
+			return false;
+		const mip_info& mip = m_mips[mip_level];
+		if(x > mip.w || y > mip.h || width * height * BytesPerPixel > src_len)
+			return false;
+
+		// crop to target canvas size and copy a line at a time into place
+		const int src_stride = width * BytesPerPixel;
+		width = std::min(width, mip.w - x);
+		height = std::min(height, mip.h - y);
+		for(int row = 0; row < height; ++row, src += src_stride)
+			core::mem_cpy(get_pixel_ptr(mip_level, x, y + row), src, width * BytesPerPixel);
+		return true;
+	}
+
+	void image_rgba64::clear(core::rgba clr, int mip_level)
+	{
+		if(mip_level >= get_num_mips())
+			return;
+		const mip_info& mip = m_mips[mip_level];
+		std::vector<core::rgba> row(mip.w, clr);
+		for(int y = 0; y < mip.h; ++y)
+			write_row(&row[0], mip_level, 0, y, mip.w);
+	}
+
+	bool image_rgba64::get_mip_level(int i, canvas* out_canvas)
+	{
+		if(i >= get_num_mips() || !out_canvas)
+			return false;
+		const mip_info& mip = m_mips[i];
+		*out_canvas = canvas(this, mip.w, mip.h, i, m_pixels + mip.offset, mip.pitch * mip.rows, mip.pitch);
+		return true;
+	}
+
+	core::rgba image_rgba64::get_pixel(int mip_level, int x, int y) const
+	{
+		const core::uint16* p = get_pixel_ptr(mip_level, x, y);
+		return core::rgba(to_8bit(p[0]), to_8bit(p[1]), to_8bit(p[2]), to_8bit(p[3]));
+	}
+
+	void image_rgba64::put_pixel(core::rgba clr, int mip_level, int x, int y)
+	{
+		core::uint16* p = get_pixel_ptr(mip_level, x, y);
+		p[0] = to_16bit(clr.r());
+		p[1] = to_16bit(clr.g());
+		p[2] = to_16bit(clr.b());
+		p[3] = to_16bit(clr.a());
+	}
+
+	void image_rgba64::read_row(int mip_level, int x, int y, int width, core::rgba* dst) const
+	{
+		const core::uint16* p = get_pixel_ptr(mip_level, x, y);
+		for(int i = 0; i < width; ++i, p += 4)
+			dst[i] = core::rgba(to_8bit(p[0]), to_8bit(p[1]), to_8bit(p[2]), to_8bit(p[3]));
+	}
+
+	void image_rgba64::write_row(const core::rgba* src, int mip_level, int x, int y, int width)
+	{
+		core::uint16* p = get_pixel_ptr(mip_level, x, y);
+		for(int i = 0; i < width; ++i, p += 4)
+		{
+			p[0] = to_16bit(src[i].r());
+			p[1] = to_16bit(src[i].g());
+			p[2] = to_16bit(src[i].b());
+			p[3] = to_16bit(src[i].a());
+		}
+	}
+
+	void image_rgba64::read_row(int mip_level, int x, int y, int width, float* dst) const
+	{
+		const float scale = 1.0f / 257.0f;
+		const core::uint16* p = get_pixel_ptr(mip_level, x, y);
+		for(int i = 0; i < width; ++i, p += 4)
+		{
+			dst[i] = p[0] * scale;
+			dst[i + width] = p[1] * scale;
+			dst[i + width * 2] = p[2] * scale;
+			dst[i + width * 3] = p[3] * scale;
+		}
+	}
+
+	void image_rgba64::write_row(const float* src, int mip_level, int x, int y, int width)
+	{
+		core::uint16* p = get_pixel_ptr(mip_level, x, y);
+		for(int i = 0; i < width; ++i, p += 4)
+		{
+			p[0] = float_to_16bit(src[i]);
+			p[1] = float_to_16bit(src[i + width]);
+			p[2] = float_to_16bit(src[i + width * 2]);
+			p[3] = float_to_16bit(src[i + width * 3]);
+		}
+	}
+
+	bool image_rgba64::copy(int dstx, int dsty, int srcx, int srcy, int width, int height, canvas& src_canvas, canvas& dst_canvas)
+	{
+		// allow 0 width and height as a no op
+		if(width == 0 || height == 0)
+			return true;
+
+		// crop to fit to source and destination
+		if(dstx >= dst_canvas.get_width() ||
+		   dsty >= dst_canvas.get_height() ||
+		   srcx >= src_canvas.get_width() ||
+		   srcy >= src_canvas.get_height())
+		{
+			return true;
+		}
+		if((dstx + width) > dst_canvas.get_width())
+			width = dst_canvas.get_width() - dstx;
+		if((dsty + height) > dst_canvas.get_height())
+			height = dst_canvas.get_height() - dsty;
+		if((srcx + width) > src_canvas.get_width())
+			width = src_canvas.get_width() - srcx;
+		if((srcy + height) > src_canvas.get_height())
+			height = src_canvas.get_height() - srcy;
+
+		rgba64_copy_task task(src_canvas, srcx, srcy, dst_canvas, dstx, dsty, width);
+		detail::parallel_rows(height, 16, task);
+		return true;
+	}
+
+	math::recti image_rgba64::get_rect(int mip_level)
+	{
+		TYCHO_ASSERT(mip_level < get_num_mips());
+		return math::recti(0, 0, m_mips[mip_level].w, m_mips[mip_level].h);
+	}
+
+	/// \returns true if the passed format has 16 bits per channel
+	bool image_rgba64::is_rgba64_format(image_format fmt)
+	{
+		return fmt == image_format_rgba64;
+	}
+
+} // end namespace
+
+} // end namespace
@@ -0,0 +1,123 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Sunday, 18 October 2026 12:11:42 AM
+//////////////////////////////////////////////////////////////////////////////
+#if _MSC_VER > 1000
+#pragma once
+#endif  // _MSC_VER
+
+#ifndef __IMAGE_RGBA64_H_61506923_F214_49FB_9BF7_0486325CF7A4_
+#define __IMAGE_RGBA64_H_61506923_F214_49FB_9BF7_0486325CF7A4_
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/image_abi.h"
+#include "image/canvas.h"
+#include "image/image.h"
+#include "image/mip_table.h"
+#include "image/pixel_allocator.h"
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+namespace tycho
+{
+namespace image
+{
+
+	/// 16 bits per channel image, each pixel is four native endian core::uint16 in r, g, b, a 
+	/// order. rgba pixel and row access is rounded to 8 bits per channel, float rows keep the 
+	/// full precision so filtering and resizing don't lose it.
+    class IMAGE_ABI image_rgba64 : public image_base
+    {
+    public:
+		/// bytes per pixel
+		static const int BytesPerPixel = 8;
+
+    public:
+		/// constructor
+		image_rgba64();
+
+		/// destructor
+		~image_rgba64();
+
+		/// \name image_base interface
+		//@{
+		/// mip levels are floor(size / 2^level) pixels down to 1x1, preserve_contents keeps the
+		/// pixels each level has in common with the old one
+		virtual bool resize_canvas(int width, int height, int num_mip_levels, bool preserve_contents);
+		virtual bool create_view(int width, int height, int num_mip_levels, core::uint8* pixels);
+		virtual bool raw_copy(int mip_level, int x, int y, int width, int height, const core::uint8* src, int src_len);
+		virtual int  get_width() const				{ return m_width; }
+		virtual int  get_height() const				{ return m_height; }
+		virtual int  get_stride() const				{ return m_width * BytesPerPixel; }
+		virtual int  get_num_mips() const			{ return static_cast<int>(m_mips.size()); }
+		virtual void clear(core::rgba, int mip_level);
+		virtual bool get_mip_level(int i, canvas*);
+		virtual image_format get_image_format() const	{ return image_format_rgba64; }
+		virtual core::rgba get_pixel(int mip_level, int x, int y) const;
+		virtual void put_pixel(core::rgba, int mip_level, int x, int y);
+		virtual void read_row(int mip_level, int x, int y, int width, core::rgba* dst) const;
+		virtual void write_row(const core::rgba* src, int mip_level, int x, int y, int width);
+		virtual void read_row(int mip_level, int x, int y, int width, float* dst) const;
+		virtual void write_row(const float* src, int mip_level, int x, int y, int width);
+		virtual bool has_channel(colour_channel) const	{ return true; }
+
+		/// copies between 16 bit images are a copy of the rows, other formats are converted 
+		/// through float rows
+		virtual bool copy(int dstx, int dxty, int srcx, int srcy, int width, int height, canvas& src_canvas, canvas& dst_canvas);
+		virtual math::recti get_rect(int mip_level);
+		//@}
+
+		/// \returns pointer to the r channel of pixel x, y of the mip level
+		core::uint16* get_pixel_ptr(int mip_level, int x, int y) const
+			{ return reinterpret_cast<core::uint16*>(m_pixels + m_mips[mip_level].offset) + (y * m_mips[mip_level].w + x) * 4; }
+
+		/// \returns bytes allocated for the pixels, 0 for views
+		int get_capacity() const
+			{ return m_pixels_capacity; }
+
+		/// \returns the allocator the pixels are allocated with
+		pixel_allocator& get_allocator() const
+			{ return *m_allocator; }
+
+		/// set the allocator the pixels are allocated with from the next resize, defaults to 
+		/// \ref get_default_pixel_allocator
+		void set_allocator(pixel_allocator& allocator)
+			{ m_allocator = &allocator; }
+
+		/// \returns true if the passed format has 16 bits per channel
+		static bool is_rgba64_format(image_format);
+
+	private:
+		/// non-copyable
+		image_rgba64(const image_rgba64&);
+		void operator=(const image_rgba64&);
+
+		/// sets up the mip table, returns the total size in bytes or -1 if it doesn't fit an int
+		int setup_mip_info(int width, int height, int num_mips);
+
+		/// frees the pixels if we own them
+		void release_pixels();
+
+	private:
+		typedef detail::mip_table_level mip_info;
+
+		int m_width;
+		int m_height;
+		detail::mip_table m_mips;
+		core::uint8* m_pixels;
+		bool m_pixels_owned;
+		int m_pixels_capacity;				///< bytes allocated for owned pixels
+		pixel_allocator* m_allocator;		///< allocator for new pixels
+		pixel_allocator* m_pixels_allocator; ///< allocator the owned pixels came from
+    };
+
+} // end namespace
+} // end namespace
+
+#endif // __IMAGE_RGBA64_H_61506923_F214_49FB_9BF7_0486325CF7A4_
@@ -0,0 +1,197 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:40:28 PM
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "mip_generator.h"
+#include "srgb.h"
+#include "tile_scheduler.h"
+#include "canvas.h"
+#include "image.h"
+#include "core/debug/assert.h"
+#include <algorithm>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	/// Tiles are TileSize pixels square on the top level, 64 x 64 at 16 bits per channel is 32k 
+	/// so the tile and all the levels made from it fit in L2. Levels more than TileLevels below the top are made by
+	/// another pass starting from the last level of this one.
+	static const int TileLevels = 6;
+	static const int TileSize = 1 << TileLevels;
+
+	/// \returns true if b is a's dimension halved
+	static bool is_half(int a, int b)
+	{
+		return a == b * 2 || (a == 1 && b == 1);
+	}
+
+	int find_cascade_end(image_base& img, int top, int last)
+	{
+		canvas above;
+		if(!img.get_mip_level(top, &above))
+			return top;
+		int m = top;
+		for(; m < last; ++m)
+		{
+			canvas below;
+			if(!img.get_mip_level(m + 1, &below) ||
+			   !is_half(above.get_width(), below.get_width()) ||
+			   !is_half(above.get_height(), below.get_height()))
+			{
+				break;
+			}
+			above = below;
+		}
+		return m;
+	}
+
+	/// averages 2x2 blocks of the source tile into the destination tile, both have 4 channels per
+	/// pixel and rows TileSize pixels apart. When a dimension isn't halved the block is the pixel 
+	/// and itself along it.
+	static void reduce_tile(const core::uint16* src, int width, int height, int fx, int fy, core::uint16* dst)
+	{
+		const int stride = TileSize * 4;
+		for(int y = 0; y < height; ++y)
+		{
+			const core::uint16* r0 = src + y * fy * stride;
+			const core::uint16* r1 = r0 + (fy - 1) * stride;
+			const int step = fx * 4;
+			const int right = (fx - 1) * 4;
+			core::uint16* d = dst + y * stride;
+			for(int x = 0; x < width * 4; x += 4, r0 += step, r1 += step)
+			{
+				for(int c = 0; c < 4; ++c)
+					d[x + c] = static_cast<core::uint16>((r0[c] + r0[right + c] + r1[c] + r1[right + c] + 2) >> 2);
+			}
+		}
+	}
+
+	/// reduces bands of tile rows through a run of levels. Tiles hold 16 bits per channel, 8 bit
+	/// values are held as is unless they are sRGB in which case the colour channels are held as
+	/// 16 bit linear light.
+	class cascade_task : public row_task
+	{
+	public:
+		cascade_task(const std::vector<canvas>& levels, bool srgb) :
+			m_levels(levels),
+			m_srgb(srgb ? &get_srgb_tables() : 0)
+		{}
+
+		virtual void run(int begin, int end)
+		{
+			std::vector<core::uint16> cur(TileSize * TileSize * 4);
+			std::vector<core::uint16> next(TileSize * TileSize * 4);
+			std::vector<core::rgba> line(TileSize);
+			canvas& top = m_levels[0];
+			for(int ty = begin; ty < end; ty += TileSize)
+			{
+				for(int tx = 0; tx < top.get_width(); tx += TileSize)
+				{
+					int x = tx, y = ty;
+					int width = std::min(TileSize, top.get_width() - tx);
+					int height = std::min(TileSize, top.get_height() - ty);
+					for(int r = 0; r < height; ++r)
+					{
+						top.read_row(x, y + r, width, &line[0]);
+						load_row(&line[0], width, &cur[r * TileSize * 4]);
+					}
+
+					for(size_t l = 1; l < m_levels.size(); ++l)
+					{
+						canvas& above = m_levels[l - 1];
+						canvas& below = m_levels[l];
+						const int fx = above.get_width() == below.get_width() ? 1 : 2;
+						const int fy = above.get_height() == below.get_height() ? 1 : 2;
+						width /= fx;
+						height /= fy;
+						x /= fx;
+						y /= fy;
+						reduce_tile(&cur[0], width, height, fx, fy, &next[0]);
+						for(int r = 0; r < height; ++r)
+						{
+							store_row(&next[r * TileSize * 4], width, &line[0]);
+							below.write_row(&line[0], x, y + r, width);
+						}
+						cur.swap(next);
+					}
+				}
+			}
+		}
+
+	private:
+		void load_row(const core::rgba* src, int width, core::uint16* dst) const
+		{
+			const core::uint8* s = reinterpret_cast<const core::uint8*>(src);
+			if(m_srgb)
+			{
+				for(int i = 0; i < width * 4; i += 4)
+				{
+					dst[i+0] = m_srgb->to_linear16[s[i+0]];
+					dst[i+1] = m_srgb->to_linear16[s[i+1]];
+					dst[i+2] = m_srgb->to_linear16[s[i+2]];
+					dst[i+3] = s[i+3];
+				}
+			}
+			else
+			{
+				for(int i = 0; i < width * 4; ++i)
+					dst[i] = s[i];
+			}
+		}
+
+		void store_row(const core::uint16* src, int width, core::rgba* dst) const
+		{
+			core::uint8* d = reinterpret_cast<core::uint8*>(dst);
+			if(m_srgb)
+			{
+				for(int i = 0; i < width * 4; i += 4)
+				{
+					d[i+0] = linear16_to_srgb(*m_srgb, src[i+0]);
+					d[i+1] = linear16_to_srgb(*m_srgb, src[i+1]);
+					d[i+2] = linear16_to_srgb(*m_srgb, src[i+2]);
+					d[i+3] = static_cast<core::uint8>(src[i+3]);
+				}
+			}
+			else
+			{
+				for(int i = 0; i < width * 4; ++i)
+					d[i] = static_cast<core::uint8>(src[i]);
+			}
+		}
+
+	private:
+		std::vector<canvas> m_levels;
+		const srgb_tables* m_srgb;
+	};
+
+	void cascade_mips(image_base& img, int top, int last, bool srgb)
+	{
+		TYCHO_ASSERT(find_cascade_end(img, top, last) == last);
+		while(top < last)
+		{
+			const int bottom = std::min(top + TileLevels, last);
+			std::vector<canvas> levels(bottom - top + 1);
+			for(int m = top; m <= bottom; ++m)
+				img.get_mip_level(m, &levels[m - top]);
+			cascade_task task(levels, srgb);
+			parallel_rows(levels[0].get_height(), TileSize, task);
+			top = bottom;
+		}
+	}
+
+} // end namespace
+} // end namespace
+} // end namespace
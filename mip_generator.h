@@ -0,0 +1,48 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:40:28 PM
+//////////////////////////////////////////////////////////////////////////////
+#if _MSC_VER > 1000
+#pragma once
+#endif  // _MSC_VER
+
+#ifndef __MIP_GENERATOR_H_E2F7A9C4_58B1_4D36_9A0F_7C1D84B2E963_
+#define __MIP_GENERATOR_H_E2F7A9C4_58B1_4D36_9A0F_7C1D84B2E963_
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/image_abi.h"
+#include "image/forward_decls.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+// internal to the image library, used by build_mip_chain.
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	/// \returns the last mip level after top that can be made by cascading 2x2 box reductions,
+	/// each level must be exactly half the one above in each dimension or stay at 1. Returns
+	/// top if the level below it can't be.
+	int find_cascade_end(image_base& img, int top, int last);
+
+	/// Builds mip levels top+1 to last from level top with 2x2 box reductions. The top level is
+	/// processed in tiles and each tile is reduced through all the lower levels while it is in
+	/// cache so the top level is read once. The reduction is the same as a box filtered resize
+	/// of the level above except for formats narrower than 8 bits per channel where each level
+	/// is reduced from the unquantised values of the one above. sRGB images are reduced in 16 bit
+	/// linear light.
+	void cascade_mips(image_base& img, int top, int last, bool srgb);
+
+} // end namespace
+} // end namespace
+} // end namespace
+
+#endif // __MIP_GENERATOR_H_E2F7A9C4_58B1_4D36_9A0F_7C1D84B2E963_
@@ -0,0 +1,70 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Sunday, 18 October 2026 12:53:40 AM
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "mip_table.h"
+#include "core/memory.h"
+#include <algorithm>
+#include <climits>
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	int setup_mip_table(int width, int height, int num_mips, int block_size, int unit_bytes, int row_alignment, mip_table& mips)
+	{
+		mips.clear();
+		core::int64 total_size = 0;
+		for(int m = 0; m < num_mips; ++m)
+		{
+			// sizes are worked out in 64 bits, offsets and row bytes must fit an int
+			const core::int64 row_bytes = (core::int64)((width + block_size - 1) / block_size) * unit_bytes;
+			const core::int64 pitch = (row_bytes + row_alignment - 1) / row_alignment * row_alignment;
+			const int rows = (height + block_size - 1) / block_size;
+			if(total_size + pitch * rows > INT_MAX)
+				return -1;
+			mip_table_level mip;
+			mip.w = width;
+			mip.h = height;
+			mip.offset = (int)total_size;
+			mip.row_bytes = (int)row_bytes;
+			mip.pitch = (int)pitch;
+			mip.rows = rows;
+			mips.push_back(mip);
+			total_size += pitch * rows;
+			if(width == 1 && height == 1)
+				break;
+			width = width > 1 ? width >> 1 : 1;
+			height = height > 1 ? height >> 1 : 1;
+		}
+		return (int)total_size;
+	}
+
+	void copy_mip_overlap(const mip_table& src_mips, const core::uint8* src, const mip_table& dst_mips, core::uint8* dst)
+	{
+		const size_t num_levels = std::min(src_mips.size(), dst_mips.size());
+		for(size_t m = 0; m < num_levels; ++m)
+		{
+			const mip_table_level& s = src_mips[m];
+			const mip_table_level& d = dst_mips[m];
+			const int row_bytes = std::min(s.row_bytes, d.row_bytes);
+			const int rows = std::min(s.rows, d.rows);
+			for(int y = 0; y < rows; ++y)
+				core::mem_cpy(dst + d.offset + y * d.pitch, src + s.offset + y * s.pitch, row_bytes);
+		}
+	}
+
+} // end namespace
+} // end namespace
+} // end namespace
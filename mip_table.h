@@ -0,0 +1,58 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Sunday, 18 October 2026 12:53:40 AM
+//////////////////////////////////////////////////////////////////////////////
+#if _MSC_VER > 1000
+#pragma once
+#endif  // _MSC_VER
+
+#ifndef __MIP_TABLE_H_3F7C2D19_8A4E_4B61_A0D5_9E21C47B6F38_
+#define __MIP_TABLE_H_3F7C2D19_8A4E_4B61_A0D5_9E21C47B6F38_
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/image_abi.h"
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+// internal to the image library, the layout of the mip chain in an image's pixels.
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	/// A level of a mip chain in a pixel buffer. Rows hold units of block_size x block_size 
+	/// pixels, a single pixel for most formats and a compressed block for dxtn.
+	struct mip_table_level
+	{
+		int w, h;			///< size in pixels
+		int offset;			///< bytes from the start of the pixels to the first row
+		int row_bytes;		///< bytes of the units in a row
+		int pitch;			///< bytes between rows, at least row_bytes
+		int rows;			///< rows of units
+	};
+
+	typedef std::vector<mip_table_level> mip_table;
+
+	/// Fills the table with up to num_mips levels, each half the size of the one above rounded 
+	/// down to at least 1, stopping at 1x1. Rows are padded to a multiple of row_alignment bytes 
+	/// and the levels follow each other. \returns total size of the levels in bytes, or -1 if it 
+	/// is more than INT_MAX
+	int setup_mip_table(int width, int height, int num_mips, int block_size, int unit_bytes, int row_alignment, mip_table& mips);
+
+	/// copies the rows each level of two tables has in common from src to dst, the tables must 
+	/// have the same units and the buffers must not overlap
+	void copy_mip_overlap(const mip_table& src_mips, const core::uint8* src, const mip_table& dst_mips, core::uint8* dst);
+
+} // end namespace
+} // end namespace
+} // end namespace
+
+#endif // __MIP_TABLE_H_3F7C2D19_8A4E_4B61_A0D5_9E21C47B6F38_
@@ -0,0 +1,205 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Sunday, 18 October 2026 12:24:04 AM
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "pixel_allocator.h"
+#include "core/debug/assert.h"
+#include "core/memory/allocator.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+namespace tycho
+{
+namespace image
+{
+
+	/// Aligns buffers from core::allocator by allocating Alignment bytes extra, the pointer
+	/// core::allocator returned is kept just before the aligned buffer.
+	class default_pixel_allocator : public pixel_allocator
+	{
+	public:
+		virtual core::uint8* allocate(int num_bytes)
+		{
+			void* raw = core::allocator::malloc(num_bytes + Alignment);
+			if(!raw)
+				return 0;
+			const size_t aligned = (reinterpret_cast<size_t>(raw) + Alignment) & ~static_cast<size_t>(Alignment - 1);
+			reinterpret_cast<void**>(aligned)[-1] = raw;
+			return reinterpret_cast<core::uint8*>(aligned);
+		}
+
+		virtual void deallocate(core::uint8* pixels, int /*num_bytes*/)
+		{
+			if(pixels)
+				core::allocator::free(reinterpret_cast<void**>(pixels)[-1]);
+		}
+	};
+
+	pixel_allocator& get_default_pixel_allocator()
+	{
+		static default_pixel_allocator allocator;
+		return allocator;
+	}
+
+	pixel_pool::pixel_pool(int max_cached_bytes, pixel_allocator& backing) :
+		m_backing(backing),
+		m_max_cached_bytes(max_cached_bytes),
+		m_cached_bytes(0)
+	{}
+
+	pixel_pool::~pixel_pool()
+	{
+		trim();
+	}
+
+	int pixel_pool::get_bucket_size(int num_bytes)
+	{
+		if(num_bytes <= Alignment)
+			return Alignment;
+
+		// round up to a multiple of an eighth of the highest power of two below the size
+		int top = 0;
+		for(int n = num_bytes - 1; n > 1; n >>= 1)
+			++top;
+		const int step = top > 9 ? 1 << (top - 3) : Alignment;
+		return (num_bytes + step - 1) & ~(step - 1);
+	}
+
+	core::uint8* pixel_pool::allocate(int num_bytes)
+	{
+		const int size = get_bucket_size(num_bytes);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			bucket_map::iterator it = m_buckets.find(size);
+			if(it != m_buckets.end() && !it->second.empty())
+			{
+				core::uint8* pixels = it->second.back();
+				it->second.pop_back();
+				m_cached_bytes -= size;
+				return pixels;
+			}
+		}
+		return m_backing.allocate(size);
+	}
+
+	void pixel_pool::deallocate(core::uint8* pixels, int num_bytes)
+	{
+		if(!pixels)
+			return;
+		const int size = get_bucket_size(num_bytes);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if(m_cached_bytes + size <= m_max_cached_bytes)
+			{
+				m_buckets[size].push_back(pixels);
+				m_cached_bytes += size;
+				return;
+			}
+		}
+		m_backing.deallocate(pixels, size);
+	}
+
+	void pixel_pool::trim()
+	{
+		bucket_map buckets;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			buckets.swap(m_buckets);
+			m_cached_bytes = 0;
+		}
+		for(bucket_map::iterator it = buckets.begin(); it != buckets.end(); ++it)
+			for(size_t i = 0; i < it->second.size(); ++i)
+				m_backing.deallocate(it->second[i], it->first);
+	}
+
+	int pixel_pool::get_cached_bytes() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_cached_bytes;
+	}
+
+	pixel_arena::pixel_arena(int block_size, pixel_allocator& backing) :
+		m_backing(backing),
+		m_block_size(block_size),
+		m_current(0),
+		m_offset(0),
+		m_used(0)
+	{}
+
+	pixel_arena::~pixel_arena()
+	{
+		release();
+	}
+
+	core::uint8* pixel_arena::allocate(int num_bytes)
+	{
+		const int size = (num_bytes + Alignment - 1) & ~(Alignment - 1);
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// carve from the current block or the first kept block after it with room, the end of
+		// the blocks skipped over is unused until the next reset
+		for(; m_current < m_blocks.size(); ++m_current, m_offset = 0)
+		{
+			const block& b = m_blocks[m_current];
+			if(m_offset + size <= b.size)
+			{
+				core::uint8* pixels = b.pixels + m_offset;
+				m_offset += size;
+				m_used += size;
+				return pixels;
+			}
+		}
+		block b;
+		b.size = size > m_block_size ? size : m_block_size;
+		b.pixels = m_backing.allocate(b.size);
+		if(!b.pixels)
+			return 0;
+		m_blocks.push_back(b);
+		m_current = m_blocks.size() - 1;
+		m_offset = size;
+		m_used += size;
+		return b.pixels;
+	}
+
+	void pixel_arena::reset()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_current = 0;
+		m_offset = 0;
+		m_used = 0;
+	}
+
+	void pixel_arena::release()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for(size_t i = 0; i < m_blocks.size(); ++i)
+			m_backing.deallocate(m_blocks[i].pixels, m_blocks[i].size);
+		m_blocks.clear();
+		m_current = 0;
+		m_offset = 0;
+		m_used = 0;
+	}
+
+	int pixel_arena::get_used_bytes() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_used;
+	}
+
+	int pixel_arena::get_reserved_bytes() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		int total = 0;
+		for(size_t i = 0; i < m_blocks.size(); ++i)
+			total += m_blocks[i].size;
+		return total;
+	}
+
+} // end namespace
+} // end namespace
@@ -0,0 +1,236 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Sunday, 18 October 2026 12:24:04 AM
+//////////////////////////////////////////////////////////////////////////////
+#if _MSC_VER > 1000
+#pragma once
+#endif  // _MSC_VER
+
+#ifndef __PIXEL_ALLOCATOR_H_D4A27F61_83C9_4B0E_9F52_6E1B0C3A7D98_
+#define __PIXEL_ALLOCATOR_H_D4A27F61_83C9_4B0E_9F52_6E1B0C3A7D98_
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/image_abi.h"
+#include <algorithm>
+#include <map>
+#include <new>
+#include <mutex>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+namespace tycho
+{
+namespace image
+{
+
+	/// Allocates the pixel storage of images. Buffers are aligned to Alignment bytes so rows
+	/// starting on an aligned offset can be read with aligned vector loads.
+	class IMAGE_ABI pixel_allocator
+	{
+	public:
+		/// alignment in bytes of every buffer
+		static const int Alignment = 64;
+
+	public:
+		/// destructor
+		virtual ~pixel_allocator() {}
+
+		/// \returns a buffer of at least num_bytes aligned to Alignment bytes, 0 on failure
+		virtual core::uint8* allocate(int num_bytes) = 0;
+
+		/// frees a buffer returned by allocate, num_bytes is the size it was allocated with
+		virtual void deallocate(core::uint8* pixels, int num_bytes) = 0;
+	};
+
+	/// \returns the allocator images use unless given another, aligned buffers from core::allocator
+	IMAGE_ABI pixel_allocator& get_default_pixel_allocator();
+
+	/// Keeps freed buffers to hand back out to later allocations of a similar size instead of
+	/// returning them to the allocator behind it. Sizes are rounded up to buckets of 8 per power
+	/// of two so an allocation wastes at most an eighth of its size. Buffers held by the pool
+	/// are capped, past that freed buffers go straight back. The pool may be shared between
+	/// threads and must outlive every image allocated from it.
+	class IMAGE_ABI pixel_pool : public pixel_allocator
+	{
+	public:
+		/// constructor, max_cached_bytes caps the size of the freed buffers kept
+		pixel_pool(int max_cached_bytes = 64 * 1024 * 1024, pixel_allocator& backing = get_default_pixel_allocator());
+
+		/// destructor, returns every kept buffer
+		~pixel_pool();
+
+		/// \name pixel_allocator interface
+		//@{
+		virtual core::uint8* allocate(int num_bytes);
+		virtual void deallocate(core::uint8* pixels, int num_bytes);
+		//@}
+
+		/// returns every kept buffer to the allocator behind the pool
+		void trim();
+
+		/// \returns bytes held in kept buffers
+		int get_cached_bytes() const;
+
+		/// \returns the size an allocation of num_bytes is rounded up to
+		static int get_bucket_size(int num_bytes);
+
+	private:
+		/// non-copyable
+		pixel_pool(const pixel_pool&);
+		void operator=(const pixel_pool&);
+
+	private:
+		typedef std::map<int, std::vector<core::uint8*> > bucket_map;
+
+		pixel_allocator& m_backing;
+		const int m_max_cached_bytes;
+		int m_cached_bytes;
+		bucket_map m_buckets;
+		mutable std::mutex m_mutex;
+	};
+
+	/// Bump allocator for temporaries, allocations are carved from large blocks and freeing them
+	/// does nothing, everything is released at once by reset. Blocks are kept across resets so an
+	/// arena reused every frame stops allocating once it has grown to fit. Image operations and
+	/// codecs take an optional arena for their line buffers and other temporaries, an image 
+	/// given one as its allocator must not outlive the next reset. Allocation is thread safe so
+	/// the worker threads of an operation can share the arena of the thread calling it.
+	class IMAGE_ABI pixel_arena : public pixel_allocator
+	{
+	public:
+		/// constructor, blocks are block_size bytes unless an allocation needs more
+		pixel_arena(int block_size = 256 * 1024, pixel_allocator& backing = get_default_pixel_allocator());
+
+		/// destructor, releases the blocks
+		~pixel_arena();
+
+		/// \name pixel_allocator interface
+		//@{
+		virtual core::uint8* allocate(int num_bytes);
+		virtual void deallocate(core::uint8* /*pixels*/, int /*num_bytes*/) {}
+		//@}
+
+		/// frees every allocation, the blocks are kept for reuse
+		void reset();
+
+		/// frees every allocation and returns the blocks to the allocator behind the arena
+		void release();
+
+		/// \returns bytes allocated since the last reset
+		int get_used_bytes() const;
+
+		/// \returns bytes held in blocks
+		int get_reserved_bytes() const;
+
+	private:
+		/// non-copyable
+		pixel_arena(const pixel_arena&);
+		void operator=(const pixel_arena&);
+
+	private:
+		struct block
+		{
+			core::uint8* pixels;
+			int size;
+		};
+
+		pixel_allocator& m_backing;
+		const int m_block_size;
+		std::vector<block> m_blocks;
+		size_t m_current;	///< block allocations are being carved from
+		int m_offset;		///< bytes used in the current block
+		int m_used;
+		mutable std::mutex m_mutex;
+	};
+
+namespace detail
+{
+
+	/// Array of temporaries drawn from an arena, or from the default allocator without one, with
+	/// every element starting as value. Only for types that need no destructor.
+	template<class T>
+	class temp_buffer
+	{
+	public:
+		/// constructor, empty until resized
+		explicit temp_buffer(pixel_arena* arena) :
+			m_allocator(arena ? static_cast<pixel_allocator*>(arena) : &get_default_pixel_allocator()),
+			m_data(0),
+			m_count(0)
+		{}
+
+		/// constructor
+		temp_buffer(int count, pixel_arena* arena, const T& value = T()) :
+			m_allocator(arena ? static_cast<pixel_allocator*>(arena) : &get_default_pixel_allocator()),
+			m_data(0),
+			m_count(0)
+		{
+			resize(count, value);
+		}
+
+		/// destructor
+		~temp_buffer()
+		{
+			free();
+		}
+
+		/// replaces the elements with count copies of value
+		void resize(int count, const T& value = T())
+		{
+			free();
+			m_data = reinterpret_cast<T*>(m_allocator->allocate(count * static_cast<int>(sizeof(T))));
+			m_count = count;
+			for(int i = 0; i < count; ++i)
+				new(m_data + i) T(value);
+		}
+
+		/// swaps the elements of two buffers from the same allocator
+		void swap(temp_buffer& other)
+		{
+			std::swap(m_data, other.m_data);
+			std::swap(m_count, other.m_count);
+		}
+
+		/// \returns the i'th element
+		T& operator[](int i)
+			{ return m_data[i]; }
+
+		/// \returns the i'th element, const version
+		const T& operator[](int i) const
+			{ return m_data[i]; }
+
+		/// \returns number of elements
+		int size() const
+			{ return m_count; }
+
+	private:
+		/// non-copyable
+		temp_buffer(const temp_buffer&);
+		void operator=(const temp_buffer&);
+
+		void free()
+		{
+			if(m_data)
+				m_allocator->deallocate(reinterpret_cast<core::uint8*>(m_data), m_count * static_cast<int>(sizeof(T)));
+			m_data = 0;
+			m_count = 0;
+		}
+
+	private:
+		pixel_allocator* m_allocator;
+		T* m_data;
+		int m_count;
+	};
+
+} // end namespace
+
+} // end namespace
+} // end namespace
+
+#endif // __PIXEL_ALLOCATOR_H_D4A27F61_83C9_4B0E_9F52_6E1B0C3A7D98_
@@ -0,0 +1,140 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:25:31 PM
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "pixel_convert.h"
+#include "pixel_convert_impl.h"
+#include "core/debug/assert.h"
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	/// fills row Src of the converter table with converters to every destination layout
+	template<int Src, int Dst>
+	struct fill_converters
+	{
+		static void apply(convert_row_fn* row)
+		{
+			row[Dst] = &convert_row<typename predefined_layout<Src>::traits, typename predefined_layout<Dst>::traits>;
+			fill_converters<Src, Dst - 1>::apply(row);
+		}
+	};
+
+	template<int Src>
+	struct fill_converters<Src, -1>
+	{
+		static void apply(convert_row_fn*) {}
+	};
+
+	/// fills the whole converter table
+	template<int Src>
+	struct fill_table
+	{
+		static void apply(convert_row_fn (*table)[NumPredefinedLayouts], image_format* formats, int* bpps, const image_rgba::pixel_layout** layouts)
+		{
+			typedef typename predefined_layout<Src>::traits traits;
+			const image_rgba::pixel_layout& pl = predefined_layout<Src>::layout();
+			const image_rgba::pixel_layout expected = { traits::rshift, traits::rmask, traits::gshift, traits::gmask,
+														traits::bshift, traits::bmask, traits::ashift, traits::amask };
+			TYCHO_ASSERT(pl == expected);
+			formats[Src] = predefined_layout<Src>::format();
+			bpps[Src] = traits::bytes_per_pixel;
+			layouts[Src] = &pl;
+			fill_converters<Src, NumPredefinedLayouts - 1>::apply(table[Src]);
+			fill_table<Src - 1>::apply(table, formats, bpps, layouts);
+		}
+	};
+
+	template<>
+	struct fill_table<-1>
+	{
+		static void apply(convert_row_fn (*)[NumPredefinedLayouts], image_format*, int*, const image_rgba::pixel_layout**) {}
+	};
+
+	/// registry of converters between every pair of predefined layouts
+	class converter_registry
+	{
+	public:
+		converter_registry()
+		{
+			fill_table<NumPredefinedLayouts - 1>::apply(m_table, m_formats, m_bpps, m_layouts);
+			memcpy(m_portable, m_table, sizeof(m_table));
+			install_sse_converters(m_table);
+		}
+
+		/// \returns index of the predefined layout the image uses or -1 if it is custom
+		int find(const image_rgba& img) const
+		{
+			const image_format fmt = img.get_image_format();
+			const image_rgba::pixel_layout& pl = img.get_pixel_layout();
+			for(int i = 0; i < NumPredefinedLayouts; ++i)
+			{
+				if(m_formats[i] == fmt && m_bpps[i] == img.get_bytes_per_pixel() && *m_layouts[i] == pl)
+					return i;
+			}
+			return -1;
+		}
+
+		convert_row_fn get(int src, int dst) const
+			{ return m_table[src][dst]; }
+
+		convert_row_fn get_portable(int src, int dst) const
+			{ return m_portable[src][dst]; }
+
+	private:
+		convert_row_fn m_table[NumPredefinedLayouts][NumPredefinedLayouts];
+		convert_row_fn m_portable[NumPredefinedLayouts][NumPredefinedLayouts];	///< the table before the SSE converters go in
+		image_format m_formats[NumPredefinedLayouts];
+		int m_bpps[NumPredefinedLayouts];
+		const image_rgba::pixel_layout* m_layouts[NumPredefinedLayouts];
+	};
+
+	static const converter_registry& get_converter_registry()
+	{
+		static converter_registry registry;
+		return registry;
+	}
+
+} // end namespace
+
+	/// \returns a row converter specialised for the layouts of the two images or 0 if there is none
+	IMAGE_ABI convert_row_fn find_row_converter(const image_rgba& src, const image_rgba& dst)
+	{
+		const detail::converter_registry& registry = detail::get_converter_registry();
+		int src_index = registry.find(src);
+		if(src_index < 0)
+			return 0;
+		int dst_index = registry.find(dst);
+		if(dst_index < 0)
+			return 0;
+		return registry.get(src_index, dst_index);
+	}
+
+	/// \returns the portable converter for the layouts of the two images or 0 if there is none
+	IMAGE_ABI convert_row_fn find_portable_row_converter(const image_rgba& src, const image_rgba& dst)
+	{
+		const detail::converter_registry& registry = detail::get_converter_registry();
+		int src_index = registry.find(src);
+		if(src_index < 0)
+			return 0;
+		int dst_index = registry.find(dst);
+		if(dst_index < 0)
+			return 0;
+		return registry.get_portable(src_index, dst_index);
+	}
+
+} // end namespace
+} // end namespace
@@ -0,0 +1,88 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:25:31 PM
+//////////////////////////////////////////////////////////////////////////////
+#if _MSC_VER > 1000
+#pragma once
+#endif  // _MSC_VER
+
+#ifndef __PIXEL_CONVERT_H_0EBDF86F_225A_4565_A864_24CA21B1C5E0_
+#define __PIXEL_CONVERT_H_0EBDF86F_225A_4565_A864_24CA21B1C5E0_
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/image_abi.h"
+#include "image/image_rgba.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+	/// pixels are stored most significant byte first regardless of platform
+	template<int BytesPerPixel> 
+	struct packed_pixel;
+	
+	template<> 
+	struct packed_pixel<1>
+	{
+		static core::uint32 load(const core::uint8* p)	
+			{ return p[0]; }
+		static void store(core::uint8* p, core::uint32 v)	
+			{ p[0] = (core::uint8)v; }
+	};
+
+	template<> 
+	struct packed_pixel<2>
+	{
+		static core::uint32 load(const core::uint8* p)	
+			{ return (p[0] << 8) | p[1]; }
+		static void store(core::uint8* p, core::uint32 v)	
+			{ p[0] = (core::uint8)(v >> 8); p[1] = (core::uint8)v; }
+	};
+
+	template<> 
+	struct packed_pixel<3>
+	{
+		static core::uint32 load(const core::uint8* p)	
+			{ return (p[0] << 16) | (p[1] << 8) | p[2]; }
+		static void store(core::uint8* p, core::uint32 v)	
+			{ p[0] = (core::uint8)(v >> 16); p[1] = (core::uint8)(v >> 8); p[2] = (core::uint8)v; }
+	};
+
+	template<> 
+	struct packed_pixel<4>
+	{
+		static core::uint32 load(const core::uint8* p)	
+			{ return ((core::uint32)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+		static void store(core::uint8* p, core::uint32 v)	
+			{ p[0] = (core::uint8)(v >> 24); p[1] = (core::uint8)(v >> 16); p[2] = (core::uint8)(v >> 8); p[3] = (core::uint8)v; }
+	};
+		
+} // end namespace
+
+	/// converts width pixels from the source row to the destination row, both rows are raw pixel
+	/// bytes in the layouts the converter was looked up for.
+	typedef void (*convert_row_fn)(const core::uint8* src, core::uint8* dst, int width);
+
+	/// \returns a row converter specialised at compile time for the layouts of the two images,
+	/// or 0 if either image uses a custom layout in which case callers should fall back to
+	/// \ref image_base::read_row and \ref image_base::write_row. The converters produce exactly
+	/// the same results as the generic path.
+	IMAGE_ABI convert_row_fn find_row_converter(const image_rgba& src, const image_rgba& dst);
+
+	/// \returns the converter \ref find_row_converter returns on a cpu without SSE, so the SSE
+	/// converters can be checked against it.
+	IMAGE_ABI convert_row_fn find_portable_row_converter(const image_rgba& src, const image_rgba& dst);
+
+} // end namespace
+} // end namespace
+
+#endif // __PIXEL_CONVERT_H_0EBDF86F_225A_4565_A864_24CA21B1C5E0_
@@ -0,0 +1,102 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:28:35 PM
+//////////////////////////////////////////////////////////////////////////////
+#if _MSC_VER > 1000
+#pragma once
+#endif  // _MSC_VER
+
+#ifndef __PIXEL_CONVERT_IMPL_H_4218A13C_DBE6_4D19_8A50_F70D4C16921A_
+#define __PIXEL_CONVERT_IMPL_H_4218A13C_DBE6_4D19_8A50_F70D4C16921A_
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/pixel_convert.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+// internal to the image library, shared between the scalar and sse converters.
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	/// compile time description of a pixel layout, mirrors image_rgba::pixel_layout. Missing
+	/// is the value a channel reads as when its mask is 0 so we match the per format get_pixel.
+	template<int BytesPerPixel,
+			 int RShift, int RMask, int GShift, int GMask,
+			 int BShift, int BMask, int AShift, int AMask,
+			 int Missing = 255>
+	struct layout_traits
+	{
+		static const int bytes_per_pixel = BytesPerPixel;
+		static const int rshift = RShift, rmask = RMask;
+		static const int gshift = GShift, gmask = GMask;
+		static const int bshift = BShift, bmask = BMask;
+		static const int ashift = AShift, amask = AMask;
+		static const int missing = Missing;
+	};
+
+	/// converts a row between two compile time layouts, all the shifts and masks are constants
+	/// so the compiler reduces this to a handful of byte moves per pixel.
+	template<class Src, class Dst>
+	void convert_row(const core::uint8* src, core::uint8* dst, int width)
+	{
+		const core::uint8* end = src + width * Src::bytes_per_pixel;
+		for(; src != end; src += Src::bytes_per_pixel, dst += Dst::bytes_per_pixel)
+		{
+			core::uint32 s = packed_pixel<Src::bytes_per_pixel>::load(src);
+			core::uint32 r = Src::rmask ? (s >> Src::rshift) & Src::rmask : Src::missing;
+			core::uint32 g = Src::gmask ? (s >> Src::gshift) & Src::gmask : Src::missing;
+			core::uint32 b = Src::bmask ? (s >> Src::bshift) & Src::bmask : Src::missing;
+			core::uint32 a = Src::amask ? (s >> Src::ashift) & Src::amask : Src::missing;
+			core::uint32 d = ((r & Dst::rmask) << Dst::rshift) |
+							 ((g & Dst::gmask) << Dst::gshift) |
+							 ((b & Dst::bmask) << Dst::bshift) |
+							 ((a & Dst::amask) << Dst::ashift);
+			packed_pixel<Dst::bytes_per_pixel>::store(dst, d);
+		}
+	}
+
+	/// the predefined layouts with the image format they are used with, these must match the
+	/// pixel_layout_* definitions in image_rgba.cpp which is checked when the table is built.
+	template<int Index> struct predefined_layout;
+
+#define TYCHO_PREDEFINED_LAYOUT(_index, _format, _name, _bpp, _missing, _rs, _rm, _gs, _gm, _bs, _bm, _as, _am) \
+	template<> struct predefined_layout<_index> \
+	{ \
+		typedef layout_traits<_bpp, _rs, _rm, _gs, _gm, _bs, _bm, _as, _am, _missing> traits; \
+		static image_format format() { return _format; } \
+		static const image_rgba::pixel_layout& layout() { return image_rgba::_name; } \
+	};
+
+	TYCHO_PREDEFINED_LAYOUT(0, image_format_rgba32, pixel_layout_rgba8888, 4, 255, 24, 0xff, 16, 0xff,  8, 0xff,  0, 0xff)
+	TYCHO_PREDEFINED_LAYOUT(1, image_format_rgba32, pixel_layout_bgra8888, 4, 255,  8, 0xff, 16, 0xff, 24, 0xff,  0, 0xff)
+	TYCHO_PREDEFINED_LAYOUT(2, image_format_rgba32, pixel_layout_bgrx8888, 4, 255,  8, 0xff, 16, 0xff, 24, 0xff,  0, 0)
+	TYCHO_PREDEFINED_LAYOUT(3, image_format_rgba24, pixel_layout_rgb888,   3, 255, 16, 0xff,  8, 0xff,  0, 0xff,  0, 0)
+	TYCHO_PREDEFINED_LAYOUT(4, image_format_rgba24, pixel_layout_bgr888,   3, 255,  0, 0xff,  8, 0xff, 16, 0xff,  0, 0)
+	TYCHO_PREDEFINED_LAYOUT(5, image_format_rgba16, pixel_layout_argb4444, 2, 255,  8, 0xf,   4, 0xf,   0, 0xf,  12, 0xf)
+	TYCHO_PREDEFINED_LAYOUT(6, image_format_rgba16, pixel_layout_argb1555, 2, 255, 10, 0x1f,  5, 0x1f,  0, 0x1f, 15, 0x1)
+	TYCHO_PREDEFINED_LAYOUT(7, image_format_rgba16, pixel_layout_rgb565,   2, 255, 11, 0x1f,  5, 0x3f,  0, 0x1f,  0, 0)
+	TYCHO_PREDEFINED_LAYOUT(8, image_format_rgba16, pixel_layout_bgr565,   2, 255,  0, 0x1f,  5, 0x3f, 11, 0x1f,  0, 0)
+	TYCHO_PREDEFINED_LAYOUT(9, image_format_a8,     pixel_layout_a8,       1, 0,    0, 0,     0, 0,     0, 0,     0, 0xff)
+
+#undef TYCHO_PREDEFINED_LAYOUT
+
+	static const int NumPredefinedLayouts = 10;
+
+	/// overrides entries in the converter table with SSE versions where the cpu supports them,
+	/// does nothing on platforms without SSE.
+	void install_sse_converters(convert_row_fn (*table)[NumPredefinedLayouts]);
+
+} // end namespace
+} // end namespace
+} // end namespace
+
+#endif // __PIXEL_CONVERT_IMPL_H_4218A13C_DBE6_4D19_8A50_F70D4C16921A_
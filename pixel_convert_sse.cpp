@@ -0,0 +1,293 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:28:35 PM
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "pixel_convert_impl.h"
+#include "cpu_features.h"
+#include "core/memory.h"
+
+#if TYCHO_IMAGE_SSE
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+#if TYCHO_IMAGE_SSE
+
+	/// reverses the bytes in each 16 bit lane, pixels are stored most significant byte first
+	TYCHO_IMAGE_TARGET("sse2") inline __m128i bswap16(__m128i v)
+	{
+		return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+	}
+
+	/// reverses the bytes in each 32 bit lane
+	TYCHO_IMAGE_TARGET("sse2") inline __m128i bswap32(__m128i v)
+	{
+		v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+		return bswap16(v);
+	}
+
+	/// converts a single channel of 4 packed pixels, the vector version of the scalar convert_row
+	template<int SShift, int SMask, int DShift, int DMask, int Missing>
+	TYCHO_IMAGE_TARGET("sse2") inline __m128i convert_channel(__m128i s)
+	{
+		if(DMask == 0)
+			return _mm_setzero_si128();
+		if(SMask == 0)
+			return _mm_set1_epi32((int)((core::uint32)(Missing & DMask) << DShift));
+		return _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(s, SShift), _mm_set1_epi32(SMask & DMask)), DShift);
+	}
+
+	/// converts 4 packed pixels held in 32 bit lanes from one layout to another
+	template<class Src, class Dst>
+	TYCHO_IMAGE_TARGET("sse2") inline __m128i convert_lanes(__m128i s)
+	{
+		__m128i r = convert_channel<Src::rshift, Src::rmask, Dst::rshift, Dst::rmask, Src::missing>(s);
+		__m128i g = convert_channel<Src::gshift, Src::gmask, Dst::gshift, Dst::gmask, Src::missing>(s);
+		__m128i b = convert_channel<Src::bshift, Src::bmask, Dst::bshift, Dst::bmask, Src::missing>(s);
+		__m128i a = convert_channel<Src::ashift, Src::amask, Dst::ashift, Dst::amask, Src::missing>(s);
+		return _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, a));
+	}
+
+	/// loads and stores 8 pixels as two vectors of packed pixels in 32 bit lanes
+	template<int BytesPerPixel>
+	struct lane_io;
+
+	template<>
+	struct lane_io<2>
+	{
+		TYCHO_IMAGE_TARGET("sse2") static void load(const core::uint8* p, __m128i& lo, __m128i& hi)
+		{
+			__m128i v = bswap16(_mm_loadu_si128((const __m128i*)p));
+			lo = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+			hi = _mm_unpackhi_epi16(v, _mm_setzero_si128());
+		}
+
+		TYCHO_IMAGE_TARGET("sse2") static void store(core::uint8* p, __m128i lo, __m128i hi)
+		{
+			// sign extend the low 16 bits so the saturating pack passes them through untouched
+			lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+			hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+			_mm_storeu_si128((__m128i*)p, bswap16(_mm_packs_epi32(lo, hi)));
+		}
+	};
+
+	template<>
+	struct lane_io<4>
+	{
+		TYCHO_IMAGE_TARGET("sse2") static void load(const core::uint8* p, __m128i& lo, __m128i& hi)
+		{
+			lo = bswap32(_mm_loadu_si128((const __m128i*)p));
+			hi = bswap32(_mm_loadu_si128((const __m128i*)(p + 16)));
+		}
+
+		TYCHO_IMAGE_TARGET("sse2") static void store(core::uint8* p, __m128i lo, __m128i hi)
+		{
+			_mm_storeu_si128((__m128i*)p, bswap32(lo));
+			_mm_storeu_si128((__m128i*)(p + 16), bswap32(hi));
+		}
+	};
+
+	/// SSE2 converter between 16 and 32 bit layouts, 8 pixels at a time
+	template<class Src, class Dst>
+	TYCHO_IMAGE_TARGET("sse2") void convert_row_sse2(const core::uint8* src, core::uint8* dst, int width)
+	{
+		int i = 0;
+		for(; i + 8 <= width; i += 8, src += 8 * Src::bytes_per_pixel, dst += 8 * Dst::bytes_per_pixel)
+		{
+			__m128i lo, hi;
+			lane_io<Src::bytes_per_pixel>::load(src, lo, hi);
+			lane_io<Dst::bytes_per_pixel>::store(dst, convert_lanes<Src, Dst>(lo), convert_lanes<Src, Dst>(hi));
+		}
+		convert_row<Src, Dst>(src, dst, width - i);
+	}
+
+	/// builds the pshufb control and fill constant that move the bytes of 4 pixels between two
+	/// layouts with 8 bit channels. Channels missing from the source are or'd in from fill.
+	template<class Src, class Dst>
+	void build_shuffle(core::uint8* control, core::uint8* fill)
+	{
+		const int sshift[4] = { Src::rshift, Src::gshift, Src::bshift, Src::ashift };
+		const int smask[4]  = { Src::rmask,  Src::gmask,  Src::bmask,  Src::amask };
+		const int dshift[4] = { Dst::rshift, Dst::gshift, Dst::bshift, Dst::ashift };
+		const int dmask[4]  = { Dst::rmask,  Dst::gmask,  Dst::bmask,  Dst::amask };
+		for(int i = 0; i < 16; ++i)
+		{
+			control[i] = 0x80;
+			fill[i] = 0;
+		}
+		for(int k = 0; k < 4; ++k)
+		{
+			for(int j = 0; j < Dst::bytes_per_pixel; ++j)
+			{
+				const int o = k * Dst::bytes_per_pixel + j;
+				const int shift = (Dst::bytes_per_pixel - 1 - j) * 8;
+				for(int c = 0; c < 4; ++c)
+				{
+					if(!dmask[c] || dshift[c] != shift)
+						continue;
+					if(smask[c])
+						control[o] = (core::uint8)(k * Src::bytes_per_pixel + Src::bytes_per_pixel - 1 - sshift[c] / 8);
+					else
+						fill[o] = (core::uint8)(Src::missing & dmask[c]);
+				}
+			}
+		}
+	}
+
+	/// SSSE3 converter between 24 and 32 bit layouts with 8 bit channels, 4 pixels at a time
+	template<class Src, class Dst>
+	TYCHO_IMAGE_TARGET("ssse3") void shuffle_row_ssse3(const core::uint8* src, core::uint8* dst, int width)
+	{
+		core::uint8 control_bytes[16], fill_bytes[16];
+		build_shuffle<Src, Dst>(control_bytes, fill_bytes);
+		const __m128i control = _mm_loadu_si128((const __m128i*)control_bytes);
+		const __m128i fill = _mm_loadu_si128((const __m128i*)fill_bytes);
+
+		// 24 bit sources load 16 bytes for 4 pixels so must stay 2 pixels clear of the end of the row
+		const int end = Src::bytes_per_pixel == 3 ? width - 2 : width;
+		int i = 0;
+		for(; i + 4 <= end; i += 4, src += 4 * Src::bytes_per_pixel, dst += 4 * Dst::bytes_per_pixel)
+		{
+			__m128i v = _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), control), fill);
+			if(Dst::bytes_per_pixel == 4)
+			{
+				_mm_storeu_si128((__m128i*)dst, v);
+			}
+			else
+			{
+				_mm_storel_epi64((__m128i*)dst, v);
+				int last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+				core::mem_cpy(dst + 8, &last, 4);
+			}
+		}
+		convert_row<Src, Dst>(src, dst, width - i);
+	}
+
+	/// layouts the SSE2 converter handles, 16 and 32 bit pixels
+	template<int Index>
+	struct sse2_layout
+	{
+		static const int bpp = predefined_layout<Index>::traits::bytes_per_pixel;
+		static const bool value = bpp == 2 || bpp == 4;
+	};
+
+	/// layouts the SSSE3 converter handles, 24 and 32 bit pixels with 8 bit channels
+	template<int Index>
+	struct ssse3_layout
+	{
+		typedef typename predefined_layout<Index>::traits traits;
+		static const bool value = (traits::bytes_per_pixel == 3 || traits::bytes_per_pixel == 4) &&
+								  (traits::rmask == 0xff || traits::rmask == 0) &&
+								  (traits::gmask == 0xff || traits::gmask == 0) &&
+								  (traits::bmask == 0xff || traits::bmask == 0) &&
+								  (traits::amask == 0xff || traits::amask == 0);
+	};
+
+	enum sse_kernel
+	{
+		sse_kernel_sse2,
+		sse_kernel_ssse3
+	};
+
+	/// true if the kernel handles the predefined layout
+	template<int Kernel, int Index>
+	struct kernel_supports;
+
+	template<int Index>
+	struct kernel_supports<sse_kernel_sse2, Index> : sse2_layout<Index> {};
+
+	template<int Index>
+	struct kernel_supports<sse_kernel_ssse3, Index> : ssse3_layout<Index> {};
+
+	/// sets a single table entry if the kernel supports both layouts
+	template<bool Enable, int Kernel, int Src, int Dst>
+	struct set_converter
+	{
+		static void apply(convert_row_fn (*)[NumPredefinedLayouts]) {}
+	};
+
+	template<int Src, int Dst>
+	struct set_converter<true, sse_kernel_sse2, Src, Dst>
+	{
+		static void apply(convert_row_fn (*table)[NumPredefinedLayouts])
+			{ table[Src][Dst] = &convert_row_sse2<typename predefined_layout<Src>::traits, typename predefined_layout<Dst>::traits>; }
+	};
+
+	template<int Src, int Dst>
+	struct set_converter<true, sse_kernel_ssse3, Src, Dst>
+	{
+		static void apply(convert_row_fn (*table)[NumPredefinedLayouts])
+			{ table[Src][Dst] = &shuffle_row_ssse3<typename predefined_layout<Src>::traits, typename predefined_layout<Dst>::traits>; }
+	};
+
+	/// installs the kernel for every supported destination of a source layout
+	template<int Kernel, int Src, int Dst>
+	struct install_row
+	{
+		static void apply(convert_row_fn (*table)[NumPredefinedLayouts])
+		{
+			set_converter<kernel_supports<Kernel, Src>::value && kernel_supports<Kernel, Dst>::value, Kernel, Src, Dst>::apply(table);
+			install_row<Kernel, Src, Dst - 1>::apply(table);
+		}
+	};
+
+	template<int Kernel, int Src>
+	struct install_row<Kernel, Src, -1>
+	{
+		static void apply(convert_row_fn (*)[NumPredefinedLayouts]) {}
+	};
+
+	/// installs the kernel for every supported pair of layouts
+	template<int Kernel, int Src>
+	struct install_table
+	{
+		static void apply(convert_row_fn (*table)[NumPredefinedLayouts])
+		{
+			install_row<Kernel, Src, NumPredefinedLayouts - 1>::apply(table);
+			install_table<Kernel, Src - 1>::apply(table);
+		}
+	};
+
+	template<int Kernel>
+	struct install_table<Kernel, -1>
+	{
+		static void apply(convert_row_fn (*)[NumPredefinedLayouts]) {}
+	};
+
+	void install_sse_converters(convert_row_fn (*table)[NumPredefinedLayouts])
+	{
+		const cpu_features& cpu = get_cpu_features();
+		if(cpu.sse2)
+			install_table<sse_kernel_sse2, NumPredefinedLayouts - 1>::apply(table);
+		
+		// pshufb beats the SSE2 shifts and masks for 32 bit swizzles so it goes second
+		if(cpu.ssse3)
+			install_table<sse_kernel_ssse3, NumPredefinedLayouts - 1>::apply(table);
+	}
+
+#else
+
+	void install_sse_converters(convert_row_fn (*)[NumPredefinedLayouts])
+	{
+	}
+
+#endif // TYCHO_IMAGE_SSE
+
+} // end namespace
+} // end namespace
+} // end namespace
@@ -0,0 +1,176 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Sunday, 18 October 2026 12:21:56 AM
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "png_filter.h"
+#include "cpu_features.h"
+#include "core/memory.h"
+
+#if TYCHO_IMAGE_SSE
+#include <emmintrin.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+	enum filter_type
+	{
+		filter_type_none,
+		filter_type_sub,
+		filter_type_up,
+		filter_type_avg,
+		filter_type_paeth
+	};
+
+	/// \returns the paeth predictor of a byte from its left, up and up left neighbours
+	static inline int paeth_predictor(int a, int b, int c)
+	{
+		const int p = a + b - c;
+		const int pa = p > a ? p - a : a - p;
+		const int pb = p > b ? p - b : b - p;
+		const int pc = p > c ? p - c : c - p;
+		if(pa <= pb && pa <= pc)
+			return a;
+		return pb <= pc ? b : c;
+	}
+
+	/// filters bytes [begin, end) of the row, \returns their sum as signed values
+	static int filter_bytes(int type, const core::uint8* row, const core::uint8* prev, int begin, int end, int bpp, core::uint8* out)
+	{
+		int sum = 0;
+		for(int i = begin; i < end; ++i)
+		{
+			const int left = i >= bpp ? row[i - bpp] : 0;
+			const int up_left = i >= bpp ? prev[i - bpp] : 0;
+			int predicted = 0;
+			switch(type)
+			{
+				case filter_type_sub : predicted = left; break;
+				case filter_type_up : predicted = prev[i]; break;
+				case filter_type_avg : predicted = (left + prev[i]) >> 1; break;
+				case filter_type_paeth : predicted = paeth_predictor(left, prev[i], up_left); break;
+				default : break;
+			}
+			const core::uint8 v = static_cast<core::uint8>(row[i] - predicted);
+			out[i] = v;
+			sum += v < 128 ? v : 256 - v;
+		}
+		return sum;
+	}
+
+#if TYCHO_IMAGE_SSE
+
+	/// paeth predictor of 8 bytes held in 16 bit lanes
+	TYCHO_IMAGE_TARGET("sse2") static inline __m128i paeth_predictor_sse2(__m128i a, __m128i b, __m128i c)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i pa = _mm_sub_epi16(b, c);
+		const __m128i pb = _mm_sub_epi16(a, c);
+		__m128i pc = _mm_add_epi16(pa, pb);
+		const __m128i abs_pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+		const __m128i abs_pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+		pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+		const __m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(abs_pa, abs_pb), _mm_cmpgt_epi16(abs_pa, pc));
+		const __m128i use_c = _mm_cmpgt_epi16(abs_pb, pc);
+		const __m128i bc = _mm_or_si128(_mm_and_si128(use_c, c), _mm_andnot_si128(use_c, b));
+		return _mm_or_si128(_mm_andnot_si128(not_a, a), _mm_and_si128(not_a, bc));
+	}
+
+	/// filters 16 bytes at a time, the first bpp bytes have no left neighbour and the tail is
+	/// shorter than a vector so both are left to the scalar code
+	TYCHO_IMAGE_TARGET("sse2") static int filter_bytes_sse2(int type, const core::uint8* row, const core::uint8* prev, int row_bytes, int bpp, core::uint8* out)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i one = _mm_set1_epi8(1);
+		int sum = filter_bytes(type, row, prev, 0, bpp < row_bytes ? bpp : row_bytes, bpp, out);
+		__m128i sums = zero;
+		int i = bpp;
+		for(; i + 16 <= row_bytes; i += 16)
+		{
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i - bpp));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i));
+			__m128i predicted = zero;
+			switch(type)
+			{
+				case filter_type_sub :
+					predicted = a;
+					break;
+				case filter_type_up :
+					predicted = b;
+					break;
+				case filter_type_avg :
+					// pavgb rounds up, take off the rounding bit to get the floor png uses
+					predicted = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+					break;
+				case filter_type_paeth :
+				{
+					const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i - bpp));
+					const __m128i lo = paeth_predictor_sse2(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+					const __m128i hi = paeth_predictor_sse2(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+					predicted = _mm_packus_epi16(lo, hi);
+					break;
+				}
+				default : break;
+			}
+			const __m128i v = _mm_sub_epi8(x, predicted);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+
+			// the smaller of v and 256 - v is the size of v as a signed byte
+			sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_min_epu8(v, _mm_sub_epi8(zero, v)), zero));
+		}
+		sum += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+		if(i < row_bytes)
+			sum += filter_bytes(type, row, prev, i, row_bytes, bpp, out);
+		return sum;
+	}
+
+#endif
+
+	int filter_png_row(int type, const core::uint8* row, const core::uint8* prev, int row_bytes, int bpp, core::uint8* out)
+	{
+		*out++ = static_cast<core::uint8>(type);
+#if TYCHO_IMAGE_SSE
+		if(get_cpu_features().sse2)
+			return filter_bytes_sse2(type, row, prev, row_bytes, bpp, out);
+#endif
+		return filter_bytes(type, row, prev, 0, row_bytes, bpp, out);
+	}
+
+	void filter_png_row_best(int type_mask, const core::uint8* row, const core::uint8* prev, int row_bytes, int bpp, core::uint8* out, core::uint8* scratch)
+	{
+		int best = -1;
+		for(int type = filter_type_none; type < PngFilterTypes; ++type)
+		{
+			if(!(type_mask & (1 << type)))
+				continue;
+			if(best < 0)
+			{
+				best = filter_png_row(type, row, prev, row_bytes, bpp, out);
+				continue;
+			}
+			const int sum = filter_png_row(type, row, prev, row_bytes, bpp, scratch);
+			if(sum < best)
+			{
+				best = sum;
+				core::mem_cpy(out, scratch, row_bytes + 1);
+			}
+		}
+		if(best < 0)
+			filter_png_row(filter_type_none, row, prev, row_bytes, bpp, out);
+	}
+
+} // end namespace
+} // end namespace
+} // end namespace
@@ -0,0 +1,52 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Sunday, 18 October 2026 12:21:56 AM
+//////////////////////////////////////////////////////////////////////////////
+#if _MSC_VER > 1000
+#pragma once
+#endif  // _MSC_VER
+
+#ifndef __PNG_FILTER_H_3E91C0A7_6D2B_4F85_9A1E_C47B2D8F05E3_
+#define __PNG_FILTER_H_3E91C0A7_6D2B_4F85_9A1E_C47B2D8F05E3_
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/image_abi.h"
+#include "core/types.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+// internal to the image library, the png row filters applied before rows are deflated. Filter 
+// types are the values written before each filtered row, 0 none, 1 sub, 2 up, 3 average and 
+// 4 paeth.
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	/// number of png filter types
+	static const int PngFilterTypes = 5;
+
+	/// Filters a row, prev is the unfiltered row above or zeros for the first row and bpp is
+	/// the bytes per pixel, at least 1. Writes the filter type followed by the filtered bytes 
+	/// to out. Uses SSE2 where the cpu has it and produces the same bytes as the scalar code.
+	/// \returns the sum of the filtered bytes as signed values, libpng's measure of how well 
+	/// the row will compress
+	int filter_png_row(int type, const core::uint8* row, const core::uint8* prev, int row_bytes, int bpp, core::uint8* out);
+
+	/// Filters a row with whichever of the filter types set in the mask, bit n for type n, 
+	/// gives the smallest sum. This is libpng's choice without the weighting towards previous 
+	/// rows. out and scratch hold row_bytes + 1 bytes.
+	void filter_png_row_best(int type_mask, const core::uint8* row, const core::uint8* prev, int row_bytes, int bpp, core::uint8* out, core::uint8* scratch);
+
+} // end namespace
+} // end namespace
+} // end namespace
+
+#endif // __PNG_FILTER_H_3E91C0A7_6D2B_4F85_9A1E_C47B2D8F05E3_
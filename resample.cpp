@@ -0,0 +1,576 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:30:48 PM
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "resample.h"
+#include "canvas.h"
+#include "cpu_features.h"
+#include "pixel_allocator.h"
+#include "srgb.h"
+#include "tile_scheduler.h"
+#include "core/debug/assert.h"
+#include <cmath>
+#include <string.h>
+
+#if TYCHO_IMAGE_SSE
+#include <emmintrin.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+	static const float Pi = 3.14159265358979f;
+
+	static float sinc(float x)
+	{
+		if(std::fabs(x) < 1e-6f)
+			return 1.0f;
+		x *= Pi;
+		return std::sin(x) / x;
+	}
+
+	/// zeroth order modified bessel function of the first kind, for the kaiser window
+	static float bessel_i0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		float half_x = x * 0.5f;
+		for(int k = 1; k < 32 && term > sum * 1e-8f; ++k)
+		{
+			term *= (half_x / k) * (half_x / k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	/// mitchell netravali cubic with B = C = 1/3
+	static float mitchell(float x)
+	{
+		const float B = 1.0f / 3.0f;
+		const float C = 1.0f / 3.0f;
+		x = std::fabs(x);
+		if(x < 1.0f)
+			return ((12 - 9*B - 6*C) * x*x*x + (-18 + 12*B + 6*C) * x*x + (6 - 2*B)) / 6.0f;
+		if(x < 2.0f)
+			return ((-B - 6*C) * x*x*x + (6*B + 30*C) * x*x + (-12*B - 48*C) * x + (8*B + 24*C)) / 6.0f;
+		return 0.0f;
+	}
+
+	float get_filter_support(filter_type filter)
+	{
+		switch(filter)
+		{
+			case filter_type_box	  : return 0.5f;
+			case filter_type_triangle : return 1.0f;
+			case filter_type_gaussian : return 1.5f;
+			case filter_type_mitchell : return 2.0f;
+			case filter_type_lanczos3 : return 3.0f;
+			case filter_type_kaiser   : return 3.0f;
+			default: break;
+		}
+		return 0.0f;
+	}
+
+	float evaluate_filter(filter_type filter, float x)
+	{
+		switch(filter)
+		{
+			case filter_type_box :
+				return (x >= -0.5f && x < 0.5f) ? 1.0f : 0.0f;
+
+			case filter_type_triangle :
+				x = std::fabs(x);
+				return x < 1.0f ? 1.0f - x : 0.0f;
+
+			case filter_type_gaussian :
+				return std::fabs(x) < 1.5f ? std::exp(-2.0f * x * x) : 0.0f;
+
+			case filter_type_mitchell :
+				return mitchell(x);
+
+			case filter_type_lanczos3 :
+				return std::fabs(x) < 3.0f ? sinc(x) * sinc(x / 3.0f) : 0.0f;
+
+			case filter_type_kaiser : {
+				const float alpha = 4.0f;
+				float t = x / 3.0f;
+				if(std::fabs(t) >= 1.0f)
+					return 0.0f;
+				return sinc(x) * bessel_i0(alpha * std::sqrt(1.0f - t * t)) / bessel_i0(alpha);
+			}
+
+			default: break;
+		}
+		return 0.0f;
+	}
+
+	resample_weights::resample_weights(filter_type filter, int src_size, int dst_size) :
+		m_max_taps(0),
+		m_first(dst_size),
+		m_count(dst_size)
+	{
+		TYCHO_ASSERT(src_size > 0 && dst_size > 0);
+
+		// when minifying the filter is stretched over the source so every source pixel contributes
+		const float scale = (float)src_size / dst_size;
+		const float filter_scale = scale > 1.0f ? scale : 1.0f;
+		const float support = get_filter_support(filter) * filter_scale;
+		m_max_taps = static_cast<int>(std::ceil(support * 2.0f)) + 1;
+		m_weights.resize(dst_size * m_max_taps);
+
+		for(int i = 0; i < dst_size; ++i)
+		{
+			// pixel centers are at +0.5, find the source pixels whose centers are under the filter
+			const float center = (i + 0.5f) * scale;
+			int first = static_cast<int>(std::ceil(center - support - 0.5f));
+			int last = static_cast<int>(std::floor(center + support - 0.5f));
+			if(first < 0)
+				first = 0;
+			if(last > src_size - 1)
+				last = src_size - 1;
+			if(last - first + 1 > m_max_taps)
+				last = first + m_max_taps - 1;
+
+			float* weights = &m_weights[i * m_max_taps];
+			float total = 0.0f;
+			int count = 0;
+			for(int j = first; j <= last; ++j, ++count)
+			{
+				weights[count] = evaluate_filter(filter, (j + 0.5f - center) / filter_scale);
+				total += weights[count];
+			}
+
+			// trim taps that don't contribute
+			while(count > 0 && weights[count - 1] == 0.0f)
+				--count;
+			while(count > 0 && weights[0] == 0.0f)
+			{
+				for(int j = 1; j < count; ++j)
+					weights[j-1] = weights[j];
+				--count;
+				++first;
+			}
+
+			if(count == 0 || total == 0.0f)
+			{
+				// filter fell between source pixels, take the nearest
+				first = static_cast<int>(center);
+				if(first > src_size - 1)
+					first = src_size - 1;
+				weights[0] = 1.0f;
+				count = 1;
+			}
+			else
+			{
+				// normalise so a flat source stays flat, this also handles the taps cut off at the edges
+				for(int j = 0; j < count; ++j)
+					weights[j] /= total;
+			}
+			m_first[i] = first;
+			m_count[i] = count;
+		}
+	}
+
+	/// filters one planar row horizontally, src holds 4 channels of src_width floats and
+	/// dst receives 4 channels of the destination width.
+	static void filter_row(const resample_weights& weights, const float* src, int src_width, float* dst)
+	{
+		const int dst_width = weights.get_dst_size();
+		for(int c = 0; c < 4; ++c, src += src_width, dst += dst_width)
+		{
+			for(int i = 0; i < dst_width; ++i)
+			{
+				const float* w = weights.get_weights(i);
+				const float* s = src + weights.get_first(i);
+				const int count = weights.get_count(i);
+				float sum = 0.0f;
+				for(int k = 0; k < count; ++k)
+					sum += w[k] * s[k];
+				dst[i] = sum;
+			}
+		}
+	}
+
+	/// filters a band of destination rows with float weights
+	class resample_float_task : public row_task
+	{
+	public:
+		resample_float_task(canvas& src, const region& src_region, canvas& dst, const region& dst_region, filter_type filter, bool srgb, pixel_arena* arena) :
+			m_src(src),
+			m_src_region(src_region),
+			m_dst(dst),
+			m_dst_region(dst_region),
+			m_horz(filter, src_region.width, dst_region.width),
+			m_vert(filter, src_region.height, dst_region.height),
+			m_srgb(srgb ? &get_srgb_tables() : 0),
+			m_arena(arena)
+		{}
+
+		virtual void run(int begin, int end)
+		{
+			// horizontally filtered source rows are kept in a window indexed by row modulo its size,
+			// the rows under the vertical filter are consecutive so they never collide.
+			const int window_size = m_vert.get_max_taps();
+			const int row_size = m_dst_region.width * 4;
+			temp_buffer<float> window(window_size * row_size, m_arena);
+			temp_buffer<int> window_rows(window_size, m_arena, -1);
+			temp_buffer<float> src_row(m_src_region.width * 4, m_arena);
+			temp_buffer<float> dst_row(row_size, m_arena);
+
+			for(int y = begin; y < end; ++y)
+			{
+				const int first = m_vert.get_first(y);
+				const int count = m_vert.get_count(y);
+				const float* w = m_vert.get_weights(y);
+
+				// bring the rows under the filter into the window
+				for(int k = 0; k < count; ++k)
+				{
+					const int sy = first + k;
+					const int slot = sy % window_size;
+					if(window_rows[slot] != sy)
+					{
+						m_src.read_row(m_src_region.x, m_src_region.y + sy, m_src_region.width, &src_row[0]);
+						if(m_srgb)
+							decode_srgb_row(&src_row[0], m_src_region.width);
+						filter_row(m_horz, &src_row[0], m_src_region.width, &window[slot * row_size]);
+						window_rows[slot] = sy;
+					}
+				}
+
+				// vertical pass
+				for(int i = 0; i < row_size; ++i)
+					dst_row[i] = 0.0f;
+				for(int k = 0; k < count; ++k)
+				{
+					const float* row = &window[((first + k) % window_size) * row_size];
+					const float wk = w[k];
+					for(int i = 0; i < row_size; ++i)
+						dst_row[i] += wk * row[i];
+				}
+				if(m_srgb)
+					encode_srgb_row(&dst_row[0], m_dst_region.width);
+				m_dst.write_row(&dst_row[0], m_dst_region.x, m_dst_region.y + y, m_dst_region.width);
+			}
+		}
+
+	private:
+		canvas& m_src;
+		const region m_src_region;
+		canvas& m_dst;
+		const region m_dst_region;
+		const resample_weights m_horz;
+		const resample_weights m_vert;
+		const srgb_tables* m_srgb;	///< filter in linear light if set
+		pixel_arena* m_arena;		///< row buffers come from here if set
+	
+		/// converts the colour channels of a planar row from sRGB to linear, alpha is already linear
+		void decode_srgb_row(float* row, int width) const
+		{
+			for(int i = 0; i < width * 3; ++i)
+				row[i] = m_srgb->to_linear[static_cast<int>(row[i])];
+		}
+		
+		void encode_srgb_row(float* row, int width) const
+		{
+			for(int i = 0; i < width * 3; ++i)
+				row[i] = linear_to_srgb(*m_srgb, row[i]);
+		}
+	};
+
+	/// weights are 14 bit fixed point, this leaves room for the negative lobes of the sinc filters
+	/// to push the central weight above one while still fitting in 16 bits for pmaddwd.
+	static const int FixedShift = 14;
+	static const int FixedOne = 1 << FixedShift;
+	static const int FixedHalf = 1 << (FixedShift - 1);
+
+	/// resample_weights quantised to fixed point. The taps for each pixel are padded with zero
+	/// weights to an even count so they can be consumed in pairs.
+	class fixed_weights
+	{
+	public:
+		explicit fixed_weights(const resample_weights& weights) :
+			m_max_taps((weights.get_max_taps() + 1) & ~1),
+			m_first(weights.get_dst_size()),
+			m_count(weights.get_dst_size()),
+			m_weights(weights.get_dst_size() * m_max_taps, 0)
+		{
+			for(int i = 0; i < weights.get_dst_size(); ++i)
+			{
+				const float* w = weights.get_weights(i);
+				const int count = weights.get_count(i);
+				core::int16* q = &m_weights[i * m_max_taps];
+				int total = 0;
+				int largest = 0;
+				for(int k = 0; k < count; ++k)
+				{
+					q[k] = static_cast<core::int16>(std::floor(w[k] * FixedOne + 0.5f));
+					total += q[k];
+					if(q[k] > q[largest])
+						largest = k;
+				}
+				
+				// put the rounding error on the largest tap so a flat source stays exactly flat
+				q[largest] = static_cast<core::int16>(q[largest] + FixedOne - total);
+				m_first[i] = weights.get_first(i);
+				m_count[i] = count;
+			}
+		}
+		
+		int get_first(int i) const
+			{ return m_first[i]; }
+		
+		int get_count(int i) const
+			{ return m_count[i]; }
+		
+		/// \returns get_count(i) weights followed by zeros up to get_max_taps()
+		const core::int16* get_weights(int i) const
+			{ return &m_weights[i * m_max_taps]; }
+		
+		/// \returns most taps used by any pixel, always even
+		int get_max_taps() const
+			{ return m_max_taps; }
+		
+		int get_dst_size() const
+			{ return static_cast<int>(m_first.size()); }
+		
+	private:
+		int m_max_taps;
+		std::vector<int> m_first;
+		std::vector<int> m_count;
+		std::vector<core::int16> m_weights;
+	};
+	
+	/// rounds a fixed point sum back to a channel value
+	inline core::uint8 round_fixed(int sum)
+	{
+		sum = (sum + FixedHalf) >> FixedShift;
+		return static_cast<core::uint8>(sum < 0 ? 0 : (sum > 255 ? 255 : sum));
+	}
+	
+	/// filters one row of 8 bit rgba horizontally
+	typedef void (*filter_row_fixed_fn)(const fixed_weights&, const core::uint8* src, core::uint8* dst);
+	
+	/// sums count rows weighted by w into dst, size is in bytes
+	typedef void (*accumulate_fixed_fn)(const core::uint8* const* rows, const core::int16* w, int count, core::uint8* dst, int size);
+
+	static void filter_row_fixed(const fixed_weights& weights, const core::uint8* src, core::uint8* dst)
+	{
+		for(int i = 0; i < weights.get_dst_size(); ++i, dst += 4)
+		{
+			const core::int16* w = weights.get_weights(i);
+			const core::uint8* s = src + weights.get_first(i) * 4;
+			const int count = weights.get_count(i);
+			int r = 0, g = 0, b = 0, a = 0;
+			for(int k = 0; k < count; ++k, s += 4)
+			{
+				r += w[k] * s[0];
+				g += w[k] * s[1];
+				b += w[k] * s[2];
+				a += w[k] * s[3];
+			}
+			dst[0] = round_fixed(r);
+			dst[1] = round_fixed(g);
+			dst[2] = round_fixed(b);
+			dst[3] = round_fixed(a);
+		}
+	}
+	
+	static void accumulate_fixed(const core::uint8* const* rows, const core::int16* w, int count, core::uint8* dst, int size)
+	{
+		for(int i = 0; i < size; ++i)
+		{
+			int sum = 0;
+			for(int k = 0; k < count; ++k)
+				sum += w[k] * rows[k][i];
+			dst[i] = round_fixed(sum);
+		}
+	}
+
+#if TYCHO_IMAGE_SSE
+
+	/// \returns taps k and k+1 in both halves of each 32 bit lane as pmaddwd expects them
+	TYCHO_IMAGE_TARGET("sse2") inline __m128i weight_pair(const core::int16* w)
+	{
+		core::int32 pair;
+		memcpy(&pair, w, sizeof(pair));
+		return _mm_set1_epi32(pair);
+	}
+
+	/// rounds four 32 bit sums per register and packs them to bytes with saturation
+	TYCHO_IMAGE_TARGET("sse2") inline __m128i round_fixed(__m128i s0, __m128i s1, __m128i s2, __m128i s3)
+	{
+		s0 = _mm_srai_epi32(s0, FixedShift);
+		s1 = _mm_srai_epi32(s1, FixedShift);
+		s2 = _mm_srai_epi32(s2, FixedShift);
+		s3 = _mm_srai_epi32(s3, FixedShift);
+		return _mm_packus_epi16(_mm_packs_epi32(s0, s1), _mm_packs_epi32(s2, s3));
+	}
+
+	/// one pixel per iteration, two taps at a time. The source row must have one pixel of 
+	/// padding after it for the zero weighted tap read when the count is odd.
+	TYCHO_IMAGE_TARGET("sse2") static void filter_row_fixed_sse2(const fixed_weights& weights, const core::uint8* src, core::uint8* dst)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i half = _mm_set1_epi32(FixedHalf);
+		for(int i = 0; i < weights.get_dst_size(); ++i, dst += 4)
+		{
+			const core::int16* w = weights.get_weights(i);
+			const core::uint8* s = src + weights.get_first(i) * 4;
+			const int count = weights.get_count(i);
+			__m128i sum = half;
+			for(int k = 0; k < count; k += 2, s += 8)
+			{
+				// r0 g0 b0 a0 r1 g1 b1 a1 -> r0 r1 g0 g1 b0 b1 a0 a1 widened to 16 bits
+				__m128i p = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(s));
+				p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(p, _mm_srli_si128(p, 4)), zero);
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(p, weight_pair(w + k)));
+			}
+			core::int32 v = _mm_cvtsi128_si32(round_fixed(sum, sum, sum, sum));
+			memcpy(dst, &v, sizeof(v));
+		}
+	}
+	
+	/// 16 bytes per iteration, interleaving pairs of rows so each pmaddwd applies two taps
+	TYCHO_IMAGE_TARGET("sse2") static void accumulate_fixed_sse2(const core::uint8* const* rows, const core::int16* w, int count, core::uint8* dst, int size)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i half = _mm_set1_epi32(FixedHalf);
+		int i = 0;
+		for(; i + 16 <= size; i += 16)
+		{
+			__m128i s0 = half, s1 = half, s2 = half, s3 = half;
+			for(int k = 0; k < count; k += 2)
+			{
+				// the padding weight is zero so an odd tap pairs with itself
+				const core::uint8* r0 = rows[k] + i;
+				const core::uint8* r1 = (k + 1 < count ? rows[k + 1] : rows[k]) + i;
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1));
+				const __m128i lo = _mm_unpacklo_epi8(a, b);
+				const __m128i hi = _mm_unpackhi_epi8(a, b);
+				const __m128i wk = weight_pair(w + k);
+				s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), wk));
+				s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), wk));
+				s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), wk));
+				s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), wk));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), round_fixed(s0, s1, s2, s3));
+		}
+		
+		// the sums are exact so the scalar tail gives identical results
+		if(i < size)
+		{
+			std::vector<const core::uint8*> tail(rows, rows + count);
+			for(int k = 0; k < count; ++k)
+				tail[k] += i;
+			accumulate_fixed(&tail[0], w, count, dst + i, size - i);
+		}
+	}
+
+#endif // TYCHO_IMAGE_SSE
+
+	/// same structure as resample_float_task but the rows are 8 bit rgba and all the arithmetic
+	/// is integer, rows are rounded back to 8 bits between the passes.
+	class resample_fixed_task : public row_task
+	{
+	public:
+		resample_fixed_task(canvas& src, const region& src_region, canvas& dst, const region& dst_region, filter_type filter, pixel_arena* arena) :
+			m_src(src),
+			m_src_region(src_region),
+			m_dst(dst),
+			m_dst_region(dst_region),
+			m_horz(resample_weights(filter, src_region.width, dst_region.width)),
+			m_vert(resample_weights(filter, src_region.height, dst_region.height)),
+			m_filter_fn(&filter_row_fixed),
+			m_accumulate_fn(&accumulate_fixed),
+			m_arena(arena)
+		{
+#if TYCHO_IMAGE_SSE
+			if(get_cpu_features().sse2)
+			{
+				m_filter_fn = &filter_row_fixed_sse2;
+				m_accumulate_fn = &accumulate_fixed_sse2;
+			}
+#endif
+		}
+
+		virtual void run(int begin, int end)
+		{
+			const int window_size = m_vert.get_max_taps();
+			const int row_size = m_dst_region.width * 4;
+			temp_buffer<core::uint8> window(window_size * row_size, m_arena);
+			temp_buffer<int> window_rows(window_size, m_arena, -1);
+			temp_buffer<const core::uint8*> rows(window_size, m_arena);
+			temp_buffer<core::rgba> src_row(m_src_region.width + 1, m_arena);
+			temp_buffer<core::rgba> dst_row(m_dst_region.width, m_arena);
+			src_row[m_src_region.width] = core::rgba(0, 0, 0, 0);
+			const core::uint8* src_bytes = reinterpret_cast<const core::uint8*>(&src_row[0]);
+			core::uint8* dst_bytes = reinterpret_cast<core::uint8*>(&dst_row[0]);
+
+			for(int y = begin; y < end; ++y)
+			{
+				const int first = m_vert.get_first(y);
+				const int count = m_vert.get_count(y);
+				for(int k = 0; k < count; ++k)
+				{
+					const int sy = first + k;
+					const int slot = sy % window_size;
+					if(window_rows[slot] != sy)
+					{
+						m_src.read_row(m_src_region.x, m_src_region.y + sy, m_src_region.width, &src_row[0]);
+						m_filter_fn(m_horz, src_bytes, &window[slot * row_size]);
+						window_rows[slot] = sy;
+					}
+					rows[k] = &window[slot * row_size];
+				}
+				m_accumulate_fn(&rows[0], m_vert.get_weights(y), count, dst_bytes, row_size);
+				m_dst.write_row(&dst_row[0], m_dst_region.x, m_dst_region.y + y, m_dst_region.width);
+			}
+		}
+
+	private:
+		canvas& m_src;
+		const region m_src_region;
+		canvas& m_dst;
+		const region m_dst_region;
+		const fixed_weights m_horz;
+		const fixed_weights m_vert;
+		filter_row_fixed_fn m_filter_fn;
+		accumulate_fixed_fn m_accumulate_fn;
+		pixel_arena* m_arena;
+	};
+	
+	void resample(canvas& src, const region& src_region, canvas& dst, const region& dst_region, filter_type filter, int flags, pixel_arena* arena)
+	{
+		// bands are filtered independently, each band recomputes the source rows it shares with its
+		// neighbours so keep them tall enough for that to be a small cost
+		// sRGB is always filtered in float, 8 bits isn't enough for linear light
+		const int grain = 16;
+		const bool srgb = (flags & resample_flag_srgb) != 0;
+		if((flags & resample_flag_fixed_point) && !srgb)
+		{
+			resample_fixed_task task(src, src_region, dst, dst_region, filter, arena);
+			parallel_rows(dst_region.height, grain, task);
+		}
+		else
+		{
+			resample_float_task task(src, src_region, dst, dst_region, filter, srgb, arena);
+			parallel_rows(dst_region.height, grain, task);
+		}
+	}
+
+} // end namespace
+} // end namespace
+} // end namespace
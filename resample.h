@@ -0,0 +1,92 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:30:48 PM
+//////////////////////////////////////////////////////////////////////////////
+#if _MSC_VER > 1000
+#pragma once
+#endif  // _MSC_VER
+
+#ifndef __RESAMPLE_H_331B66F8_F713_4EDC_A110_CC03481BCAFE_
+#define __RESAMPLE_H_331B66F8_F713_4EDC_A110_CC03481BCAFE_
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/image_abi.h"
+#include "image/image_functions.h"
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+// internal to the image library, used by image_functions.
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	/// \returns the radius of the filter in source pixels when not minifying
+	float get_filter_support(filter_type);
+
+	/// \returns the filter evaluated at distance x from its center
+	float evaluate_filter(filter_type, float x);
+
+	/// Filter taps along one axis. For each destination pixel this holds the first source pixel it
+	/// covers and the normalised weights of the consecutive source pixels from there, these are
+	/// computed once up front so the filter loops do no position or bounds calculations.
+	class resample_weights
+	{
+	public:
+		/// computes the taps for resampling src_size pixels into dst_size pixels
+		resample_weights(filter_type filter, int src_size, int dst_size);
+
+		/// \returns the first source pixel contributing to destination pixel i
+		int get_first(int i) const
+			{ return m_first[i]; }
+
+		/// \returns the number of source pixels contributing to destination pixel i
+		int get_count(int i) const
+			{ return m_count[i]; }
+
+		/// \returns the weights of the source pixels contributing to destination pixel i
+		const float* get_weights(int i) const
+			{ return &m_weights[i * m_max_taps]; }
+
+		/// \returns the most source pixels that contribute to any destination pixel
+		int get_max_taps() const
+			{ return m_max_taps; }
+
+		/// \returns number of destination pixels
+		int get_dst_size() const
+			{ return static_cast<int>(m_first.size()); }
+
+	private:
+		int m_max_taps;
+		std::vector<int> m_first;
+		std::vector<int> m_count;
+		std::vector<float> m_weights;
+	};
+
+	/// region of a canvas in pixels
+	struct region
+	{
+		int x, y, width, height;
+	};
+
+	/// separable resample of the source region into the destination region, filtering
+	/// horizontally into a window of rows then vertically out of it. The rows are floats
+	/// unless resample_flag_fixed_point is set in which case they are 8 bit rgba filtered
+	/// with 14 bit fixed point weights. With resample_flag_srgb the colour channels are decoded 
+	/// to linear light before filtering and encoded again after, always in float. Row buffers
+	/// come from the arena if there is one.
+	void resample(canvas& src, const region& src_region, canvas& dst, const region& dst_region, filter_type, int flags, pixel_arena* arena);
+
+} // end namespace
+} // end namespace
+} // end namespace
+
+#endif // __RESAMPLE_H_331B66F8_F713_4EDC_A110_CC03481BCAFE_
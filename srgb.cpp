@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:42:50 PM
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "srgb.h"
+#include <cmath>
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	/// sRGB transfer functions on [0, 1]
+	static double decode_srgb(double s)
+	{
+		return s <= 0.04045 ? s / 12.92 : std::pow((s + 0.055) / 1.055, 2.4);
+	}
+
+	static double encode_srgb(double l)
+	{
+		return l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+	}
+
+	static srgb_tables build_srgb_tables()
+	{
+		srgb_tables tables;
+		for(int i = 0; i < 256; ++i)
+		{
+			const double l = decode_srgb(i / 255.0);
+			tables.to_linear[i] = static_cast<float>(l * 255.0);
+			tables.to_linear16[i] = static_cast<core::uint16>(l * 65535.0 + 0.5);
+			tables.from_linear8[i] = static_cast<core::uint8>(encode_srgb(i / 255.0) * 255.0 + 0.5);
+		}
+		for(int i = 0; i < LinearSteps; ++i)
+			tables.from_linear[i] = static_cast<core::uint8>(encode_srgb(static_cast<double>(i) / (LinearSteps - 1)) * 255.0 + 0.5);
+		return tables;
+	}
+
+	const srgb_tables& get_srgb_tables()
+	{
+		static const srgb_tables tables = build_srgb_tables();
+		return tables;
+	}
+
+} // end namespace
+} // end namespace
+} // end namespace
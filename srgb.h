@@ -0,0 +1,64 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:42:50 PM
+//////////////////////////////////////////////////////////////////////////////
+#if _MSC_VER > 1000
+#pragma once
+#endif  // _MSC_VER
+
+#ifndef __SRGB_H_4A9E1C07_D2B3_4F8A_B61E_90C35F7D2A18_
+#define __SRGB_H_4A9E1C07_D2B3_4F8A_B61E_90C35F7D2A18_
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/image_abi.h"
+#include "core/types.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+// internal to the image library, table driven conversion between sRGB and linear light.
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	/// Linear values are looked up in a table of LinearSteps entries, this is fine enough that
+	/// every 8 bit sRGB value survives decoding and encoding again unchanged.
+	static const int LinearSteps = 4096;
+
+	/// lookup tables, built once on first use
+	struct srgb_tables
+	{
+		float to_linear[256];				///< sRGB to linear scaled to [0, 255]
+		core::uint16 to_linear16[256];		///< sRGB to linear scaled to [0, 65535]
+		core::uint8 from_linear[LinearSteps];	///< linear quantised to LinearSteps to sRGB
+		core::uint8 from_linear8[256];		///< 8 bit linear to sRGB
+	};
+
+	/// \returns the sRGB lookup tables
+	const srgb_tables& get_srgb_tables();
+
+	/// \returns sRGB encoding of linear value v in [0, 255], values outside are clamped
+	inline core::uint8 linear_to_srgb(const srgb_tables& tables, float v)
+	{
+		int i = static_cast<int>(v * ((LinearSteps - 1) / 255.0f) + 0.5f);
+		return tables.from_linear[i < 0 ? 0 : (i > LinearSteps - 1 ? LinearSteps - 1 : i)];
+	}
+
+	/// \returns sRGB encoding of 16 bit linear value v
+	inline core::uint8 linear16_to_srgb(const srgb_tables& tables, int v)
+	{
+		return tables.from_linear[(v * (LinearSteps - 1) + 32767) / 65535];
+	}
+
+} // end namespace
+} // end namespace
+} // end namespace
+
+#endif // __SRGB_H_4A9E1C07_D2B3_4F8A_B61E_90C35F7D2A18_
@@ -13,7 +13,13 @@
 #include "image/image_rgba16.h"
 #include "image/image_rgb24.h"
 #include "image/image_rgba32.h" 
+#include "image/image_rgba64.h"
+#include "image/image_dxtn.h"
+#include "image/image_array.h"
 #include "image/image_functions.h"
+#include "image/pixel_convert.h"
+#include "image/pixel_allocator.h"
+#include "image/tile_scheduler.h"
 #include "image/format_png.h"
 #include "image/format_dds.h"
 #include "core/core.h"
@@ -27,7 +33,11 @@
 #include "io/interface.h"
 #include "io/filesystem_device.h"
 #include "test/global_test_fixture.h"
+#include <atomic>
+#include <climits>
+#include <thread>
 #include <stdio.h>
+#include <string.h>
 
 using namespace tycho::image;
 
@@ -208,6 +218,178 @@ void test_rgba_format_impl(image_format format)
 	test_raw_copy<T>();
 }
 
+template<class T>
+void test_row_access_impl()
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	T image;
+	image.resize_canvas(8, 4, 1, false);
+	for(int y = 0; y < 4; ++y)
+		for(int x = 0; x < 8; ++x)
+			image.put_pixel(rgba(x, y, x+y, 3), 0, x, y);
+
+	// read rows and compare against per pixel access
+	canvas c;
+	BOOST_REQUIRE(image.get_mip_level(0, &c));
+	rgba row[8];
+	float frow[8*4];
+	for(int y = 0; y < 4; ++y)
+	{
+		c.read_row(1, y, 6, row);
+		c.read_row(0, y, 8, frow);
+		for(int x = 0; x < 6; ++x)
+			BOOST_CHECK(row[x] == image.get_pixel(0, x + 1, y));
+		for(int x = 0; x < 8; ++x)
+		{
+			rgba p = image.get_pixel(0, x, y);
+			BOOST_CHECK(frow[x] == p.r());
+			BOOST_CHECK(frow[x+8] == p.g());
+			BOOST_CHECK(frow[x+16] == p.b());
+			BOOST_CHECK(frow[x+24] == p.a());
+		}
+	}
+
+	// write rows back and compare against per pixel access
+	for(int x = 0; x < 8; ++x)
+		row[x] = rgba(7-x, x, 1, 2);
+	c.write_row(row, 0, 2, 8);
+	for(int x = 0; x < 8; ++x)
+	{
+		rgba expected = row[x];
+		T tmp;
+		tmp.resize_canvas(1, 1, 1, false);
+		tmp.put_pixel(expected, 0, 0, 0);
+		BOOST_CHECK(image.get_pixel(0, x, 2) == tmp.get_pixel(0, 0, 0));
+	}
+	c.read_row(0, 1, 8, frow);
+	c.write_row(frow, 0, 3, 8);
+	for(int x = 0; x < 8; ++x)
+		BOOST_CHECK(image.get_pixel(0, x, 3) == image.get_pixel(0, x, 1));
+}
+
+image_base_ptr make_layout_image(int i)
+{
+	switch(i)
+	{
+		case 0 : return image_base_ptr(new image_rgba32(image_rgba::pixel_layout_rgba8888));
+		case 1 : return image_base_ptr(new image_rgba32(image_rgba::pixel_layout_bgra8888));
+		case 2 : return image_base_ptr(new image_rgba32(image_rgba::pixel_layout_bgrx8888));
+		case 3 : return image_base_ptr(new image_rgb24(image_rgba::pixel_layout_rgb888));
+		case 4 : return image_base_ptr(new image_rgb24(image_rgba::pixel_layout_bgr888));
+		case 5 : return image_base_ptr(new image_rgba16(image_rgba::pixel_layout_argb4444));
+		case 6 : return image_base_ptr(new image_rgba16(image_rgba::pixel_layout_argb1555));
+		case 7 : return image_base_ptr(new image_rgba16(image_rgba::pixel_layout_rgb565));
+		case 8 : return image_base_ptr(new image_rgba16(image_rgba::pixel_layout_bgr565));
+		case 9 : return image_base_ptr(new image_a8(image_rgba::pixel_layout_a8));
+		case 10 : return image_base_ptr(new image_rgba32(16, 0xff, 8, 0xff, 0, 0xff, 24, 0xff)); // custom argb8888
+	}
+	return image_base_ptr();
+}
+
+const int NumLayoutImages = 11;
+
+/// converts rows of the given width between every pair of layouts and checks the specialised 
+/// converters match converting through get_pixel / put_pixel exactly, and the converters in use 
+/// match the portable ones, which differ where the cpu has SSE
+void check_layout_convert(int width)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	const int height = 3;
+	for(int s = 0; s < NumLayoutImages; ++s)
+	{
+		for(int d = 0; d < NumLayoutImages; ++d)
+		{
+			image_base_ptr src = make_layout_image(s);
+			image_base_ptr dst = make_layout_image(d);
+			image_base_ptr ref = make_layout_image(d);
+			image_base_ptr portable = make_layout_image(d);
+			const image_rgba& src_rgba = static_cast<image_rgba&>(*src);
+			const image_rgba& dst_rgba = static_cast<image_rgba&>(*dst);
+			bool custom = s == NumLayoutImages - 1 || d == NumLayoutImages - 1;
+			BOOST_CHECK((find_row_converter(src_rgba, dst_rgba) == 0) == custom);
+			BOOST_CHECK((find_portable_row_converter(src_rgba, dst_rgba) == 0) == custom);
+			BOOST_REQUIRE(src->resize_canvas(width, height, 1, false));
+			BOOST_REQUIRE(dst->resize_canvas(width, height, 1, false));
+			BOOST_REQUIRE(ref->resize_canvas(width, height, 1, false));
+			BOOST_REQUIRE(portable->resize_canvas(width, height, 1, false));
+			for(int y = 0; y < height; ++y)
+				for(int x = 0; x < width; ++x)
+					src->put_pixel(rgba(x * 37 + y, y * 91 + x, x * y * 13, 255 - x * 29), 0, x, y);
+			dst->clear(rgba(0,0,0,0), 0);
+			ref->clear(rgba(0,0,0,0), 0);
+			portable->clear(rgba(0,0,0,0), 0);
+			for(int y = 0; y < height; ++y)
+				for(int x = 0; x < width; ++x)
+					ref->put_pixel(src->get_pixel(0, x, y), 0, x, y);
+			canvas src_c, dst_c, ref_c, portable_c;
+			BOOST_REQUIRE(src->get_mip_level(0, &src_c));
+			BOOST_REQUIRE(dst->get_mip_level(0, &dst_c));
+			BOOST_REQUIRE(ref->get_mip_level(0, &ref_c));
+			BOOST_REQUIRE(portable->get_mip_level(0, &portable_c));
+			BOOST_CHECK(dst->copy(0, 0, 0, 0, width, height, src_c, dst_c));
+			BOOST_CHECK(memcmp(dst_c.get_pixels(), ref_c.get_pixels(), ref_c.get_byte_size()) == 0);
+			if(convert_row_fn convert = find_portable_row_converter(src_rgba, dst_rgba))
+			{
+				for(int y = 0; y < height; ++y)
+					convert(src_c.get_row(y), portable_c.get_row(y), width);
+				BOOST_CHECK(memcmp(dst_c.get_pixels(), portable_c.get_pixels(), portable_c.get_byte_size()) == 0);
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_layout_convert)
+{
+	check_layout_convert(7);
+}
+
+BOOST_AUTO_TEST_CASE(test_layout_convert_simd)
+{
+	// the sse converters match the portable ones for rows of whole vectors, rows that end part 
+	// way through one and rows where 24 bit sources stop short of the end to stay inside the row
+	const int widths[] = { 4, 6, 8, 16, 37 };
+	for(size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+		check_layout_convert(widths[w]);
+}
+
+BOOST_AUTO_TEST_CASE(test_copy_same_layout)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	image_rgba32 src, dst;
+	src.resize_canvas(16, 8, 1, false);
+	dst.resize_canvas(16, 8, 1, false);
+	for(int y = 0; y < 8; ++y)
+		for(int x = 0; x < 16; ++x)
+			src.put_pixel(rgba(x * 13, y * 29, x ^ y, x + y), 0, x, y);
+	canvas src_c, dst_c;
+	BOOST_REQUIRE(src.get_mip_level(0, &src_c));
+	BOOST_REQUIRE(dst.get_mip_level(0, &dst_c));
+
+	// whole canvas
+	dst.clear(rgba(0,0,0,0), 0);
+	BOOST_CHECK(image::copy(src_c, dst_c, src.get_rect(0), math::vector2i(0, 0)));
+	BOOST_CHECK(memcmp(src_c.get_pixels(), dst_c.get_pixels(), src_c.get_byte_size()) == 0);
+	
+	// sub rectangle, cropped against the destination
+	dst.clear(rgba(0,0,0,0), 0);
+	BOOST_CHECK(dst.copy(10, 5, 2, 1, 8, 4, src_c, dst_c));
+	for(int y = 0; y < 8; ++y)
+	{
+		for(int x = 0; x < 16; ++x)
+		{
+			bool inside = x >= 10 && y >= 5 && y < 8;
+			rgba expected = inside ? src.get_pixel(0, x - 8, y - 4) : rgba(0,0,0,0);
+			BOOST_CHECK(dst.get_pixel(0, x, y) == expected);
+		}
+	}
+}
+
 BOOST_AUTO_TEST_CASE(test_png_load)
 {
 	using namespace tycho;
@@ -290,6 +472,747 @@ BOOST_AUTO_TEST_CASE(test_png_load)
 	}	
 }
 
+BOOST_AUTO_TEST_CASE(test_png_reader)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	// interlaced rows arrive once per pass and are combined into the image
+	{
+		#include "png_interlaced_test.inc"
+		const int pieces[] = { png_interlaced_testLen, 1, 7, 64 };
+		for(int p = 0; p < 4; ++p)
+		{
+			png_reader reader;
+			for(int offset = 0; offset < png_interlaced_testLen; offset += pieces[p])
+			{
+				BOOST_CHECK(!reader.is_complete());
+				BOOST_REQUIRE(reader.process(png_interlaced_test + offset, std::min(pieces[p], png_interlaced_testLen - offset)));
+			}
+			BOOST_REQUIRE(reader.is_complete());
+			image_base_ptr i = reader.get_image();
+			BOOST_REQUIRE(i);
+			BOOST_CHECK(i->get_width() == 13 && i->get_height() == 11);
+			BOOST_CHECK(i->get_image_format() == image_format_rgba32);
+			bool same = true;
+			for(int y = 0; y < 11; ++y)
+				for(int x = 0; x < 13; ++x)
+					same = same && i->get_pixel(0, x, y) == rgba((x * 19) & 255, (y * 23) & 255, (x * y * 7) & 255, (255 - x - y * 3) & 255);
+			BOOST_CHECK(same);
+		}
+	}
+
+	// fed in pieces the image matches one loaded from a stream
+	{
+		#include "png_24bit_test.inc"
+		io::memory_stream str((char*)png_24bit_test, png_24bit_testLen);
+		image_base_ptr loaded = format_png::load(str);
+		BOOST_REQUIRE(loaded);
+		png_reader reader;
+		BOOST_CHECK(!reader.get_image());
+		for(int offset = 0; offset < png_24bit_testLen; offset += 5)
+			BOOST_REQUIRE(reader.process(png_24bit_test + offset, std::min(5, png_24bit_testLen - offset)));
+		image_base_ptr i = reader.get_image();
+		BOOST_REQUIRE(i && reader.is_complete());
+		canvas a, b;
+		BOOST_REQUIRE(i->get_mip_level(0, &a) && loaded->get_mip_level(0, &b));
+		BOOST_CHECK(memcmp(a.get_pixels(), b.get_pixels(), a.get_byte_size()) == 0);
+	}
+
+	// corrupt and truncated files fail
+	{
+		#include "png_32bit_clr_test.inc"
+		std::vector<core::uint8> file(png_32bit_clr_test, png_32bit_clr_test + png_32bit_clr_testLen);
+		file[20] ^= 0xff;
+		png_reader reader;
+		BOOST_CHECK(!reader.process(&file[0], (int)file.size()));
+		BOOST_CHECK(!reader.process(&file[0], (int)file.size()));
+		BOOST_CHECK(!reader.get_image());
+		io::memory_stream str((char*)png_32bit_clr_test, png_32bit_clr_testLen - 20);
+		BOOST_CHECK(!format_png::load(str));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_png_formats)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	// low bit depth grey expands to 8 bits in a luminance image, which reads back as opaque grey
+	{
+		#include "png_gray1_test.inc"
+		io::memory_stream str((char*)png_gray1_test, png_gray1_testLen);
+		image_base_ptr i = format_png::load(str);
+		BOOST_REQUIRE(i);
+		BOOST_CHECK(i->get_image_format() == image_format_a8);
+		BOOST_CHECK(static_cast<image_rgba&>(*i).get_pixel_layout() == image_rgba::pixel_layout_l8);
+		bool same = true;
+		std::vector<rgba> row(5);
+		for(int y = 0; y < 3; ++y)
+		{
+			i->read_row(0, 0, y, 5, &row[0]);
+			for(int x = 0; x < 5; ++x)
+			{
+				const int v = ((x + y) & 1) ? 255 : 0;
+				same = same && i->get_pixel(0, x, y) == rgba(v, v, v, 255) && row[x] == rgba(v, v, v, 255);
+			}
+		}
+		BOOST_CHECK(same);
+		BOOST_CHECK(!i->has_channel(colour_channel_alpha));
+	}
+
+	// a transparent grey level becomes grey with alpha
+	{
+		#include "png_gray4_trns_test.inc"
+		io::memory_stream str((char*)png_gray4_trns_test, png_gray4_trns_testLen);
+		image_base_ptr i = format_png::load(str);
+		BOOST_REQUIRE(i);
+		BOOST_CHECK(i->get_image_format() == image_format_rgba16);
+		bool same = true;
+		for(int y = 0; y < 3; ++y)
+		{
+			for(int x = 0; x < 5; ++x)
+			{
+				const int v = ((x * 3 + y) & 15) * 17;
+				same = same && i->get_pixel(0, x, y) == rgba(v, v, v, v == 51 ? 0 : 255);
+			}
+		}
+		BOOST_CHECK(same);
+	}
+
+	{
+		#include "png_gray_alpha8_test.inc"
+		io::memory_stream str((char*)png_gray_alpha8_test, png_gray_alpha8_testLen);
+		image_base_ptr i = format_png::load(str);
+		BOOST_REQUIRE(i);
+		BOOST_CHECK(i->get_image_format() == image_format_rgba16);
+		BOOST_CHECK(i->get_pixel(0, 3, 2) == rgba(150, 150, 150, 200));
+		BOOST_CHECK(i->has_channel(colour_channel_alpha));
+
+		// colours written to grey with alpha store their luminance, by pixel, by row and by copy
+		const rgba colour(200, 100, 50, 128), grey(124, 124, 124, 128);
+		i->put_pixel(colour, 0, 0, 0);
+		BOOST_CHECK(i->get_pixel(0, 0, 0) == grey);
+		i->write_row(&colour, 0, 1, 0, 1);
+		BOOST_CHECK(i->get_pixel(0, 1, 0) == grey);
+		image_base_ptr src(new image_rgba32());
+		BOOST_REQUIRE(src->resize_canvas(1, 1, 1, false));
+		src->put_pixel(colour, 0, 0, 0);
+		canvas src_c, dst_c;
+		BOOST_REQUIRE(src->get_mip_level(0, &src_c) && i->get_mip_level(0, &dst_c));
+		BOOST_REQUIRE(image::copy(src_c, dst_c, src->get_rect(0), math::vector2i(2, 0)));
+		BOOST_CHECK(i->get_pixel(0, 2, 0) == grey);
+	}
+
+	// palette entries with transparency expand to rgba
+	{
+		#include "png_palette2_trns_test.inc"
+		io::memory_stream str((char*)png_palette2_trns_test, png_palette2_trns_testLen);
+		image_base_ptr i = format_png::load(str);
+		BOOST_REQUIRE(i);
+		BOOST_CHECK(i->get_image_format() == image_format_rgba32);
+		const rgba palette[] = { rgba(255, 0, 0, 255), rgba(0, 255, 0, 128), rgba(0, 0, 255, 255), rgba(9, 8, 7, 255) };
+		bool same = true;
+		for(int y = 0; y < 3; ++y)
+			for(int x = 0; x < 5; ++x)
+				same = same && i->get_pixel(0, x, y) == palette[(x + y) & 3];
+		BOOST_CHECK(same);
+	}
+
+	// 16 bit files keep their precision, rgb gets an opaque alpha and grey is copied to rgb
+	{
+		#include "png_rgb16_test.inc"
+		io::memory_stream str((char*)png_rgb16_test, png_rgb16_testLen);
+		image_base_ptr i = format_png::load(str);
+		BOOST_REQUIRE(i);
+		BOOST_REQUIRE(i->get_image_format() == image_format_rgba64);
+		const image_rgba64& img = static_cast<image_rgba64&>(*i);
+		bool same = true;
+		for(int y = 0; y < 3; ++y)
+		{
+			for(int x = 0; x < 5; ++x)
+			{
+				const core::uint16* p = img.get_pixel_ptr(0, x, y);
+				same = same && p[0] == x * 1000 + 1 && p[1] == y * 3000 + 7 && p[2] == 65535 - x && p[3] == 65535;
+			}
+		}
+		BOOST_CHECK(same);
+	}
+	{
+		#include "png_gray_alpha16_test.inc"
+		io::memory_stream str((char*)png_gray_alpha16_test, png_gray_alpha16_testLen);
+		image_base_ptr i = format_png::load(str);
+		BOOST_REQUIRE(i);
+		BOOST_REQUIRE(i->get_image_format() == image_format_rgba64);
+		const core::uint16* p = static_cast<image_rgba64&>(*i).get_pixel_ptr(0, 4, 2);
+		BOOST_CHECK(p[0] == ((4 * 12345) & 0xffff) && p[1] == p[0] && p[2] == p[0] && p[3] == 40000);
+	}
+}
+
+/// \returns size of the png file at the start of the buffer, 0 if it has no IEND chunk
+static int get_png_file_size(const std::vector<char>& file)
+{
+	for(size_t i = 8; i + 8 <= file.size(); ++i)
+		if(memcmp(&file[i], "IEND", 4) == 0)
+			return (int)i + 8;
+	return 0;
+}
+
+BOOST_AUTO_TEST_CASE(test_png_save)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	// formats with a png layout are written as they are and load back byte for byte, others 
+	// are converted to rgb or rgba. Bytes 24 and 25 of the file are the bit depth and colour 
+	// type from the IHDR chunk.
+	struct format_case
+	{
+		image_base_ptr img;
+		int bit_depth, colour_type;
+		bool native;
+	} cases[] = {
+		{ image_base_ptr(new image_rgba32(image_rgba::pixel_layout_rgba8888)), 8, 6, true },
+		{ image_base_ptr(new image_rgb24(image_rgba::pixel_layout_rgb888)), 8, 2, true },
+		{ image_base_ptr(new image_a8(image_rgba::pixel_layout_l8)), 8, 0, true },
+		{ image_base_ptr(new image_rgba16(image_rgba::pixel_layout_la88)), 8, 4, true },
+		{ image_base_ptr(new image_rgba64()), 16, 6, true },
+		{ image_base_ptr(new image_a8(image_rgba::pixel_layout_a8)), 8, 6, false },
+		{ image_base_ptr(new image_rgba32(image_rgba::pixel_layout_bgra8888)), 8, 6, false },
+		{ image_base_ptr(new image_rgba16(image_rgba::pixel_layout_rgb565)), 8, 2, false }
+	};
+	for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+	{
+		image_base_ptr img = cases[i].img;
+		BOOST_REQUIRE(img->resize_canvas(21, 7, 1, false));
+		for(int y = 0; y < 7; ++y)
+			for(int x = 0; x < 21; ++x)
+				img->put_pixel(rgba(x * 12, y * 36, 200 - x * 8, 255 - y * 30), 0, x, y);
+		std::vector<char> file(4096);
+		io::memory_stream ostr(&file[0], (int)file.size());
+		BOOST_REQUIRE(format_png::save(img, ostr));
+		BOOST_CHECK(file[24] == cases[i].bit_depth);
+		BOOST_CHECK(file[25] == cases[i].colour_type);
+		
+		io::memory_stream istr(&file[0], get_png_file_size(file));
+		image_base_ptr loaded = format_png::load(istr);
+		BOOST_REQUIRE(loaded);
+		if(cases[i].native)
+		{
+			canvas a, b;
+			BOOST_REQUIRE(img->get_mip_level(0, &a) && loaded->get_mip_level(0, &b));
+			BOOST_CHECK(loaded->get_image_format() == img->get_image_format());
+			BOOST_CHECK(a.get_byte_size() == b.get_byte_size() && memcmp(a.get_pixels(), b.get_pixels(), a.get_byte_size()) == 0);
+			continue;
+		}
+		const bool alpha = img->has_channel(colour_channel_alpha);
+		for(int y = 0; y < 7; ++y)
+		{
+			for(int x = 0; x < 21; ++x)
+			{
+				rgba expected = img->get_pixel(0, x, y);
+				if(!alpha)
+					expected = rgba(expected.r(), expected.g(), expected.b(), 255);
+				BOOST_CHECK(loaded->get_pixel(0, x, y) == expected);
+			}
+		}
+	}
+
+	// 16 bit channels survive the round trip
+	{
+		image_base_ptr img(new image_rgba64());
+		BOOST_REQUIRE(img->resize_canvas(3, 2, 1, false));
+		img->clear(rgba(0, 0, 0, 255), 0);
+		static_cast<image_rgba64&>(*img).get_pixel_ptr(0, 1, 1)[2] = 0x1234;
+		std::vector<char> file(1024);
+		io::memory_stream ostr(&file[0], (int)file.size());
+		BOOST_REQUIRE(format_png::save(img, ostr));
+		io::memory_stream istr(&file[0], get_png_file_size(file));
+		image_base_ptr loaded = format_png::load(istr);
+		BOOST_REQUIRE(loaded && loaded->get_image_format() == image_format_rgba64);
+		BOOST_CHECK(static_cast<image_rgba64&>(*loaded).get_pixel_ptr(0, 1, 1)[2] == 0x1234);
+		BOOST_CHECK(static_cast<image_rgba64&>(*loaded).get_pixel_ptr(0, 1, 1)[3] == 0xffff);
+	}
+
+	// fast settings load back the same and the highest level is never bigger than the fastest
+	{
+		#include "png_24bit_test.inc"
+		io::memory_stream str((char*)png_24bit_test, png_24bit_testLen);
+		image_base_ptr img = format_png::load(str);
+		BOOST_REQUIRE(img);
+		std::vector<char> fast_file(1 << 20), best_file(1 << 20);
+		io::memory_stream fast_str(&fast_file[0], (int)fast_file.size());
+		BOOST_REQUIRE(format_png::save(img, fast_str, png_options::fast()));
+		png_options best;
+		best.compression_level = 9;
+		best.weighted_filters = true;
+		io::memory_stream best_str(&best_file[0], (int)best_file.size());
+		BOOST_REQUIRE(format_png::save(img, best_str, best));
+		BOOST_CHECK(get_png_file_size(best_file) <= get_png_file_size(fast_file));
+
+		io::memory_stream istr(&fast_file[0], get_png_file_size(fast_file));
+		image_base_ptr loaded = format_png::load(istr);
+		BOOST_REQUIRE(loaded);
+		canvas a, b;
+		BOOST_REQUIRE(img->get_mip_level(0, &a) && loaded->get_mip_level(0, &b));
+		BOOST_CHECK(a.get_byte_size() == b.get_byte_size() && memcmp(a.get_pixels(), b.get_pixels(), a.get_byte_size()) == 0);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_png_save_strips)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	// strips deflated on their own load back the same as the image for every row layout, 
+	// including strips that don't divide the height
+	image_base_ptr cases[] = {
+		image_base_ptr(new image_rgba32(image_rgba::pixel_layout_rgba8888)),
+		image_base_ptr(new image_rgb24(image_rgba::pixel_layout_rgb888)),
+		image_base_ptr(new image_a8(image_rgba::pixel_layout_l8)),
+		image_base_ptr(new image_rgba64()),
+		image_base_ptr(new image_rgba32(image_rgba::pixel_layout_bgra8888))
+	};
+	const int filters[] = { png_options::filter_all, png_options::filter_none, png_options::filter_paeth, png_options::filter_sub | png_options::filter_avg };
+	for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+	{
+		image_base_ptr img = cases[i];
+		BOOST_REQUIRE(img->resize_canvas(67, 101, 1, false));
+		for(int y = 0; y < 101; ++y)
+			for(int x = 0; x < 67; ++x)
+				img->put_pixel(rgba(x * 3 + y, (x * y) & 0xff, (x ^ y) * 5, 255 - y), 0, x, y);
+		for(size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f)
+		{
+			png_options options;
+			options.filters = filters[f];
+			options.strip_rows = 16;
+			options.compression_level = (int)f * 3;
+			std::vector<char> file(1 << 17);
+			io::memory_stream ostr(&file[0], (int)file.size());
+			BOOST_REQUIRE(format_png::save(img, ostr, options));
+			int idat_chunks = 0;
+			for(size_t b = 8; b + 4 < file.size() && memcmp(&file[b], "IEND", 4); ++b)
+				if(memcmp(&file[b], "IDAT", 4) == 0)
+					++idat_chunks;
+			BOOST_CHECK(idat_chunks == 7);
+
+			io::memory_stream istr(&file[0], get_png_file_size(file));
+			image_base_ptr loaded = format_png::load(istr);
+			BOOST_REQUIRE(loaded);
+			for(int y = 0; y < 101; ++y)
+				for(int x = 0; x < 67; ++x)
+					BOOST_CHECK(loaded->get_pixel(0, x, y) == img->get_pixel(0, x, y));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_png_filters)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	// each filter on its own, for every pixel size and for widths that end part way through 
+	// the vector loop, loads back the same. The images are taller than a block of filtered rows.
+	const int widths[] = { 1, 5, 19, 40 };
+	const int filters[] = { 
+		png_options::filter_none, png_options::filter_sub, png_options::filter_up, 
+		png_options::filter_avg, png_options::filter_paeth, png_options::filter_all 
+	};
+	for(size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f)
+	{
+		for(size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+		{
+			image_base_ptr cases[] = {
+				image_base_ptr(new image_a8(image_rgba::pixel_layout_l8)),
+				image_base_ptr(new image_rgba16(image_rgba::pixel_layout_la88)),
+				image_base_ptr(new image_rgb24(image_rgba::pixel_layout_rgb888)),
+				image_base_ptr(new image_rgba32(image_rgba::pixel_layout_rgba8888)),
+				image_base_ptr(new image_rgba64())
+			};
+			for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+			{
+				image_base_ptr img = cases[i];
+				const int width = widths[w];
+				BOOST_REQUIRE(img->resize_canvas(width, 131, 1, false));
+				for(int y = 0; y < 131; ++y)
+					for(int x = 0; x < width; ++x)
+						img->put_pixel(rgba((x * 37 + y * 91) & 0xff, (x * x + 200 * y) & 0xff, (x * 13) ^ (y * 71), 255 - x * y), 0, x, y);
+				png_options options;
+				options.filters = filters[f];
+				std::vector<char> file(1 << 16);
+				io::memory_stream ostr(&file[0], (int)file.size());
+				BOOST_REQUIRE(format_png::save(img, ostr, options));
+				io::memory_stream istr(&file[0], get_png_file_size(file));
+				image_base_ptr loaded = format_png::load(istr);
+				BOOST_REQUIRE(loaded);
+				canvas a, b;
+				BOOST_REQUIRE(img->get_mip_level(0, &a) && loaded->get_mip_level(0, &b));
+				BOOST_CHECK(a.get_byte_size() == b.get_byte_size() && memcmp(a.get_pixels(), b.get_pixels(), a.get_byte_size()) == 0);
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_pixel_pool)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	// buffers are aligned whatever size they are
+	pixel_allocator& allocator = get_default_pixel_allocator();
+	for(int size = 1; size < 5000; size += 333)
+	{
+		core::uint8* p = allocator.allocate(size);
+		BOOST_REQUIRE(p);
+		BOOST_CHECK((reinterpret_cast<size_t>(p) & (pixel_allocator::Alignment - 1)) == 0);
+		memset(p, 0xcd, size);
+		allocator.deallocate(p, size);
+	}
+
+	// buckets waste at most an eighth of the size
+	BOOST_CHECK(pixel_pool::get_bucket_size(1) == 64);
+	BOOST_CHECK(pixel_pool::get_bucket_size(1024) == 1024);
+	BOOST_CHECK(pixel_pool::get_bucket_size(1025) == 1152);
+	BOOST_CHECK(pixel_pool::get_bucket_size(1 << 20) == 1 << 20);
+	BOOST_CHECK(pixel_pool::get_bucket_size((1 << 20) + 1) == (1 << 20) + (1 << 17));
+
+	// freed image pixels are handed to the next image of the same size
+	pixel_pool pool(1 << 20);
+	core::uint8* first = 0;
+	{
+		image_rgba32 img(image_rgba::pixel_layout_rgba8888);
+		img.set_allocator(pool);
+		BOOST_REQUIRE(img.resize_canvas(64, 32, 1, false));
+		canvas c;
+		BOOST_REQUIRE(img.get_mip_level(0, &c));
+		first = c.get_pixels();
+		BOOST_CHECK((reinterpret_cast<size_t>(first) & (pixel_allocator::Alignment - 1)) == 0);
+		BOOST_CHECK(pool.get_cached_bytes() == 0);
+	}
+	BOOST_CHECK(pool.get_cached_bytes() == 64 * 32 * 4);
+	{
+		image_rgba32 img(image_rgba::pixel_layout_rgba8888);
+		img.set_allocator(pool);
+		BOOST_REQUIRE(img.resize_canvas(64, 32, 1, false));
+		canvas c;
+		BOOST_REQUIRE(img.get_mip_level(0, &c));
+		BOOST_CHECK(c.get_pixels() == first);
+		BOOST_CHECK(pool.get_cached_bytes() == 0);
+
+		// resizing frees to the allocator the pixels came from
+		img.set_allocator(get_default_pixel_allocator());
+		BOOST_REQUIRE(img.resize_canvas(16, 16, 1, false));
+		BOOST_CHECK(pool.get_cached_bytes() == 64 * 32 * 4);
+	}
+
+	// past the cap buffers go straight back
+	{
+		image_base_ptr big(new image_rgba32(image_rgba::pixel_layout_rgba8888));
+		static_cast<image_rgba&>(*big).set_allocator(pool);
+		BOOST_REQUIRE(big->resize_canvas(1024, 1024, 1, false));
+	}
+	BOOST_CHECK(pool.get_cached_bytes() == 64 * 32 * 4);
+	pool.trim();
+	BOOST_CHECK(pool.get_cached_bytes() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_pixel_arena)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	// allocations are aligned and carved from the blocks, reset keeps them for reuse
+	pixel_arena arena(4096);
+	core::uint8* a = arena.allocate(10);
+	core::uint8* b = arena.allocate(100);
+	BOOST_REQUIRE(a && b);
+	BOOST_CHECK((reinterpret_cast<size_t>(a) & (pixel_allocator::Alignment - 1)) == 0);
+	BOOST_CHECK(b == a + 64);
+	BOOST_CHECK(arena.get_used_bytes() == 64 + 128);
+	BOOST_CHECK(arena.allocate(10000) != 0);
+	BOOST_CHECK(arena.get_reserved_bytes() == 4096 + 10048);
+	arena.reset();
+	BOOST_CHECK(arena.get_used_bytes() == 0);
+	BOOST_CHECK(arena.allocate(10) == a);
+	arena.release();
+	BOOST_CHECK(arena.get_reserved_bytes() == 0);
+
+	// codecs and resizes draw their temporaries from the arena and give the same results, on
+	// one thread so the allocations are made in the same order each pass
+	image::set_num_worker_threads(1);
+	image_base_ptr img(new image_rgba16(image_rgba::pixel_layout_rgb565));
+	BOOST_REQUIRE(img->resize_canvas(48, 40, 1, false));
+	for(int y = 0; y < 40; ++y)
+		for(int x = 0; x < 48; ++x)
+			img->put_pixel(rgba(x * 5, y * 6, (x * y) & 0xff, 255), 0, x, y);
+	int reserved = 0;
+	for(int pass = 0; pass < 3; ++pass)
+	{
+		std::vector<char> png_plain(1 << 14), png_arena(1 << 14);
+		io::memory_stream plain_str(&png_plain[0], (int)png_plain.size());
+		io::memory_stream arena_str(&png_arena[0], (int)png_arena.size());
+		BOOST_REQUIRE(format_png::save(img, plain_str, png_options()));
+		BOOST_REQUIRE(format_png::save(img, arena_str, png_options(), &arena));
+		BOOST_CHECK(png_plain == png_arena);
+		io::memory_stream load_str(&png_arena[0], get_png_file_size(png_arena));
+		image_base_ptr loaded = format_png::load(load_str, &arena);
+		BOOST_REQUIRE(loaded);
+		BOOST_CHECK(loaded->get_pixel(0, 47, 39) == img->get_pixel(0, 47, 39));
+
+		std::vector<char> dds_plain(128 + 48 * 40 * 4), dds_arena(128 + 48 * 40 * 4);
+		io::memory_stream dds_plain_str(&dds_plain[0], (int)dds_plain.size());
+		io::memory_stream dds_arena_str(&dds_arena[0], (int)dds_arena.size());
+		image_base_ptr wide(new image_rgba64());
+		BOOST_REQUIRE(wide->resize_canvas(48, 40, 1, false) && image::copy(img, wide));
+		BOOST_REQUIRE(format_dds::save(wide, dds_plain_str) && format_dds::save(wide, dds_arena_str, &arena));
+		BOOST_CHECK(dds_plain == dds_arena);
+
+		image_rgba32 plain, arena_dst;
+		BOOST_REQUIRE(plain.resize_canvas(21, 17, 1, false) && arena_dst.resize_canvas(21, 17, 1, false));
+		canvas src_c, plain_c, arena_c;
+		BOOST_REQUIRE(img->get_mip_level(0, &src_c) && plain.get_mip_level(0, &plain_c) && arena_dst.get_mip_level(0, &arena_c));
+		for(int flags = 0; flags < 2; ++flags)
+		{
+			const int f = flags ? resample_flag_fixed_point : resample_flag_none;
+			BOOST_REQUIRE(image::resize(src_c, plain_c, img->get_rect(0), plain.get_rect(0), filter_type_lanczos3, f));
+			BOOST_REQUIRE(image::resize(src_c, arena_c, img->get_rect(0), arena_dst.get_rect(0), filter_type_lanczos3, f, &arena));
+			BOOST_CHECK(memcmp(plain_c.get_pixels(), arena_c.get_pixels(), plain_c.get_byte_size()) == 0);
+		}
+		BOOST_CHECK(arena.get_used_bytes() > 0);
+
+		// once the arena has grown to fit a frame it stops allocating
+		arena.reset();
+		if(pass > 0)
+			BOOST_CHECK(arena.get_reserved_bytes() == reserved);
+		reserved = arena.get_reserved_bytes();
+	}
+	image::set_num_worker_threads(0);
+}
+
+BOOST_AUTO_TEST_CASE(test_row_pitch)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	// rows of every level are padded to the alignment and levels follow on
+	image_rgb24* padded = new image_rgb24();
+	image_base_ptr img(padded);
+	padded->set_row_alignment(64);
+	BOOST_REQUIRE(img->resize_canvas(37, 23, 3, false));
+	BOOST_CHECK(img->get_stride() == 128);
+	canvas top, mip1;
+	BOOST_REQUIRE(img->get_mip_level(0, &top) && img->get_mip_level(1, &mip1));
+	BOOST_CHECK(top.get_pitch() == 128 && mip1.get_pitch() == 64);
+	BOOST_CHECK(mip1.get_pixels() == top.get_pixels() + 128 * 23);
+	for(int y = 0; y < 23; ++y)
+		for(int x = 0; x < 37; ++x)
+			img->put_pixel(rgba(x * 7, y * 11, x ^ y, 255), 0, x, y);
+	BOOST_CHECK(img->get_pixel(0, 36, 5) == rgba(36 * 7, 55, 36 ^ 5, 255));
+
+	// copies, raw copies and saving honour the padding
+	image_base_ptr tight(new image_rgb24());
+	BOOST_REQUIRE(tight->resize_canvas(37, 23, 1, false) && image::copy(img, tight));
+	canvas tight_c;
+	BOOST_REQUIRE(tight->get_mip_level(0, &tight_c) && tight_c.get_pitch() == 37 * 3);
+	BOOST_CHECK(tight->get_pixel(0, 36, 22) == img->get_pixel(0, 36, 22));
+	img->clear(rgba(0, 0, 0, 255), 0);
+	BOOST_REQUIRE(img->raw_copy(0, 0, 0, 37, 23, tight_c.get_pixels(), tight_c.get_byte_size()));
+	for(int y = 0; y < 23; ++y)
+		BOOST_CHECK(memcmp(top.get_row(y), tight_c.get_row(y), 37 * 3) == 0);
+
+	std::vector<char> padded_png(1 << 14), tight_png(1 << 14);
+	io::memory_stream padded_str(&padded_png[0], (int)padded_png.size());
+	io::memory_stream tight_str(&tight_png[0], (int)tight_png.size());
+	BOOST_REQUIRE(format_png::save(img, padded_str, png_options()) && format_png::save(tight, tight_str, png_options()));
+	BOOST_CHECK(padded_png == tight_png);
+	std::vector<char> padded_dds(1 << 14), tight_dds(1 << 14);
+	io::memory_stream padded_dds_str(&padded_dds[0], (int)padded_dds.size());
+	io::memory_stream tight_dds_str(&tight_dds[0], (int)tight_dds.size());
+	BOOST_REQUIRE(format_dds::save(img, 0, padded_dds_str) && format_dds::save(tight, 0, tight_dds_str));
+	BOOST_CHECK(padded_dds == tight_dds);
+
+	// views take the pitch of an external buffer
+	std::vector<core::uint8> staging(256 * 23);
+	image_rgb24 view;
+	BOOST_CHECK(!view.create_view(37, 23, &staging[0], 100));
+	BOOST_REQUIRE(view.create_view(37, 23, &staging[0], 256));
+	canvas view_c;
+	BOOST_REQUIRE(view.get_mip_level(0, &view_c) && view_c.get_pitch() == 256);
+	BOOST_REQUIRE(image::copy(tight_c, view_c, tight->get_rect(0), math::vector2i(0, 0)));
+	BOOST_CHECK(staging[256 * 22 + 36 * 3] == tight_c.get_row(22)[36 * 3]);
+	BOOST_CHECK(view.get_pixel(0, 36, 22) == tight->get_pixel(0, 36, 22));
+}
+
+BOOST_AUTO_TEST_CASE(test_mip_chain)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	BOOST_CHECK(get_mip_chain_length(1, 1) == 1);
+	BOOST_CHECK(get_mip_chain_length(20, 12) == 5);
+	BOOST_CHECK(get_mip_chain_length(16384, 16384) == 15);
+
+	// chains run down to 1x1 rounding each level down, the long side sets the length
+	image_a8 strip;
+	BOOST_REQUIRE(strip.resize_canvas(16384, 4, image_base::FullMipChain, false));
+	BOOST_CHECK(strip.get_num_mips() == 15);
+	BOOST_CHECK(strip.get_rect(2).get_width() == 4096 && strip.get_rect(2).get_height() == 1);
+	BOOST_CHECK(strip.get_rect(14).get_width() == 1 && strip.get_rect(14).get_height() == 1);
+	canvas last;
+	BOOST_REQUIRE(strip.get_mip_level(14, &last));
+	strip.put_pixel(rgba(0, 0, 0, 77), 14, 0, 0);
+	BOOST_CHECK(strip.get_pixel(14, 0, 0).a() == 77);
+	BOOST_CHECK(!strip.resize_canvas(16, 16, 0, false));
+
+	// images whose levels don't fit an int are refused before anything is allocated and the 
+	// image is left as it was
+	image_rgba64 wide;
+	BOOST_REQUIRE(wide.resize_canvas(4, 4, 1, false));
+	BOOST_CHECK(!wide.resize_canvas(16384, 16384, 1, false));
+	core::uint8 pixels[16];
+	BOOST_CHECK(!wide.create_view(16384, 16384, 1, pixels));
+	BOOST_CHECK(wide.get_width() == 4 && wide.get_num_mips() == 1 && wide.get_capacity() == 4 * 4 * 8);
+	image_dxtn huge(image_dxtn::dxtn_type_dxt5);
+	BOOST_CHECK(!huge.resize_canvas(65536, 65536, 1, false));
+	image_rgba32 padded;
+	padded.set_row_alignment(1 << 20);
+	BOOST_CHECK(!padded.resize_canvas(4, 4096, 1, false));
+	BOOST_CHECK(!padded.create_view(1, 2, pixels, INT_MAX / 2 + 1));
+	BOOST_CHECK(padded.create_view(2, 2, pixels, 8));
+
+	image_base_ptr img(new image_rgba32());
+	BOOST_REQUIRE(img->resize_canvas(20, 12, 16, false));
+	BOOST_CHECK(img->get_num_mips() == 5);
+	BOOST_CHECK(img->get_rect(1).get_width() == 10 && img->get_rect(1).get_height() == 6);
+	BOOST_CHECK(img->get_rect(3).get_width() == 2 && img->get_rect(3).get_height() == 1);
+	img->clear(rgba(200, 100, 50, 255), 0);
+	BOOST_REQUIRE(build_mip_chain(img, 1, 1));
+	BOOST_CHECK(img->get_pixel(4, 0, 0) == rgba(200, 100, 50, 255));
+
+	// dds files keep every level
+	std::vector<char> file(1 << 12);
+	io::memory_stream ostr(&file[0], (int)file.size());
+	BOOST_REQUIRE(format_dds::save(img, ostr));
+	image_base_ptr loaded = format_dds::load((core::uint8*)&file[0], (int)file.size());
+	BOOST_REQUIRE(loaded);
+	BOOST_CHECK(loaded->get_num_mips() == 5);
+	BOOST_CHECK(loaded->get_pixel(4, 0, 0) == rgba(200, 100, 50, 255));
+}
+
+/// fills a mip level with a pattern unique to each pixel and level
+static void fill_pattern(tycho::image::image_base& img, int mip_level)
+{
+	for(int y = 0; y < img.get_rect(mip_level).get_height(); ++y)
+		for(int x = 0; x < img.get_rect(mip_level).get_width(); ++x)
+			img.put_pixel(tycho::core::rgba(x, y, mip_level, 255), mip_level, x, y);
+}
+
+/// \returns true if the top left width x height pixels of a mip level still hold the pattern
+static bool has_pattern(const tycho::image::image_base& img, int mip_level, int width, int height)
+{
+	bool same = true;
+	for(int y = 0; y < height; ++y)
+		for(int x = 0; x < width; ++x)
+			same = same && img.get_pixel(mip_level, x, y) == tycho::core::rgba(x, y, mip_level, 255);
+	return same;
+}
+
+BOOST_AUTO_TEST_CASE(test_resize_preserve)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	// resizes that fit reuse the buffer, moving the kept rows down or up in place
+	image_rgba32 img;
+	BOOST_REQUIRE(img.resize_canvas(64, 64, 1, false));
+	canvas c;
+	BOOST_REQUIRE(img.get_mip_level(0, &c));
+	const core::uint8* pixels = c.get_pixels();
+	fill_pattern(img, 0);
+	BOOST_REQUIRE(img.resize_canvas(48, 60, 1, true));
+	BOOST_REQUIRE(img.get_mip_level(0, &c));
+	BOOST_CHECK(c.get_pixels() == pixels && img.get_capacity() == 64 * 64 * 4);
+	BOOST_CHECK(has_pattern(img, 0, 48, 60));
+	BOOST_REQUIRE(img.resize_canvas(60, 64, 1, true));
+	BOOST_REQUIRE(img.get_mip_level(0, &c));
+	BOOST_CHECK(c.get_pixels() == pixels);
+	BOOST_CHECK(has_pattern(img, 0, 48, 60));
+
+	// growing past the buffer or shrinking well below it reallocates
+	BOOST_REQUIRE(img.resize_canvas(70, 64, 1, true));
+	BOOST_CHECK(img.get_capacity() == 70 * 64 * 4);
+	BOOST_CHECK(has_pattern(img, 0, 48, 60));
+	BOOST_REQUIRE(img.resize_canvas(20, 20, 1, true));
+	BOOST_CHECK(img.get_capacity() == 20 * 20 * 4);
+	BOOST_CHECK(has_pattern(img, 0, 20, 20));
+
+	// each level keeps its overlap, levels that can't be moved in place are copied
+	BOOST_REQUIRE(img.resize_canvas(32, 16, 2, false));
+	BOOST_REQUIRE(img.resize_canvas(32, 8, 2, false));
+	BOOST_CHECK(img.get_capacity() == (32 * 16 + 16 * 8) * 4);
+	fill_pattern(img, 0);
+	fill_pattern(img, 1);
+	BOOST_REQUIRE(img.resize_canvas(16, 24, 2, true));
+	BOOST_CHECK(img.get_capacity() == (16 * 24 + 8 * 12) * 4);
+	BOOST_CHECK(has_pattern(img, 0, 16, 8) && has_pattern(img, 1, 8, 4));
+	fill_pattern(img, 0);
+	fill_pattern(img, 1);
+	BOOST_REQUIRE(img.resize_canvas(14, 20, 3, true));
+	BOOST_CHECK(img.get_capacity() == (16 * 24 + 8 * 12) * 4);
+	BOOST_CHECK(has_pattern(img, 0, 14, 20) && has_pattern(img, 1, 7, 10));
+
+	// without preserve_contents nothing is moved but the buffer is still reused
+	BOOST_REQUIRE(img.resize_canvas(16, 24, 1, false));
+	BOOST_CHECK(img.get_num_mips() == 1 && img.get_capacity() == (16 * 24 + 8 * 12) * 4);
+
+	// 16 bit images copy the overlap of each level into pixels from their allocator
+	pixel_pool pool(1 << 20);
+	image_rgba64 img64;
+	img64.set_allocator(pool);
+	BOOST_REQUIRE(img64.resize_canvas(24, 16, 2, false));
+	fill_pattern(img64, 0);
+	fill_pattern(img64, 1);
+	BOOST_REQUIRE(img64.resize_canvas(20, 18, 2, true));
+	BOOST_CHECK(img64.get_capacity() == (20 * 18 + 10 * 9) * image_rgba64::BytesPerPixel);
+	BOOST_CHECK(has_pattern(img64, 0, 20, 16) && has_pattern(img64, 1, 10, 8));
+	BOOST_CHECK(pool.get_cached_bytes() == (24 * 16 + 12 * 8) * image_rgba64::BytesPerPixel);
+}
+
+BOOST_AUTO_TEST_CASE(test_rgba64)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	image_base_ptr img(new image_rgba64());
+	BOOST_REQUIRE(img->resize_canvas(9, 5, 8, false));
+	BOOST_CHECK(img->get_num_mips() == 4);
+	BOOST_CHECK(img->get_rect(3).get_width() == 1 && img->get_rect(3).get_height() == 1);
+	img->clear(rgba(10, 20, 30, 255), 0);
+	img->put_pixel(rgba(1, 2, 3, 4), 0, 8, 4);
+	BOOST_CHECK(img->get_pixel(0, 8, 4) == rgba(1, 2, 3, 4));
+	BOOST_CHECK(img->get_pixel(0, 0, 0) == rgba(10, 20, 30, 255));
+
+	// float rows keep the 16 bit values
+	core::uint16* p = static_cast<image_rgba64&>(*img).get_pixel_ptr(0, 2, 1);
+	p[0] = 12345;
+	float row[9 * 4];
+	img->read_row(0, 0, 1, 9, row);
+	BOOST_CHECK(row[2] > 12345.0f / 257.0f - 1e-3f && row[2] < 12345.0f / 257.0f + 1e-3f);
+	img->write_row(row, 0, 0, 2, 9);
+	BOOST_CHECK(static_cast<image_rgba64&>(*img).get_pixel_ptr(0, 2, 2)[0] == 12345);
+
+	// copies between 16 bit images are exact, to 8 bit images they round
+	image_base_ptr dst64(new image_rgba64());
+	image_base_ptr dst32(new image_rgba32());
+	BOOST_REQUIRE(dst64->resize_canvas(9, 5, 1, false) && dst32->resize_canvas(9, 5, 1, false));
+	BOOST_REQUIRE(image::copy(img, dst64) && image::copy(img, dst32));
+	canvas a, b;
+	BOOST_REQUIRE(img->get_mip_level(0, &a) && dst64->get_mip_level(0, &b));
+	BOOST_CHECK(memcmp(a.get_pixels(), b.get_pixels(), a.get_byte_size()) == 0);
+	BOOST_CHECK(dst32->get_pixel(0, 2, 1) == rgba(48, 20, 30, 255));
+	BOOST_CHECK(dst32->get_pixel(0, 8, 4) == rgba(1, 2, 3, 4));
+}
+
 BOOST_AUTO_TEST_CASE(test_resize)
 {
 	using namespace tycho;
@@ -313,6 +1236,1054 @@ BOOST_AUTO_TEST_CASE(test_resize)
 	//ostr.close();
 }
 
+BOOST_AUTO_TEST_CASE(test_resize_filters)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	const filter_type filters[] = { filter_type_box, filter_type_triangle, filter_type_gaussian, 
+									filter_type_mitchell, filter_type_lanczos3, filter_type_kaiser };
+	for(int f = 0; f < 6; ++f)
+	{
+		// a flat image stays flat whatever the filter and scale
+		image_rgba32 src, dst;
+		src.resize_canvas(37, 23, 1, false);
+		src.clear(rgba(200, 100, 50, 255), 0);
+		canvas src_c, dst_c;
+		BOOST_REQUIRE(src.get_mip_level(0, &src_c));
+		const int sizes[][2] = { { 16, 11 }, { 37, 23 }, { 80, 50 }, { 1, 1 } };
+		for(int s = 0; s < 4; ++s)
+		{
+			dst.resize_canvas(sizes[s][0], sizes[s][1], 1, false);
+			BOOST_REQUIRE(dst.get_mip_level(0, &dst_c));
+			BOOST_CHECK(image::resize(src_c, dst_c, src.get_rect(0), dst.get_rect(0), filters[f]));
+			for(int y = 0; y < dst.get_height(); ++y)
+				for(int x = 0; x < dst.get_width(); ++x)
+					BOOST_CHECK(dst.get_pixel(0, x, y) == rgba(200, 100, 50, 255));
+		}
+	}
+	
+	// box filter halving averages each 2x2 block
+	{
+		image_rgba32 src, dst;
+		src.resize_canvas(4, 4, 1, false);
+		dst.resize_canvas(2, 2, 1, false);
+		for(int y = 0; y < 4; ++y)
+			for(int x = 0; x < 4; ++x)
+				src.put_pixel(rgba(x * 20, y * 40, (x + y) * 10, 255), 0, x, y);
+		canvas src_c, dst_c;
+		BOOST_REQUIRE(src.get_mip_level(0, &src_c));
+		BOOST_REQUIRE(dst.get_mip_level(0, &dst_c));
+		BOOST_CHECK(image::resize(src_c, dst_c, src.get_rect(0), dst.get_rect(0), filter_type_box));
+		BOOST_CHECK(dst.get_pixel(0, 0, 0) == rgba(10, 20, 10, 255));
+		BOOST_CHECK(dst.get_pixel(0, 1, 0) == rgba(50, 20, 30, 255));
+		BOOST_CHECK(dst.get_pixel(0, 0, 1) == rgba(10, 100, 30, 255));
+		BOOST_CHECK(dst.get_pixel(0, 1, 1) == rgba(50, 100, 50, 255));
+	}
+	
+	// only the destination rectangle is written
+	{
+		image_rgba32 src, dst;
+		src.resize_canvas(8, 8, 1, false);
+		dst.resize_canvas(8, 8, 1, false);
+		src.clear(rgba(255, 255, 255, 255), 0);
+		dst.clear(rgba(0, 0, 0, 0), 0);
+		canvas src_c, dst_c;
+		BOOST_REQUIRE(src.get_mip_level(0, &src_c));
+		BOOST_REQUIRE(dst.get_mip_level(0, &dst_c));
+		BOOST_CHECK(image::resize(src_c, dst_c, math::recti(0, 0, 8, 8), math::recti(4, 4, 8, 8), filter_type_lanczos3));
+		for(int y = 0; y < 8; ++y)
+			for(int x = 0; x < 8; ++x)
+				BOOST_CHECK(dst.get_pixel(0, x, y) == ((x >= 4 && y >= 4) ? rgba(255, 255, 255, 255) : rgba(0, 0, 0, 0)));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_resize_fixed_point)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	image_rgba32 src, flt, fix;
+	src.resize_canvas(41, 29, 1, false);
+	for(int y = 0; y < src.get_height(); ++y)
+		for(int x = 0; x < src.get_width(); ++x)
+			src.put_pixel(rgba(x * 6, y * 8, (x + y) * 3, 255 - x * y / 5), 0, x, y);
+	canvas src_c, flt_c, fix_c;
+	BOOST_REQUIRE(src.get_mip_level(0, &src_c));
+
+	const filter_type filters[] = { filter_type_box, filter_type_triangle, filter_type_gaussian, 
+									filter_type_mitchell, filter_type_lanczos3, filter_type_kaiser };
+	const int sizes[][2] = { { 13, 9 }, { 41, 29 }, { 67, 51 }, { 1, 1 } };
+	for(int f = 0; f < 6; ++f)
+	{
+		for(int s = 0; s < 4; ++s)
+		{
+			// fixed point stays within rounding of the float path, each pass can round once. The source
+			// is smooth as the fixed point path clamps between passes so sharp edges ring differently.
+			flt.resize_canvas(sizes[s][0], sizes[s][1], 1, false);
+			fix.resize_canvas(sizes[s][0], sizes[s][1], 1, false);
+			BOOST_REQUIRE(flt.get_mip_level(0, &flt_c));
+			BOOST_REQUIRE(fix.get_mip_level(0, &fix_c));
+			BOOST_CHECK(image::resize(src_c, flt_c, src.get_rect(0), flt.get_rect(0), filters[f]));
+			BOOST_CHECK(image::resize(src_c, fix_c, src.get_rect(0), fix.get_rect(0), filters[f], resample_flag_fixed_point));
+			int max_diff = 0;
+			for(int y = 0; y < fix.get_height(); ++y)
+			{
+				for(int x = 0; x < fix.get_width(); ++x)
+				{
+					const rgba a = flt.get_pixel(0, x, y);
+					const rgba b = fix.get_pixel(0, x, y);
+					max_diff = std::max(max_diff, std::abs(a.r() - b.r()));
+					max_diff = std::max(max_diff, std::abs(a.g() - b.g()));
+					max_diff = std::max(max_diff, std::abs(a.b() - b.b()));
+					max_diff = std::max(max_diff, std::abs(a.a() - b.a()));
+				}
+			}
+			BOOST_CHECK(max_diff <= 2);
+		}
+	}
+	
+	// weights sum to exactly one so a flat image stays exactly flat
+	src.clear(rgba(200, 100, 50, 255), 0);
+	fix.resize_canvas(17, 13, 1, false);
+	BOOST_REQUIRE(fix.get_mip_level(0, &fix_c));
+	BOOST_CHECK(image::resize(src_c, fix_c, src.get_rect(0), fix.get_rect(0), filter_type_lanczos3, resample_flag_fixed_point));
+	for(int y = 0; y < fix.get_height(); ++y)
+		for(int x = 0; x < fix.get_width(); ++x)
+			BOOST_CHECK(fix.get_pixel(0, x, y) == rgba(200, 100, 50, 255));
+}
+
+/// runs the image functions used by test_worker_threads into dst, one result per mip
+void run_threaded_functions(image_rgba32& src, image_rgba32& dst)
+{
+	using namespace tycho;
+	
+	canvas src_c, dst_c;
+	BOOST_REQUIRE(src.get_mip_level(0, &src_c));
+	BOOST_REQUIRE(dst.get_mip_level(0, &dst_c));
+	BOOST_CHECK(image::resize(src_c, dst_c, src.get_rect(0), dst.get_rect(0), filter_type_lanczos3));
+	BOOST_REQUIRE(dst.get_mip_level(1, &dst_c));
+	BOOST_CHECK(image::resize(src_c, dst_c, src.get_rect(0), dst.get_rect(1), filter_type_mitchell, resample_flag_fixed_point));
+	BOOST_REQUIRE(dst.get_mip_level(2, &dst_c));
+	BOOST_CHECK(image::emboss(src_c, dst_c, src.get_rect(0), dst.get_rect(2)));
+	
+	// through a converter and through the generic path
+	image_rgba16 tmp565(image_rgba::pixel_layout_rgb565);
+	image_rgba32 tmp_argb(16, 0xff, 8, 0xff, 0, 0xff, 24, 0xff);
+	tmp565.resize_canvas(dst.get_rect(3).get_width(), dst.get_rect(3).get_height(), 1, false);
+	tmp_argb.resize_canvas(dst.get_rect(3).get_width(), dst.get_rect(3).get_height(), 1, false);
+	canvas tmp565_c, tmp_argb_c;
+	BOOST_REQUIRE(tmp565.get_mip_level(0, &tmp565_c));
+	BOOST_REQUIRE(tmp_argb.get_mip_level(0, &tmp_argb_c));
+	BOOST_REQUIRE(dst.get_mip_level(3, &dst_c));
+	BOOST_CHECK(image::copy(src_c, tmp565_c, tmp565.get_rect(0), math::vector2i(0, 0)));
+	BOOST_CHECK(image::copy(tmp565_c, tmp_argb_c, tmp_argb.get_rect(0), math::vector2i(0, 0)));
+	BOOST_CHECK(image::copy(tmp_argb_c, dst_c, dst.get_rect(3), math::vector2i(0, 0)));
+}
+
+BOOST_AUTO_TEST_CASE(test_worker_threads)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	image_rgba32 src;
+	src.resize_canvas(301, 203, 1, false);
+	for(int y = 0; y < src.get_height(); ++y)
+		for(int x = 0; x < src.get_width(); ++x)
+			src.put_pixel(rgba(x * 7, y * 5, (x * y) >> 4, (x + y) * 3), 0, x, y);
+
+	// output must not depend on the thread count
+	image::set_num_worker_threads(1);
+	BOOST_CHECK(image::get_num_worker_threads() == 1);
+	image_rgba32 ref;
+	ref.resize_canvas(512, 512, 4, false);
+	run_threaded_functions(src, ref);
+	
+	const int counts[] = { 2, 7, 0 };
+	for(int c = 0; c < 3; ++c)
+	{
+		image::set_num_worker_threads(counts[c]);
+		BOOST_CHECK(image::get_num_worker_threads() >= 1);
+		image_rgba32 dst;
+		dst.resize_canvas(512, 512, 4, false);
+		run_threaded_functions(src, dst);
+		for(int m = 0; m < 4; ++m)
+		{
+			canvas a, b;
+			BOOST_REQUIRE(dst.get_mip_level(m, &a));
+			BOOST_REQUIRE(ref.get_mip_level(m, &b));
+			BOOST_CHECK(memcmp(a.get_row(0), b.get_row(0), a.get_pitch() * a.get_height()) == 0);
+		}
+	}
+	image::set_num_worker_threads(0);
+}
+
+/// counts the times each row is run
+class count_rows_task : public tycho::image::detail::row_task
+{
+public:
+	count_rows_task(int count) : m_counts(count) {}
+
+	virtual void run(int begin, int end)
+	{
+		for(int y = begin; y < end; ++y)
+			++m_counts[y];
+	}
+
+	/// \returns true if every row was run once
+	bool each_once() const
+	{
+		for(size_t i = 0; i < m_counts.size(); ++i)
+			if(m_counts[i] != 1)
+				return false;
+		return true;
+	}
+
+private:
+	std::vector<std::atomic<int> > m_counts;
+};
+
+/// resizes the worker pool from inside the task
+class resize_pool_task : public tycho::image::detail::row_task
+{
+public:
+	virtual void run(int, int)
+		{ tycho::image::set_num_worker_threads(2); }
+};
+
+BOOST_AUTO_TEST_CASE(test_worker_restart)
+{
+	using namespace tycho;
+
+	// workers started after the thread count changes wait for the next job rather than 
+	// rerunning the last one
+	const int counts[] = { 2, 1, 3, 2, 4, 1, 0 };
+	for(int c = 0; c < 7; ++c)
+	{
+		image::set_num_worker_threads(counts[c]);
+		for(int job = 0; job < 3; ++job)
+		{
+			count_rows_task task(1000);
+			image::detail::parallel_rows(1000, 1, task);
+			BOOST_CHECK(task.each_once());
+		}
+	}
+
+	// the pool can be resized from another thread while jobs run
+	std::atomic<bool> stop(false);
+	std::thread resizer([&stop]() {
+		for(int i = 0; !stop; ++i)
+			image::set_num_worker_threads(1 + i % 5);
+	});
+	for(int job = 0; job < 200; ++job)
+	{
+		count_rows_task task(257);
+		image::detail::parallel_rows(257, 1, task);
+		BOOST_CHECK(task.each_once());
+	}
+	stop = true;
+	resizer.join();
+
+	// tasks that try to resize the pool are ignored rather than waiting on themselves
+	image::set_num_worker_threads(4);
+	resize_pool_task resize;
+	image::detail::parallel_rows(64, 1, resize);
+	BOOST_CHECK(image::get_num_worker_threads() == 4);
+	image::set_num_worker_threads(0);
+}
+
+BOOST_AUTO_TEST_CASE(test_build_mip_chain)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	// the cascaded box mips must match resizing each level from the one above, the 
+	// sizes cover several tiles, partial tiles and a chain that stops halving exactly
+	const int sizes[][3] = { { 2048, 2048, 9 }, { 200, 136, 5 }, { 300, 20, 3 } };
+	for(int s = 0; s < 3; ++s)
+	{
+		image_base_ptr img(new image_rgba32());
+		image_base_ptr ref(new image_rgba32());
+		img->resize_canvas(sizes[s][0], sizes[s][1], sizes[s][2], false);
+		ref->resize_canvas(sizes[s][0], sizes[s][1], sizes[s][2], false);
+		for(int y = 0; y < sizes[s][1]; ++y)
+		{
+			for(int x = 0; x < sizes[s][0]; ++x)
+			{
+				rgba c(x * 7, y * 5, (x * y) >> 3, (x ^ y) & 0xff);
+				img->put_pixel(c, 0, x, y);
+				ref->put_pixel(c, 0, x, y);
+			}
+		}
+		BOOST_CHECK(build_mip_chain(img, 0, 0));
+		for(int m = 1; m < ref->get_num_mips(); ++m)
+		{
+			canvas src_c, dst_c;
+			BOOST_REQUIRE(ref->get_mip_level(m - 1, &src_c));
+			BOOST_REQUIRE(ref->get_mip_level(m, &dst_c));
+			BOOST_CHECK(image::resize(src_c, dst_c, ref->get_rect(m - 1), ref->get_rect(m), filter_type_box));
+		}
+		for(int m = 0; m < img->get_num_mips(); ++m)
+		{
+			canvas a, b;
+			BOOST_REQUIRE(img->get_mip_level(m, &a));
+			BOOST_REQUIRE(ref->get_mip_level(m, &b));
+			BOOST_CHECK(memcmp(a.get_row(0), b.get_row(0), a.get_pitch() * a.get_height()) == 0);
+		}
+	}
+	
+	// levels smaller than the minimum are left alone
+	{
+		image_base_ptr img(new image_rgba32());
+		img->resize_canvas(64, 64, 4, false);
+		for(int m = 0; m < 4; ++m)
+			img->clear(rgba(0, 0, 0, 0), m);
+		img->clear(rgba(100, 150, 200, 250), 0);
+		BOOST_CHECK(build_mip_chain(img, 16, 16, filter_type_triangle));
+		BOOST_CHECK(img->get_pixel(1, 5, 5) == rgba(100, 150, 200, 250));
+		BOOST_CHECK(img->get_pixel(2, 5, 5) == rgba(100, 150, 200, 250));
+		BOOST_CHECK(img->get_pixel(3, 5, 5) == rgba(0, 0, 0, 0));
+	}
+	
+	BOOST_CHECK(!build_mip_chain(image_base_ptr(new image_rgba32()), 0, 0, filter_type_invalid));
+}
+
+BOOST_AUTO_TEST_CASE(test_srgb)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	// every 8 bit value survives decoding to linear and encoding again
+	{
+		image_base_ptr img(new image_rgba32());
+		img->resize_canvas(256, 16, 3, false);
+		for(int y = 0; y < 16; ++y)
+			for(int x = 0; x < 256; ++x)
+				img->put_pixel(rgba(x & ~1, x & ~1, 255 - (x & ~1), x & ~1), 0, x, y);
+		image_rgba32 dst;
+		dst.resize_canvas(256, 16, 1, false);
+		canvas src_c, dst_c;
+		BOOST_REQUIRE(img->get_mip_level(0, &src_c));
+		BOOST_REQUIRE(dst.get_mip_level(0, &dst_c));
+		BOOST_CHECK(image::resize(src_c, dst_c, img->get_rect(0), dst.get_rect(0), filter_type_box, resample_flag_srgb));
+		BOOST_CHECK(memcmp(src_c.get_row(0), dst_c.get_row(0), src_c.get_pitch() * src_c.get_height()) == 0);
+		
+		// flat blocks stay the same down the mip chain
+		BOOST_CHECK(build_mip_chain(img, 0, 0, filter_type_box, resample_flag_srgb));
+		BOOST_CHECK(img->get_pixel(1, 37, 3) == rgba(74, 74, 181, 74));
+	}
+	
+	// averaging three white and one black in linear light gives sRGB 225 rather than 191, alpha is linear
+	{
+		image_base_ptr img(new image_rgba32());
+		img->resize_canvas(64, 64, 2, false);
+		for(int y = 0; y < 64; ++y)
+			for(int x = 0; x < 64; ++x)
+				img->put_pixel((x & y & 1) ? rgba(0, 0, 0, 0) : rgba(255, 255, 255, 255), 0, x, y);
+		BOOST_CHECK(build_mip_chain(img, 0, 0, filter_type_box, resample_flag_srgb));
+		BOOST_CHECK(img->get_pixel(1, 9, 17) == rgba(225, 225, 225, 191));
+		
+		image_rgba32 dst;
+		dst.resize_canvas(32, 32, 1, false);
+		canvas src_c, dst_c;
+		BOOST_REQUIRE(img->get_mip_level(0, &src_c));
+		BOOST_REQUIRE(dst.get_mip_level(0, &dst_c));
+		BOOST_CHECK(image::resize(src_c, dst_c, img->get_rect(0), dst.get_rect(0), filter_type_box, resample_flag_srgb | resample_flag_fixed_point));
+		BOOST_CHECK(dst.get_pixel(0, 9, 17) == rgba(225, 225, 225, 191));
+		BOOST_CHECK(build_mip_chain(img, 0, 0, filter_type_box));
+		BOOST_CHECK(img->get_pixel(1, 9, 17) == rgba(191, 191, 191, 191));
+	}
+	
+	// gamma_correct encodes every mip from linear to sRGB
+	{
+		image_base_ptr img(new image_rgba32());
+		img->resize_canvas(16, 16, 2, false);
+		img->clear(rgba(0, 128, 255, 64), 0);
+		img->clear(rgba(64, 64, 64, 64), 1);
+		BOOST_CHECK(gamma_correct(img));
+		BOOST_CHECK(img->get_pixel(0, 3, 3) == rgba(0, 188, 255, 64));
+		BOOST_CHECK(img->get_pixel(1, 3, 3) == rgba(137, 137, 137, 64));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_dxtn)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+
+	// full mip chain down to 1x1, every level padded to whole blocks
+	{
+		image_dxtn img(image_dxtn::dxtn_type_dxt1);
+		BOOST_REQUIRE(img.resize_canvas(20, 12, 16, false));
+		BOOST_CHECK(img.get_num_mips() == 5);
+		BOOST_CHECK(img.get_rect(4).get_width() == 1 && img.get_rect(4).get_height() == 1);
+		BOOST_CHECK(img.get_blocks_wide(0) == 5 && img.get_blocks_high(0) == 3);
+		BOOST_CHECK(img.get_mip_byte_size(0) == 5 * 3 * 8);
+		BOOST_CHECK(img.get_mip_byte_size(4) == 8);
+		BOOST_CHECK(img.get_stride() == 5 * 8);
+	}
+	
+	// solid colours representable in 565 survive a clear, blocks can be copied in raw
+	{
+		image_dxtn img(image_dxtn::dxtn_type_dxt5);
+		BOOST_REQUIRE(img.resize_canvas(16, 16, 1, false));
+		img.clear(rgba(255, 0, 132, 77), 0);
+		BOOST_CHECK(img.get_pixel(0, 13, 6) == rgba(255, 0, 132, 77));
+		
+		image_dxtn dst(image_dxtn::dxtn_type_dxt5);
+		BOOST_REQUIRE(dst.resize_canvas(16, 16, 1, false));
+		dst.clear(rgba(0, 0, 0, 0), 0);
+		BOOST_CHECK(dst.raw_copy(0, 4, 8, 8, 4, img.get_blocks(0), 2 * 16));
+		BOOST_CHECK(!dst.raw_copy(0, 2, 8, 8, 4, img.get_blocks(0), 2 * 16));
+		BOOST_CHECK(dst.get_pixel(0, 11, 9) == rgba(255, 0, 132, 77));
+		BOOST_CHECK(dst.get_pixel(0, 3, 9) == rgba(0, 0, 0, 0));
+		
+		dst.put_pixel(rgba(0, 255, 0, 255), 0, 2, 2);
+		BOOST_CHECK(dst.get_pixel(0, 2, 2) == rgba(0, 255, 0, 255));
+		BOOST_CHECK(dst.get_pixel(0, 1, 2) == rgba(0, 0, 0, 0));
+	}
+	
+	// smooth gradients compress to within a few steps in each scheme
+	const image_dxtn::dxtn_type types[] = { image_dxtn::dxtn_type_dxt1, image_dxtn::dxtn_type_dxt3, image_dxtn::dxtn_type_dxt5 };
+	for(int t = 0; t < 3; ++t)
+	{
+		image_rgba32 src;
+		src.resize_canvas(30, 18, 1, false);
+		for(int y = 0; y < 18; ++y)
+			for(int x = 0; x < 30; ++x)
+				src.put_pixel(rgba(x * 8, 64 + x * 4, 240 - x * 8, 255 - y * 6), 0, x, y);
+		image_dxtn img(types[t]);
+		BOOST_REQUIRE(img.resize_canvas(30, 18, 1, false));
+		canvas src_c, dst_c;
+		BOOST_REQUIRE(src.get_mip_level(0, &src_c));
+		BOOST_REQUIRE(img.get_mip_level(0, &dst_c));
+		BOOST_CHECK(image::copy(src_c, dst_c, src.get_rect(0), math::vector2i(0, 0)));
+		
+		int max_diff = 0;
+		for(int y = 0; y < 18; ++y)
+		{
+			for(int x = 0; x < 30; ++x)
+			{
+				const rgba a = src.get_pixel(0, x, y);
+				const rgba b = img.get_pixel(0, x, y);
+				const int alpha_diff = types[t] == image_dxtn::dxtn_type_dxt1 ? 0 : std::abs(a.a() - b.a());
+				max_diff = std::max(max_diff, std::max(std::abs(a.r() - b.r()), alpha_diff));
+				max_diff = std::max(max_diff, std::max(std::abs(a.g() - b.g()), std::abs(a.b() - b.b())));
+			}
+		}
+		BOOST_CHECK(max_diff <= 12);
+		
+		// matching schemes copy blocks unchanged
+		image_dxtn dst(types[t]);
+		BOOST_REQUIRE(dst.resize_canvas(30, 18, 1, false));
+		canvas copy_c;
+		BOOST_REQUIRE(dst.get_mip_level(0, &copy_c));
+		BOOST_CHECK(image::copy(dst_c, copy_c, img.get_rect(0), math::vector2i(0, 0)));
+		BOOST_CHECK(memcmp(img.get_blocks(0), dst.get_blocks(0), img.get_mip_byte_size(0)) == 0);
+	}
+	
+	// each quality tier is no worse than the one before and the blocks don't depend on the thread count
+	{
+		image_rgba32 src;
+		src.resize_canvas(64, 64, 1, false);
+		unsigned int seed = 1;
+		for(int y = 0; y < 64; ++y)
+		{
+			for(int x = 0; x < 64; ++x)
+			{
+				seed = seed * 1103515245 + 12345;
+				const int n = (seed >> 16) & 63;
+				src.put_pixel(rgba(x * 3 + n, (x + y) * 2 + n / 2, 255 - y * 3 - n, (x * y) & 255), 0, x, y);
+			}
+		}
+		canvas src_c;
+		BOOST_REQUIRE(src.get_mip_level(0, &src_c));
+		
+		int errors[3];
+		std::vector<core::uint8> blocks[3];
+		for(int q = 0; q < 3; ++q)
+		{
+			image_dxtn img(image_dxtn::dxtn_type_dxt5);
+			img.set_quality(static_cast<image_dxtn::dxtn_quality>(q));
+			BOOST_REQUIRE(img.resize_canvas(64, 64, 1, false));
+			canvas dst_c;
+			BOOST_REQUIRE(img.get_mip_level(0, &dst_c));
+			BOOST_CHECK(image::copy(src_c, dst_c, src.get_rect(0), math::vector2i(0, 0)));
+			errors[q] = 0;
+			for(int y = 0; y < 64; ++y)
+			{
+				for(int x = 0; x < 64; ++x)
+				{
+					const rgba a = src.get_pixel(0, x, y);
+					const rgba b = img.get_pixel(0, x, y);
+					const int d[4] = { a.r() - b.r(), a.g() - b.g(), a.b() - b.b(), a.a() - b.a() };
+					errors[q] += d[0] * d[0] + d[1] * d[1] + d[2] * d[2] + d[3] * d[3];
+				}
+			}
+			blocks[q].assign(img.get_blocks(0), img.get_blocks(0) + img.get_mip_byte_size(0));
+			
+			image::set_num_worker_threads(1);
+			BOOST_CHECK(image::copy(src_c, dst_c, src.get_rect(0), math::vector2i(0, 0)));
+			image::set_num_worker_threads(0);
+			BOOST_CHECK(memcmp(img.get_blocks(0), &blocks[q][0], blocks[q].size()) == 0);
+		}
+		BOOST_CHECK(errors[1] < errors[0]);
+		BOOST_CHECK(errors[2] <= errors[1]);
+	}
+	
+	// decoding rows of blocks into rgba images matches decoding a pixel at a time, for rgba8888
+	// destinations, ones with a row converter and unaligned rectangles
+	const image_dxtn::dxtn_type all_types[] = { image_dxtn::dxtn_type_dxt1, image_dxtn::dxtn_type_dxt3, image_dxtn::dxtn_type_dxt5, 
+												image_dxtn::dxtn_type_bc4, image_dxtn::dxtn_type_bc5 };
+	for(int t = 0; t < 5; ++t)
+	{
+		image_rgba32 src;
+		src.resize_canvas(37, 29, 1, false);
+		for(int y = 0; y < 29; ++y)
+			for(int x = 0; x < 37; ++x)
+				src.put_pixel(rgba(x * 7, 200 - y * 5, (x * y) & 255, x < 5 ? 0 : 255 - x * 3), 0, x, y);
+		image_dxtn img(all_types[t]);
+		BOOST_REQUIRE(img.resize_canvas(37, 29, 1, false));
+		canvas src_c, img_c;
+		BOOST_REQUIRE(src.get_mip_level(0, &src_c));
+		BOOST_REQUIRE(img.get_mip_level(0, &img_c));
+		BOOST_CHECK(image::copy(src_c, img_c, src.get_rect(0), math::vector2i(0, 0)));
+		if(all_types[t] == image_dxtn::dxtn_type_bc4 || all_types[t] == image_dxtn::dxtn_type_bc5)
+		{
+			const rgba p = img.get_pixel(0, 10, 3);
+			BOOST_CHECK(std::abs(p.r() - 70) <= 2);
+			BOOST_CHECK(p.g() == (all_types[t] == image_dxtn::dxtn_type_bc5 ? 185 : 0));
+			BOOST_CHECK(p.b() == 0 && p.a() == 255);
+		}
+		
+		image_rgba32 dst32;
+		image_rgba16 dst16, ref16;
+		dst32.resize_canvas(40, 30, 1, false);
+		dst16.resize_canvas(40, 30, 1, false);
+		ref16.resize_canvas(40, 30, 1, false);
+		canvas dst32_c, dst16_c;
+		BOOST_REQUIRE(dst32.get_mip_level(0, &dst32_c));
+		BOOST_REQUIRE(dst16.get_mip_level(0, &dst16_c));
+		BOOST_CHECK(image::copy(img_c, dst32_c, img.get_rect(0), math::vector2i(0, 0)));
+		BOOST_CHECK(image::copy(img_c, dst16_c, math::recti(3, 5, 34, 27), math::vector2i(1, 2)));
+		
+		bool same = true;
+		for(int y = 0; y < 29; ++y)
+		{
+			for(int x = 0; x < 37; ++x)
+			{
+				same = same && dst32.get_pixel(0, x, y) == img.get_pixel(0, x, y);
+				if(x >= 3 && x < 34 && y >= 5 && y < 27)
+				{
+					ref16.put_pixel(img.get_pixel(0, x, y), 0, x - 2, y - 3);
+					same = same && dst16.get_pixel(0, x - 2, y - 3) == ref16.get_pixel(0, x - 2, y - 3);
+				}
+			}
+		}
+		BOOST_CHECK(same);
+	}
+	
+	// dxt1 keeps one bit alpha as transparent black
+	{
+		image_dxtn img(image_dxtn::dxtn_type_dxt1);
+		BOOST_REQUIRE(img.resize_canvas(4, 4, 1, false));
+		rgba row[4] = { rgba(200, 10, 10, 255), rgba(200, 10, 10, 20), rgba(40, 90, 10, 255), rgba(40, 90, 10, 255) };
+		img.write_row(row, 0, 0, 0, 4);
+		img.flush();
+		BOOST_CHECK(img.get_pixel(0, 1, 0) == rgba(0, 0, 0, 0));
+		BOOST_CHECK(img.get_pixel(0, 0, 0).a() == 255);
+		BOOST_CHECK(img.get_pixel(0, 3, 0).a() == 255);
+	}
+	
+	// rows written one at a time are encoded once, as a block copy would, and read back as
+	// written until then
+	{
+		image_base_ptr src(new image_rgba32());
+		BOOST_REQUIRE(src->resize_canvas(37, 23, 1, false));
+		for(int y = 0; y < 23; ++y)
+			for(int x = 0; x < 37; ++x)
+				src->put_pixel(rgba(x * 7, y * 11, (x * y) & 0xff, 255 - x), 0, x, y);
+		image_base_ptr copied(new image_dxtn(image_dxtn::dxtn_type_dxt5));
+		image_base_ptr by_row(new image_dxtn(image_dxtn::dxtn_type_dxt5));
+		BOOST_REQUIRE(copied->resize_canvas(37, 23, 1, false) && by_row->resize_canvas(37, 23, 1, false));
+		BOOST_REQUIRE(image::copy(src, copied));
+		std::vector<rgba> row(37);
+		for(int y = 0; y < 23; ++y)
+		{
+			src->read_row(0, 0, y, 37, &row[0]);
+			by_row->write_row(&row[0], 0, 0, y, 37);
+			if(y == 9)
+				BOOST_CHECK(by_row->get_pixel(0, 36, 9) == src->get_pixel(0, 36, 9));
+		}
+		image_dxtn& a = static_cast<image_dxtn&>(*copied);
+		image_dxtn& b = static_cast<image_dxtn&>(*by_row);
+		BOOST_CHECK(memcmp(a.get_blocks(0), b.get_blocks(0), a.get_mip_byte_size(0)) == 0);
+		
+		// resizes write a row at a time from several threads
+		image_rgba32 half;
+		image_dxtn half_dxtn(image_dxtn::dxtn_type_dxt5), half_ref(image_dxtn::dxtn_type_dxt5);
+		BOOST_REQUIRE(half.resize_canvas(19, 12, 1, false) && half_dxtn.resize_canvas(19, 12, 1, false) && half_ref.resize_canvas(19, 12, 1, false));
+		canvas src_c, half_c, half_dxtn_c, half_ref_c;
+		BOOST_REQUIRE(src->get_mip_level(0, &src_c) && half.get_mip_level(0, &half_c));
+		BOOST_REQUIRE(half_dxtn.get_mip_level(0, &half_dxtn_c) && half_ref.get_mip_level(0, &half_ref_c));
+		BOOST_REQUIRE(image::resize(src_c, half_c, src->get_rect(0), half.get_rect(0), filter_type_lanczos3));
+		BOOST_REQUIRE(image::resize(src_c, half_dxtn_c, src->get_rect(0), half_dxtn.get_rect(0), filter_type_lanczos3));
+		BOOST_REQUIRE(image::copy(half_c, half_ref_c, half.get_rect(0), math::vector2i(0, 0)));
+		BOOST_CHECK(memcmp(half_dxtn.get_blocks(0), half_ref.get_blocks(0), half_ref.get_mip_byte_size(0)) == 0);
+		
+		// preserving resizes keep the blocks in common, pending rows included, and allocate 
+		// through the image allocator
+		pixel_pool pool(1 << 20);
+		image_dxtn grown(image_dxtn::dxtn_type_dxt5);
+		grown.set_allocator(pool);
+		BOOST_REQUIRE(grown.resize_canvas(37, 23, 1, false));
+		memcpy(grown.get_blocks(0), a.get_blocks(0), a.get_mip_byte_size(0));
+		std::vector<rgba> red(37, rgba(255, 0, 0, 255));
+		grown.write_row(&red[0], 0, 0, 0, 37);
+		BOOST_REQUIRE(grown.resize_canvas(41, 20, 1, true));
+		bool kept = true;
+		for(int y = 4; y < 20; ++y)
+			for(int x = 0; x < 37; ++x)
+				kept = kept && grown.get_pixel(0, x, y) == a.get_pixel(0, x, y);
+		BOOST_CHECK(kept);
+		BOOST_CHECK(grown.get_pixel(0, 5, 0) == rgba(255, 0, 0, 255));
+		BOOST_CHECK(grown.get_capacity() == grown.get_mip_byte_size(0));
+		BOOST_REQUIRE(grown.resize_canvas(4, 4, 1, false));
+		BOOST_CHECK(pool.get_cached_bytes() > 0);
+	}
+}
+
+/// writes a dds header for a single 2d surface
+static void write_dds_header(tycho::core::uint8* dst, int width, int height, int num_mips, int pf_flags, const char* fourcc, int bit_count, 
+							 tycho::core::uint32 rmask, tycho::core::uint32 gmask, tycho::core::uint32 bmask, tycho::core::uint32 amask)
+{
+	using namespace tycho;
+	const core::uint32 fields[][2] = {
+		{ 4, 124 }, { 8, 0x1007u | (num_mips > 1 ? 0x20000u : 0u) }, { 12, (core::uint32)height }, { 16, (core::uint32)width }, 
+		{ 28, (core::uint32)num_mips }, { 76, 32 }, { 80, (core::uint32)pf_flags }, { 88, (core::uint32)bit_count }, 
+		{ 92, rmask }, { 96, gmask }, { 100, bmask }, { 104, amask }, { 108, 0x1000 } 
+	};
+	memset(dst, 0, 128);
+	memcpy(dst, "DDS ", 4);
+	for(size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i)
+		for(int b = 0; b < 4; ++b)
+			dst[fields[i][0] + b] = (core::uint8)(fields[i][1] >> (b * 8));
+	if(fourcc)
+		memcpy(dst + 84, fourcc, 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_dds_load)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+	
+	BOOST_CHECK(format_dds::identify("DDS |", 5));
+	BOOST_CHECK(!format_dds::identify("\x89PNG", 4));
+	
+	// 32 bit bgra as saved, loaded from a stream and as a view over the file bytes
+	{
+		image_base_ptr img(new image_rgba32());
+		img->resize_canvas(64, 32, 3, false);
+		for(int m = 0; m < 3; ++m)
+			for(int y = 0; y < (32 >> m); ++y)
+				for(int x = 0; x < (64 >> m); ++x)
+					img->put_pixel(rgba(x * 4, y * 8, m * 50, 255 - x), m, x, y);
+		std::vector<char> file(128 + 4 * (64 * 32 + 32 * 16 + 16 * 8));
+		io::memory_stream ostr(&file[0], (int)file.size());
+		BOOST_REQUIRE(format_dds::save(img, ostr));
+		
+		io::memory_stream istr(&file[0], (int)file.size());
+		image_base_ptr loaded = format_dds::load(istr);
+		image_base_ptr view = format_dds::load((core::uint8*)&file[0], (int)file.size());
+		BOOST_REQUIRE(loaded && view);
+		BOOST_CHECK(loaded->get_num_mips() == 3 && view->get_num_mips() == 3);
+		bool same = true;
+		for(int m = 0; m < 3; ++m)
+		{
+			for(int y = 0; y < (32 >> m); ++y)
+			{
+				for(int x = 0; x < (64 >> m); ++x)
+				{
+					same = same && loaded->get_pixel(m, x, y) == img->get_pixel(m, x, y);
+					same = same && view->get_pixel(m, x, y) == img->get_pixel(m, x, y);
+				}
+			}
+		}
+		BOOST_CHECK(same);
+		canvas c;
+		BOOST_REQUIRE(view->get_mip_level(0, &c));
+		BOOST_CHECK(c.get_pixels() == (core::uint8*)&file[128]);
+		BOOST_CHECK(!format_dds::load((core::uint8*)&file[0], (int)file.size() - 1));
+	}
+	
+	// little endian 565 has green spanning bytes so is byte reversed into the image
+	{
+		std::vector<core::uint8> file(128 + 8 * 8 * 2);
+		write_dds_header(&file[0], 8, 8, 1, 0x40, 0, 16, 0xf800, 0x07e0, 0x001f, 0);
+		for(int i = 0; i < 64; ++i)
+		{
+			file[128 + i * 2] = 0xe0;
+			file[128 + i * 2 + 1] = 0xf8;
+		}
+		image_base_ptr img = format_dds::load(&file[0], (int)file.size());
+		BOOST_REQUIRE(img);
+		BOOST_CHECK(img->get_image_format() == image_format_rgba16);
+		BOOST_CHECK(img->get_pixel(0, 5, 3) == rgba(0x1f, 0x07, 0, 255));
+		canvas c;
+		BOOST_REQUIRE(img->get_mip_level(0, &c));
+		BOOST_CHECK(c.get_pixels() != &file[128]);
+	}
+	
+	// block compressed files keep the whole chain down to 1x1
+	{
+		image_dxtn src(image_dxtn::dxtn_type_dxt1);
+		BOOST_REQUIRE(src.resize_canvas(8, 8, 4, false));
+		std::vector<core::uint8> file(128);
+		write_dds_header(&file[0], 8, 8, 4, 0x4, "DXT1", 0, 0, 0, 0, 0);
+		for(int m = 0; m < 4; ++m)
+		{
+			src.clear(rgba(m * 80, 0, 255, 255), m);
+			file.insert(file.end(), src.get_blocks(m), src.get_blocks(m) + src.get_mip_byte_size(m));
+		}
+		image_base_ptr img = format_dds::load(&file[0], (int)file.size());
+		BOOST_REQUIRE(img);
+		BOOST_REQUIRE(img->get_image_format() == image_format_dxtn);
+		BOOST_CHECK(img->get_num_mips() == 4);
+		BOOST_CHECK(img->get_pixel(3, 0, 0) == rgba(239, 0, 255, 255));
+		BOOST_CHECK(static_cast<image_dxtn&>(*img).get_blocks(0) == &file[128]);
+		
+		write_dds_header(&file[0], 8, 8, 4, 0x4, "DXT9", 0, 0, 0, 0, 0);
+		BOOST_CHECK(!format_dds::load(&file[0], (int)file.size()));
+	}
+	
+	// surfaces too big for int sizes are rejected rather than wrapping past the length check
+	{
+		std::vector<core::uint8> file(128 + 1024);
+		const int sizes[][2] = { { 0x8000, 0x8000 }, { 0x8000, 0x4000 } };
+		for(int i = 0; i < 2; ++i)
+		{
+			write_dds_header(&file[0], sizes[i][0], sizes[i][1], 1, 0x41, 0, 32, 0xff0000, 0xff00, 0xff, 0xff000000);
+			BOOST_CHECK(!format_dds::load(&file[0], (int)file.size()));
+			BOOST_CHECK(!format_dds::load_array(&file[0], (int)file.size()));
+			io::memory_stream str((char*)&file[0], (int)file.size());
+			BOOST_CHECK(!format_dds::load(str));
+		}
+		
+		// a volume whose file fits but whose layers held at full size don't
+		write_dds_header(&file[0], 0x1000, 0x1000, 13, 0x41, 0, 32, 0xff0000, 0xff00, 0xff, 0xff000000);
+		file[10] |= 0x80;			// DDSD_DEPTH
+		file[24] = 25;				// depth
+		file[114] = 0x20;			// DDSCAPS2_VOLUME
+		io::memory_stream str((char*)&file[0], (int)file.size());
+		BOOST_CHECK(!format_dds::load_array(str));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_dds_save_native)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+	
+	// each layout is written as it is, 565 has green spanning bytes so is byte reversed. Grey
+	// is written as luminance.
+	struct layout_case
+	{
+		image_base_ptr img;
+		int bit_count;
+		core::uint32 flags, rmask, amask;
+		bool swapped;
+	} cases[] = {
+		{ image_base_ptr(new image_rgba32(image_rgba::pixel_layout_bgra8888)), 32, 0x41, 0x00ff0000, 0xff000000, false },
+		{ image_base_ptr(new image_rgba32(image_rgba::pixel_layout_rgba8888)), 32, 0x41, 0x000000ff, 0xff000000, false },
+		{ image_base_ptr(new image_rgb24(image_rgba::pixel_layout_bgr888)), 24, 0x40, 0x00ff0000, 0, false },
+		{ image_base_ptr(new image_rgba16(image_rgba::pixel_layout_rgb565)), 16, 0x40, 0xf800, 0, true },
+		{ image_base_ptr(new image_a8(image_rgba::pixel_layout_a8)), 8, 0x2, 0, 0xff, false },
+		{ image_base_ptr(new image_a8(image_rgba::pixel_layout_l8)), 8, 0x20000, 0xff, 0, false },
+		{ image_base_ptr(new image_rgba16(image_rgba::pixel_layout_la88)), 16, 0x20001, 0xff, 0xff00, false }
+	};
+	for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+	{
+		image_base_ptr img = cases[i].img;
+		BOOST_REQUIRE(img->resize_canvas(32, 16, 2, false));
+		for(int m = 0; m < 2; ++m)
+			for(int y = 0; y < (16 >> m); ++y)
+				for(int x = 0; x < (32 >> m); ++x)
+					img->put_pixel(rgba(x * 8, y * 16, m * 100, 255 - x * 4), m, x, y);
+		const int bpp = cases[i].bit_count / 8;
+		const int pixel_bytes = (32 * 16 + 16 * 8) * bpp;
+		std::vector<char> file(128 + pixel_bytes);
+		io::memory_stream ostr(&file[0], (int)file.size());
+		BOOST_REQUIRE(format_dds::save(img, ostr));
+		
+		core::uint32 flags, bit_count, rmask, gmask, amask;
+		memcpy(&flags, &file[80], 4);
+		memcpy(&bit_count, &file[88], 4);
+		memcpy(&rmask, &file[92], 4);
+		memcpy(&gmask, &file[96], 4);
+		memcpy(&amask, &file[104], 4);
+		BOOST_CHECK(flags == cases[i].flags);
+		BOOST_CHECK(bit_count == (core::uint32)cases[i].bit_count);
+		BOOST_CHECK(rmask == cases[i].rmask && amask == cases[i].amask);
+
+		canvas c;
+		BOOST_REQUIRE(img->get_mip_level(0, &c));
+		BOOST_CHECK((memcmp(&file[128], c.get_pixels(), c.get_byte_size()) == 0) == !cases[i].swapped);
+		
+		image_base_ptr loaded = format_dds::load((core::uint8*)&file[0], (int)file.size());
+		BOOST_REQUIRE(loaded);
+		BOOST_CHECK(loaded->get_image_format() == img->get_image_format());
+		BOOST_CHECK(static_cast<image_rgba&>(*loaded).get_pixel_layout() == static_cast<image_rgba&>(*img).get_pixel_layout());
+		bool same = loaded->get_num_mips() == 2;
+		for(int m = 0; m < 2 && same; ++m)
+			for(int y = 0; y < (16 >> m); ++y)
+				for(int x = 0; x < (32 >> m); ++x)
+					same = same && loaded->get_pixel(m, x, y) == img->get_pixel(m, x, y);
+		BOOST_CHECK(same);
+		
+		// grey written as rgb with the same mask in each channel loads the same
+		if(flags & 0x20000)
+		{
+			BOOST_CHECK(gmask == 0);
+			flags = (flags & ~0x20000u) | 0x40;
+			memcpy(&file[80], &flags, 4);
+			memcpy(&file[96], &rmask, 4);
+			memcpy(&file[100], &rmask, 4);
+			image_base_ptr rgb = format_dds::load((core::uint8*)&file[0], (int)file.size());
+			BOOST_REQUIRE(rgb);
+			BOOST_CHECK(static_cast<image_rgba&>(*rgb).get_pixel_layout() == static_cast<image_rgba&>(*img).get_pixel_layout());
+			BOOST_CHECK(rgb->get_pixel(1, 3, 2) == img->get_pixel(1, 3, 2));
+		}
+	}
+	
+	// block compressed images are written as their blocks
+	image_dxtn::dxtn_type types[] = { image_dxtn::dxtn_type_dxt1, image_dxtn::dxtn_type_dxt3, image_dxtn::dxtn_type_dxt5, image_dxtn::dxtn_type_bc5 };
+	for(size_t t = 0; t < sizeof(types) / sizeof(types[0]); ++t)
+	{
+		image_base_ptr img(new image_dxtn(types[t]));
+		BOOST_REQUIRE(img->resize_canvas(16, 8, 5, false));
+		image_dxtn& dxtn = static_cast<image_dxtn&>(*img);
+		std::vector<char> file(128);
+		for(int m = 0; m < 5; ++m)
+		{
+			img->clear(rgba(m * 60, 255 - m * 60, 128, 255), m);
+			file.resize(file.size() + dxtn.get_mip_byte_size(m));
+		}
+		io::memory_stream ostr(&file[0], (int)file.size());
+		BOOST_REQUIRE(format_dds::save(img, ostr));
+		BOOST_CHECK(memcmp(&file[128], dxtn.get_blocks(0), file.size() - 128) == 0);
+		
+		image_base_ptr loaded = format_dds::load((core::uint8*)&file[0], (int)file.size());
+		BOOST_REQUIRE(loaded && loaded->get_image_format() == image_format_dxtn);
+		BOOST_CHECK(static_cast<image_dxtn&>(*loaded).get_dxtn_type() == types[t]);
+		BOOST_CHECK(loaded->get_num_mips() == 5);
+		
+		// a single level is saved on its own
+		std::vector<char> level(128 + dxtn.get_mip_byte_size(2));
+		io::memory_stream lstr(&level[0], (int)level.size());
+		BOOST_REQUIRE(format_dds::save(img, 2, lstr));
+		loaded = format_dds::load((core::uint8*)&level[0], (int)level.size());
+		BOOST_REQUIRE(loaded);
+		BOOST_CHECK(loaded->get_width() == 4 && loaded->get_height() == 2 && loaded->get_num_mips() == 1);
+		BOOST_CHECK(loaded->get_pixel(0, 1, 1) == img->get_pixel(2, 1, 1));
+	}
+}
+
+/// \returns true if every pixel of every level the layers of both arrays hold match
+static bool same_layers(tycho::image::image_array& a, tycho::image::image_array& b)
+{
+	if(a.get_num_layers() != b.get_num_layers() || a.get_num_mips() != b.get_num_mips())
+		return false;
+	for(int m = 0; m < a.get_num_mips(); ++m)
+	{
+		for(int i = 0; i < a.get_num_layers(m); ++i)
+		{
+			tycho::image::image_base_ptr la = a.get_layer(i), lb = b.get_layer(i);
+			const int w = std::max(a.get_width() >> m, 1), h = std::max(a.get_height() >> m, 1);
+			for(int y = 0; y < h; ++y)
+				for(int x = 0; x < w; ++x)
+					if(!(la->get_pixel(m, x, y) == lb->get_pixel(m, x, y)))
+						return false;
+		}
+	}
+	return true;
+}
+
+BOOST_AUTO_TEST_CASE(test_dds_arrays)
+{
+	using namespace tycho;
+	using namespace tycho::core;
+	
+	// cube maps have a legacy header and load as views over the file
+	{
+		image_array_ptr cube(new image_array(image_array::array_type_cube));
+		for(int f = 0; f < image_array::cube_face_count; ++f)
+		{
+			image_base_ptr face(new image_rgba32(image_rgba::pixel_layout_bgra8888));
+			face->resize_canvas(16, 16, 2, false);
+			face->clear(rgba(f * 40, 255 - f * 40, 7, 255), 0);
+			face->clear(rgba(f * 20, 0, 99, 128), 1);
+			face->put_pixel(rgba(1, 2, 3, 4), 0, f, f);
+			BOOST_REQUIRE(cube->add_layer(face));
+		}
+		image_base_ptr odd(new image_rgba32(image_rgba::pixel_layout_bgra8888));
+		odd->resize_canvas(8, 8, 1, false);
+		BOOST_CHECK(!cube->add_layer(odd));
+		BOOST_CHECK(cube->is_complete_cube());
+		
+		std::vector<char> file(128 + 6 * 4 * (16 * 16 + 8 * 8));
+		io::memory_stream ostr(&file[0], (int)file.size());
+		BOOST_REQUIRE(format_dds::save_array(cube, ostr));
+		core::uint32 caps2;
+		memcpy(&caps2, &file[112], 4);
+		BOOST_CHECK(caps2 == 0xfe00);
+		BOOST_CHECK(!format_dds::load((core::uint8*)&file[0], (int)file.size()));
+		
+		image_array_ptr loaded = format_dds::load_array((core::uint8*)&file[0], (int)file.size());
+		BOOST_REQUIRE(loaded);
+		BOOST_CHECK(loaded->get_array_type() == image_array::array_type_cube);
+		BOOST_CHECK(same_layers(*cube, *loaded));
+		canvas c;
+		BOOST_REQUIRE(loaded->get_mip_level(image_array::cube_face_negative_y, 0, &c));
+		BOOST_CHECK(c.get_pixels() == (core::uint8*)&file[128 + 3 * 4 * (16 * 16 + 8 * 8)]);
+		BOOST_CHECK(loaded->get_face(image_array::cube_face_negative_y)->get_pixel(0, 3, 3) == rgba(1, 2, 3, 4));
+		
+		// a cube missing a face isn't loaded
+		file[113] = 0x7e;
+		BOOST_CHECK(!format_dds::load_array((core::uint8*)&file[0], (int)file.size()));
+	}
+	
+	// arrays of block compressed images have a DX10 header
+	{
+		image_array_ptr arr(new image_array(image_array::array_type_2d));
+		int blocks_size = 0;
+		for(int i = 0; i < 3; ++i)
+		{
+			image_base_ptr layer(new image_dxtn(image_dxtn::dxtn_type_dxt5));
+			layer->resize_canvas(8, 8, 4, false);
+			for(int m = 0; m < 4; ++m)
+				layer->clear(rgba(i * 100, m * 60, 30, 200 - m * 50), m);
+			BOOST_REQUIRE(arr->add_layer(layer));
+			for(int m = 0; m < 4; ++m)
+				blocks_size += static_cast<image_dxtn&>(*layer).get_mip_byte_size(m);
+		}
+		std::vector<char> file(128 + 20 + blocks_size);
+		io::memory_stream ostr(&file[0], (int)file.size());
+		BOOST_REQUIRE(format_dds::save_array(arr, ostr));
+		BOOST_CHECK(memcmp(&file[84], "DX10", 4) == 0);
+		core::uint32 dxgi_format, array_size;
+		memcpy(&dxgi_format, &file[128], 4);
+		memcpy(&array_size, &file[140], 4);
+		BOOST_CHECK(dxgi_format == 77 && array_size == 3);
+		
+		io::memory_stream istr(&file[0], (int)file.size());
+		image_array_ptr loaded = format_dds::load_array(istr);
+		BOOST_REQUIRE(loaded);
+		BOOST_CHECK(loaded->get_image_format() == image_format_dxtn);
+		BOOST_CHECK(same_layers(*arr, *loaded));
+		BOOST_CHECK(memcmp(static_cast<image_dxtn&>(*loaded->get_layer(2)).get_blocks(0), 
+						   static_cast<image_dxtn&>(*arr->get_layer(2)).get_blocks(0), blocks_size / 3) == 0);
+		
+		// the storage is aligned and outlives the array while a layer is held
+		image_base_ptr layer = loaded->get_layer(2);
+		const core::uint8* blocks = static_cast<image_dxtn&>(*layer).get_blocks(0);
+		BOOST_CHECK((reinterpret_cast<size_t>(static_cast<image_dxtn&>(*loaded->get_layer(0)).get_blocks(0)) & (pixel_allocator::Alignment - 1)) == 0);
+		loaded.reset();
+		BOOST_CHECK(memcmp(blocks, static_cast<image_dxtn&>(*arr->get_layer(2)).get_blocks(0), blocks_size / 3) == 0);
+	}
+	
+	// storage comes from the allocator and goes back once the array and its views are gone
+	{
+		pixel_pool pool(1 << 20);
+		image_base_ptr view;
+		{
+			image_array storage_arr(image_array::array_type_2d);
+			core::uint8* pixels = storage_arr.allocate_storage(2 * 16 * 16 * 4, pool);
+			BOOST_REQUIRE(pixels);
+			view = storage_arr.share_storage(new image_rgba32());
+			BOOST_REQUIRE(view->create_view(16, 16, 1, pixels + 16 * 16 * 4));
+			BOOST_REQUIRE(storage_arr.add_layer(view));
+			view->clear(rgba(1, 2, 3, 4), 0);
+		}
+		BOOST_CHECK(pool.get_cached_bytes() == 0);
+		BOOST_CHECK(view->get_pixel(0, 15, 15) == rgba(1, 2, 3, 4));
+		view.reset();
+		BOOST_CHECK(pool.get_cached_bytes() == 2 * 16 * 16 * 4);
+	}
+	
+	// arrays of more than 2048 elements or cubes and volumes deeper than 2048 are refused, not 
+	// truncated
+	{
+		const core::uint32 dx10_cases[][3] = { { 0, 2048, 1 }, { 0, 2049, 0 }, { 4, 2048, 1 }, { 4, 2049, 0 } };
+		for(int i = 0; i < 4; ++i)
+		{
+			const int num_layers = dx10_cases[i][1] * (dx10_cases[i][0] ? image_array::cube_face_count : 1);
+			std::vector<core::uint8> file(148 + num_layers * 8);
+			write_dds_header(&file[0], 1, 1, 1, 0x4, "DX10", 0, 0, 0, 0, 0);
+			const core::uint32 dx10[] = { 71, 3, dx10_cases[i][0], dx10_cases[i][1], 0 };
+			memcpy(&file[128], dx10, sizeof(dx10));
+			BOOST_CHECK(!!format_dds::load_array(&file[0], (int)file.size()) == (dx10_cases[i][2] != 0));
+		}
+		for(int depth = 2048; depth <= 2049; ++depth)
+		{
+			std::vector<core::uint8> file(128 + depth * 4);
+			write_dds_header(&file[0], 1, 1, 1, 0x41, 0, 32, 0xff0000, 0xff00, 0xff, 0xff000000);
+			file[10] |= 0x80;
+			memcpy(&file[24], &depth, 4);
+			file[114] = 0x20;
+			BOOST_CHECK(!!format_dds::load_array(&file[0], (int)file.size()) == (depth == 2048));
+		}
+	}
+	
+	// volume slices are interleaved by level, 565 is byte reversed
+	{
+		image_array_ptr vol(new image_array(image_array::array_type_volume));
+		for(int i = 0; i < 4; ++i)
+		{
+			image_base_ptr slice(new image_rgba16(image_rgba::pixel_layout_rgb565));
+			slice->resize_canvas(16, 16, 2, false);
+			slice->clear(rgba(i, 2 * i, 31 - i, 255), 0);
+			slice->clear(rgba(31 - i, i, 0, 255), 1);
+			BOOST_REQUIRE(vol->add_layer(slice));
+		}
+		BOOST_CHECK(vol->get_num_layers(1) == 2);
+		canvas c;
+		BOOST_CHECK(!vol->get_mip_level(2, 1, &c));
+		std::vector<char> file(128 + 2 * (4 * 16 * 16 + 2 * 8 * 8));
+		io::memory_stream ostr(&file[0], (int)file.size());
+		BOOST_REQUIRE(format_dds::save_array(vol, ostr));
+		core::uint32 depth;
+		memcpy(&depth, &file[24], 4);
+		BOOST_CHECK(depth == 4);
+		
+		image_array_ptr loaded = format_dds::load_array((core::uint8*)&file[0], (int)file.size());
+		BOOST_REQUIRE(loaded);
+		BOOST_CHECK(loaded->get_array_type() == image_array::array_type_volume);
+		BOOST_CHECK(same_layers(*vol, *loaded));
+		BOOST_CHECK(!format_dds::load_array((core::uint8*)&file[0], (int)file.size() - 1));
+	}
+	
+	// arrays in formats with no dxgi equivalent are saved as bgra
+	{
+		image_array_ptr arr(new image_array(image_array::array_type_2d));
+		for(int i = 0; i < 2; ++i)
+		{
+			image_base_ptr layer(new image_rgb24(image_rgba::pixel_layout_bgr888));
+			layer->resize_canvas(8, 8, 1, false);
+			for(int y = 0; y < 8; ++y)
+				for(int x = 0; x < 8; ++x)
+					layer->put_pixel(rgba(x * 30, y * 30, i * 200, 255), 0, x, y);
+			BOOST_REQUIRE(arr->add_layer(layer));
+		}
+		std::vector<char> file(128 + 20 + 2 * 8 * 8 * 4);
+		io::memory_stream ostr(&file[0], (int)file.size());
+		BOOST_REQUIRE(format_dds::save_array(arr, ostr));
+		image_array_ptr loaded = format_dds::load_array((core::uint8*)&file[0], (int)file.size());
+		BOOST_REQUIRE(loaded);
+		BOOST_CHECK(loaded->get_image_format() == image_format_rgba32);
+		BOOST_CHECK(same_layers(*arr, *loaded));
+	}
+}
+
 namespace fool
 {
 	#include "daisy.inc"	
@@ -380,3 +2351,11 @@ BOOST_AUTO_TEST_CASE(test_copy)
 	test_copy_impl<image_a8, image_rgb24>();
 	test_copy_impl<image_a8, image_rgba32>();
 }
+
+BOOST_AUTO_TEST_CASE(test_row_access)
+{
+	test_row_access_impl<image_a8>();
+	test_row_access_impl<image_rgba16>();
+	test_row_access_impl<image_rgb24>();
+	test_row_access_impl<image_rgba32>();
+}
@@ -0,0 +1,265 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:38:03 PM
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "tile_scheduler.h"
+#include "image_functions.h"
+#include "core/debug/assert.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	/// set while a thread is running bands so nested calls don't wait on themselves
+	static thread_local bool t_in_task = false;
+
+	/// Persistent pool of worker threads, these are started on first use and sleep between jobs.
+	class tile_scheduler
+	{
+	public:
+		tile_scheduler() :
+			m_num_threads(0),
+			m_generation(0),
+			m_active(0),
+			m_shutdown(false)
+		{
+			set_num_threads(0);
+		}
+
+		~tile_scheduler()
+		{
+			stop_workers();
+		}
+
+		/// \returns total threads including the caller
+		int get_num_threads() const
+			{ return m_num_threads; }
+
+		void set_num_threads(int num_threads)
+		{
+			// the thread running a job holds the run lock, tasks can't resize the pool under it
+			if(t_in_task)
+				return;
+			std::lock_guard<std::mutex> run_lock(m_run_mutex);
+			if(num_threads <= 0)
+			{
+				num_threads = static_cast<int>(std::thread::hardware_concurrency());
+				if(num_threads <= 0)
+					num_threads = 1;
+			}
+			if(num_threads != m_num_threads)
+			{
+				stop_workers();
+				m_num_threads = num_threads;
+			}
+		}
+
+		void run(int count, int grain, row_task& task)
+		{
+			if(count <= 0)
+				return;
+			if(grain < 1)
+				grain = 1;
+
+			std::unique_lock<std::mutex> run_lock(m_run_mutex, std::defer_lock);
+			if(t_in_task || !run_lock.try_lock())
+			{
+				task.run(0, count);
+				return;
+			}
+
+			// a few bands per thread gives the stealing something to balance, the pool can't 
+			// change size while we hold the run lock
+			const int num_threads = m_num_threads;
+			const int units = (count + grain - 1) / grain;
+			int num_bands = num_threads * 4;
+			if(num_bands > units)
+				num_bands = units;
+			const int participants = num_bands < num_threads ? num_bands : num_threads;
+			if(participants <= 1)
+			{
+				run_lock.unlock();
+				task.run(0, count);
+				return;
+			}
+			start_workers();
+
+			job_info job;
+			job.task = &task;
+			job.count = count;
+			job.grain = grain;
+			job.num_bands = num_bands;
+			job.participants = participants;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_job = job;
+				for(int i = 0; i < participants; ++i)
+				{
+					m_queues[i].next = i * num_bands / participants;
+					m_queues[i].end = (i + 1) * num_bands / participants;
+				}
+				m_active = participants - 1;
+				++m_generation;
+			}
+			m_wake.notify_all();
+
+			execute(0, job);
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while(m_active > 0)
+				m_done.wait(lock);
+			m_job = job_info();
+		}
+
+	private:
+		/// a job the workers are woken for, each takes a copy under the lock
+		struct job_info
+		{
+			job_info() : task(0), count(0), grain(1), num_bands(0), participants(0) {}
+
+			row_task* task;
+			int count;
+			int grain;
+			int num_bands;
+			int participants;
+		};
+
+		/// bands [next, end) not yet taken from a thread's share
+		struct band_queue
+		{
+			std::atomic<int> next;
+			int end;
+		};
+
+		void start_workers()
+		{
+			const int num_workers = m_num_threads - 1;
+			if(static_cast<int>(m_threads.size()) == num_workers)
+				return;
+			m_queues = std::vector<band_queue>(m_num_threads);
+			
+			// workers started after earlier jobs must wait for the next one, not rerun the last
+			int generation;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_shutdown = false;
+				generation = m_generation;
+			}
+			for(int i = 1; i <= num_workers; ++i)
+				m_threads.push_back(std::thread(&tile_scheduler::worker_main, this, i, generation));
+		}
+
+		void stop_workers()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_shutdown = true;
+			}
+			m_wake.notify_all();
+			for(size_t i = 0; i < m_threads.size(); ++i)
+				m_threads[i].join();
+			m_threads.clear();
+		}
+
+		void worker_main(int index, int seen)
+		{
+			for(;;)
+			{
+				job_info job;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					while(!m_shutdown && m_generation == seen)
+						m_wake.wait(lock);
+					if(m_shutdown)
+						return;
+					seen = m_generation;
+					job = m_job;
+					if(index >= job.participants)
+						continue;
+				}
+				execute(index, job);
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					if(--m_active == 0)
+						m_done.notify_all();
+				}
+			}
+		}
+
+		/// runs bands from our own share then steals from the others
+		void execute(int index, const job_info& job)
+		{
+			t_in_task = true;
+			const int units = (job.count + job.grain - 1) / job.grain;
+			for(int i = 0; i < job.participants; ++i)
+			{
+				band_queue& queue = m_queues[(index + i) % job.participants];
+				for(int band = queue.next++; band < queue.end; band = queue.next++)
+				{
+					const int begin = band * units / job.num_bands * job.grain;
+					int end = (band + 1) * units / job.num_bands * job.grain;
+					if(end > job.count)
+						end = job.count;
+					job.task->run(begin, end);
+				}
+			}
+			t_in_task = false;
+		}
+
+	private:
+		std::mutex m_run_mutex;		///< held by the thread that owns the workers for a job
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+		std::vector<std::thread> m_threads;
+		std::vector<band_queue> m_queues;
+		std::atomic<int> m_num_threads;	///< only changed under the run lock
+		int m_generation;
+		int m_active;
+		bool m_shutdown;
+		job_info m_job;				///< job of the current generation
+	};
+
+	static tile_scheduler& get_tile_scheduler()
+	{
+		static tile_scheduler scheduler;
+		return scheduler;
+	}
+
+	void parallel_rows(int count, int grain, row_task& task)
+	{
+		get_tile_scheduler().run(count, grain, task);
+	}
+
+} // end namespace
+
+	/// Set the number of threads image functions split their work across
+	IMAGE_ABI void set_num_worker_threads(int num_threads)
+	{
+		detail::get_tile_scheduler().set_num_threads(num_threads);
+	}
+
+	/// \returns the number of threads image functions split their work across
+	IMAGE_ABI int get_num_worker_threads()
+	{
+		return detail::get_tile_scheduler().get_num_threads();
+	}
+
+} // end namespace
+} // end namespace
@@ -0,0 +1,52 @@
+//////////////////////////////////////////////////////////////////////////////
+// Tycho Game Library
+// Copyright (C) 2026 Martin Slater
+// Created : Saturday, 17 October 2026 11:38:03 PM
+//////////////////////////////////////////////////////////////////////////////
+#if _MSC_VER > 1000
+#pragma once
+#endif  // _MSC_VER
+
+#ifndef __TILE_SCHEDULER_H_6C0B5E2A_93D4_4F1B_8E77_2A4C9D31F0B6_
+#define __TILE_SCHEDULER_H_6C0B5E2A_93D4_4F1B_8E77_2A4C9D31F0B6_
+
+//////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+//////////////////////////////////////////////////////////////////////////////
+#include "image/image_abi.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// CLASS
+//////////////////////////////////////////////////////////////////////////////
+
+// internal to the image library, used to split image functions across threads.
+namespace tycho
+{
+namespace image
+{
+namespace detail
+{
+
+	/// Work over a range of rows. Implementations must produce the same output for a row
+	/// whatever band it is processed in so results do not depend on the thread count.
+	class row_task
+	{
+	public:
+		virtual ~row_task() {}
+
+		/// process rows [begin, end)
+		virtual void run(int begin, int end) = 0;
+	};
+
+	/// Splits rows [0, count) into bands and runs them across the worker threads and the calling
+	/// thread, returning once they are all complete. Each thread starts on its own share of the
+	/// bands and steals from the others when it runs out. Band boundaries are always a multiple
+	/// of grain rows from 0 so callers can keep blocks of rows together. Calls made from inside
+	/// a task, or while another thread is using the workers, run on the calling thread.
+	void parallel_rows(int count, int grain, row_task& task);
+
+} // end namespace
+} // end namespace
+} // end namespace
+
+#endif // __TILE_SCHEDULER_H_6C0B5E2A_93D4_4F1B_8E77_2A4C9D31F0B6_
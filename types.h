@@ -34,7 +34,8 @@ namespace image
 		image_format_a8,
 		image_format_dxtn,
 		image_format_gc_dxt5, ///< gamecube has no dxt5 so we represent it as 2 dxt1, with the alpha channel stored in the second.
-		image_format_srgb
+		image_format_srgb,
+		image_format_rgba64	///< 16 bits per channel
 	};
 
 	enum colour_channel